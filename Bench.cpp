@@ -0,0 +1,616 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <map>
+#include <algorithm>
+
+#include "ByteSwap.h"
+#include "objloader.h"
+#include "ThreadPool.h"
+#include "MeshOptimize.h"
+#include "MeshCodec.h"
+#include "MeshFormat.h"
+#include "Compress.h"
+#include "Bench.h"
+
+using namespace std;
+
+typedef chrono::high_resolution_clock bench_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+	return chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// GB/s of a swap function over size bytes, best of a few runs
+template<typename F>
+static double swap_throughput(F func, size_t size) {
+	const int n_runs = 10;
+	double best = 1e30;
+	for (int r = 0; r < n_runs; r++) {
+		bench_clock::time_point start = bench_clock::now();
+		func();
+		double t = seconds_since(start);
+		if (t < best)
+			best = t;
+	}
+	return size / best / 1e9;
+}
+
+static void bench_swap_size(size_t n) {
+	vector<float> src(n), dst(n);
+	for (size_t i = 0; i < n; i++)
+		src[i] = (float) i;
+
+	uint16_t* src16 = (uint16_t*) &src[0];
+	uint16_t* dst16 = (uint16_t*) &dst[0];
+	size_t size = n * sizeof(float);
+
+	printf("byte swap of %u KB\n", (unsigned) (size >> 10));
+
+	double gbs = swap_throughput([&]() {
+		for (size_t i = 0; i < n; i++)
+			dst[i] = swap_f32(src[i]);
+	}, size);
+	printf("\t%-8s swap_f32: %6.2f GB/s\n", "loop", gbs);
+
+	gbs = swap_throughput([&]() {
+		for (size_t i = 0; i < 2 * n; i++)
+			dst16[i] = swap_u16(src16[i]);
+	}, size);
+	printf("\t%-8s swap_u16: %6.2f GB/s\n", "loop", gbs);
+
+	std::string best = swap_kernel_name();
+	const char* kernels[] = {"scalar", "ssse3", "avx2"};
+	for (int k = 0; k < 3; k++) {
+		if (!swap_select_kernel(kernels[k])) {
+			printf("\t%-8s not supported\n", kernels[k]);
+			continue;
+		}
+
+		double gbs32 = swap_throughput([&]() { swap32(&dst[0], &src[0], n); }, size);
+		double gbs16 = swap_throughput([&]() { swap16(dst16, src16, 2 * n); }, size);
+		printf("\t%-8s swap32: %6.2f GB/s, swap16: %6.2f GB/s\n", kernels[k], gbs32, gbs16);
+	}
+
+	swap_select_kernel(best.c_str());
+}
+
+void BenchByteSwap() {
+	// a small mesh that stays in cache, and a large one that doesn't
+	bench_swap_size(64 * 1024);
+	bench_swap_size(16 * 1024 * 1024);
+}
+
+// write a grid of n*n quads with positions, texcoords and normals, split in
+// two material groups, then last_line if any
+static std::string write_grid_obj(int n, const std::string& path = "bench_grid.obj", const char* last_line = 0) {
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f)
+		return "";
+
+	for (int y = 0; y <= n; y++) {
+		for (int x = 0; x <= n; x++) {
+			float h = (float) ((x * 7 + y * 13) % 100) / 100.0f;
+			fprintf(f, "v %.6f %.6f %.6f\n", x * 0.01f, y * 0.01f, h);
+			fprintf(f, "vt %.6f %.6f\n", (float) x / n, (float) y / n);
+			fprintf(f, "vn 0.000000 0.000000 1.000000\n");
+		}
+	}
+
+	for (int y = 0; y < n; y++) {
+		if (y == 0 || y == n / 2)
+			fprintf(f, "usemtl group%d\n", y == 0 ? 0 : 1);
+
+		for (int x = 0; x < n; x++) {
+			int a = y * (n + 1) + x + 1;
+			int b = a + 1;
+			int c = a + n + 1;
+			int d = c + 1;
+			fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, d, d, d, c, c, c);
+		}
+	}
+	if (last_line)
+		fprintf(f, "%s\n", last_line);
+
+	fclose(f);
+	return path;
+}
+
+static int obj_triangles(const ObjReader& reader) {
+	int n_tris = 0;
+	for (size_t i = 0; i < reader.model.size(); i++)
+		n_tris += reader.model[i]->mesh->numTriangles;
+	return n_tris;
+}
+
+template<typename T>
+static bool same_array(const T* a, const T* b, int n) {
+	return (a == 0) == (b == 0) && (!a || memcmp(a, b, n * sizeof(T)) == 0);
+}
+
+static bool same_model(const ObjReader& a, const ObjReader& b) {
+	if (a.model.size() != b.model.size())
+		return false;
+
+	for (size_t i = 0; i < a.model.size(); i++) {
+		const TriangleMesh& ma = *a.model[i]->mesh;
+		const TriangleMesh& mb = *b.model[i]->mesh;
+		if (a.model[i]->material->name != b.model[i]->material->name
+			|| ma.numTriangles != mb.numTriangles || ma.nPositions != mb.nPositions
+			|| ma.nNormals != mb.nNormals || ma.nTexCoord != mb.nTexCoord
+			|| !same_array(ma.triangles, mb.triangles, 3 * ma.numTriangles)
+			|| !same_array(ma.positions, mb.positions, ma.nPositions)
+			|| !same_array(ma.normals, mb.normals, ma.nNormals)
+			|| !same_array(ma.texcoords, mb.texcoords, ma.nTexCoord))
+			return false;
+	}
+	return true;
+}
+
+// best of a few parses of file
+static double obj_parse_time(const std::string& file, int n_threads) {
+	const int n_runs = 3;
+	double best = 1e30;
+	for (int r = 0; r < n_runs; r++) {
+		bench_clock::time_point start = bench_clock::now();
+		ObjReader reader(file.c_str(), n_threads);
+		double t = seconds_since(start);
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+void BenchObjParse(const std::string& path) {
+	std::string file = path;
+	if (file.empty()) {
+		puts("writing bench_grid.obj...");
+		file = write_grid_obj(1000);
+	}
+
+	FILE* f = fopen(file.c_str(), "rb");
+	if (!f) {
+		printf("can't open '%s'\n", file.c_str());
+		return;
+	}
+	fseek(f, 0, SEEK_END);
+	double size = (double) ftell(f);
+	fclose(f);
+
+	int n_threads = ThreadPool::hardware_threads();
+	printf("%s: %.1f MB\n", file.c_str(), size / (1 << 20));
+
+	double serial = obj_parse_time(file, 1);
+	double parallel = obj_parse_time(file, n_threads);
+	printf("\tObjReader, 1 thread:   %.3fs, %.1f MB/s\n", serial, size / (1 << 20) / serial);
+	printf("\tObjReader, %d threads: %.3fs, %.1f MB/s (x%.1f)\n", n_threads, parallel,
+		size / (1 << 20) / parallel, serial / parallel);
+
+	ObjReader a(file.c_str(), 1);
+	ObjReader b(file.c_str(), n_threads);
+	printf("\t%d primitives, %d triangles, %s\n", (int) a.model.size(), obj_triangles(a),
+		same_model(a, b) ? "same result" : "RESULTS DIFFER");
+}
+
+bool TestObjIndices() {
+	// a grid read serially, and one large enough to be read by chunks
+	const int sizes[] = {1, 400};
+	int n_threads = std::max(2, ThreadPool::hardware_threads());
+	bool ok = true;
+	for (int s = 0; s < 2; s++) {
+		// a face past the last vertex, before the first one and at 0 (on
+		// the positions, texcoords and normals), and none to parse the grid
+		int n = (sizes[s] + 1) * (sizes[s] + 1);
+		char faces[7][64];
+		sprintf(faces[0], "f 1 2 %d", n + 5);
+		sprintf(faces[1], "f 1 2 %d", -n - 1);
+		sprintf(faces[2], "f 1 2 0");
+		sprintf(faces[3], "f 1/1 2/2 3/%d", n + 1);
+		sprintf(faces[4], "f 1/1/1 2/2/2 3/3/%d", -n - 1);
+		sprintf(faces[5], "f 1//1 2//2 3//0");
+		faces[6][0] = 0;
+
+		for (int i = 0; i < 7; i++) {
+			std::string file = write_grid_obj(sizes[s], "test_indices.obj", faces[i]);
+			ObjReader reader(file.c_str(), s == 0 ? 1 : n_threads);
+			bool failed = !reader.error.empty();
+			if (failed != (faces[i][0] != 0)) {
+				printf("\t'%s' after a %dx%d grid: %s\n", faces[i], sizes[s], sizes[s], failed ? reader.error.c_str() : "not reported");
+				ok = false;
+			}
+		}
+	}
+	remove("test_indices.obj");
+	printf("ObjReader face indices: %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// the vertex references of a triangulated n*n quad grid, in the order
+// flushFaceGroup welds them
+static vector<Vertex> grid_triangle_vertices(int n) {
+	vector<Vertex> verts;
+	verts.reserve((size_t) n * n * 6);
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			int a = y * (n + 1) + x;
+			int b = a + 1;
+			int c = a + n + 1;
+			int d = c + 1;
+			int quad[6] = {a, b, d, a, d, c};
+			for (int k = 0; k < 6; k++)
+				verts.push_back(Vertex(quad[k], quad[k], 0));
+		}
+	}
+	return verts;
+}
+
+void BenchVertexWeld() {
+	const int sizes[] = {100, 1000, 2000};
+	for (int s = 0; s < 3; s++) {
+		vector<Vertex> verts = grid_triangle_vertices(sizes[s]);
+		vector<uint32_t> map_indices(verts.size()), table_indices(verts.size());
+		size_t n_unique = 0;
+
+		const int n_runs = 3;
+		double map_best = 1e30, table_best = 1e30;
+		for (int r = 0; r < n_runs; r++) {
+			bench_clock::time_point start = bench_clock::now();
+			std::map<Vertex, uint32_t> vertex_map;
+			for (size_t i = 0; i < verts.size(); i++) {
+				std::map<Vertex, uint32_t>::iterator it = vertex_map.find(verts[i]);
+				if (it == vertex_map.end()) {
+					uint32_t index = (uint32_t) vertex_map.size();
+					vertex_map[verts[i]] = index;
+					map_indices[i] = index;
+				}
+				else
+					map_indices[i] = it->second;
+			}
+			double t = seconds_since(start);
+			if (t < map_best)
+				map_best = t;
+
+			start = bench_clock::now();
+			VertexHashTable table(verts.size() / 3);
+			for (size_t i = 0; i < verts.size(); i++) {
+				bool inserted;
+				table_indices[i] = table.insert(verts[i], inserted);
+			}
+			t = seconds_since(start);
+			if (t < table_best)
+				table_best = t;
+			n_unique = table.size();
+		}
+
+		printf("weld of %u vertex references, %u unique\n", (unsigned) verts.size(), (unsigned) n_unique);
+		printf("\tstd::map:        %.3fs\n", map_best);
+		printf("\tVertexHashTable: %.3fs (x%.1f)%s\n", table_best, map_best / table_best,
+			map_indices == table_indices ? "" : ", INDICES DIFFER");
+	}
+}
+
+// a vertex of the interleaved layout, position, normal and texcoord in one
+// 32-byte record (what --layout=interleaved writes without quantization)
+struct LayoutVertex {
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+};
+
+// the indices of a triangulated n*n quad grid, row by row
+static vector<uint32_t> grid_indices(int n) {
+	vector<uint32_t> indices;
+	indices.reserve((size_t) n * n * 6);
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			uint32_t a = y * (n + 1) + x;
+			uint32_t b = a + 1;
+			uint32_t c = a + n + 1;
+			uint32_t d = c + 1;
+			uint32_t quad[6] = {a, b, d, a, d, c};
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	return indices;
+}
+
+// best of a few runs of func
+template<typename F>
+static double best_time(F func) {
+	const int n_runs = 5;
+	double best = 1e30;
+	for (int r = 0; r < n_runs; r++) {
+		bench_clock::time_point start = bench_clock::now();
+		func();
+		double t = seconds_since(start);
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+static void bench_layout_size(int n) {
+	size_t n_vertices = (size_t) (n + 1) * (n + 1);
+	vector<uint32_t> indices = grid_indices(n);
+
+	vector<float> positions(3 * n_vertices), normals(3 * n_vertices), texcoords(2 * n_vertices);
+	vector<LayoutVertex> vertices(n_vertices);
+	for (size_t v = 0; v < n_vertices; v++) {
+		float x = (float) (v % (n + 1)), y = (float) (v / (n + 1));
+		float p[3] = {x * 0.01f, y * 0.01f, (float) ((v * 7) % 100) / 100.0f};
+		float nm[3] = {0.0f, 0.0f, 1.0f};
+		float t[2] = {x / n, y / n};
+		memcpy(&positions[3 * v], p, sizeof(p));
+		memcpy(&normals[3 * v], nm, sizeof(nm));
+		memcpy(&texcoords[2 * v], t, sizeof(t));
+		memcpy(vertices[v].position, p, sizeof(p));
+		memcpy(vertices[v].normal, nm, sizeof(nm));
+		memcpy(vertices[v].texcoord, t, sizeof(t));
+	}
+
+	printf("%u vertices, %u indices, %.1f MB of vertices\n", (unsigned) n_vertices, (unsigned) indices.size(),
+		n_vertices * sizeof(LayoutVertex) / (double) (1 << 20));
+
+	// every attribute of every indexed vertex, as a vertex shader reads them
+	volatile float sink = 0;
+	double planar = best_time([&]() {
+		float sum = 0;
+		for (size_t i = 0; i < indices.size(); i++) {
+			uint32_t v = indices[i];
+			sum += positions[3 * v] + positions[3 * v + 1] + positions[3 * v + 2];
+			sum += normals[3 * v] + normals[3 * v + 1] + normals[3 * v + 2];
+			sum += texcoords[2 * v] + texcoords[2 * v + 1];
+		}
+		sink = sum;
+	});
+	double interleaved = best_time([&]() {
+		float sum = 0;
+		for (size_t i = 0; i < indices.size(); i++) {
+			const LayoutVertex& vertex = vertices[indices[i]];
+			sum += vertex.position[0] + vertex.position[1] + vertex.position[2];
+			sum += vertex.normal[0] + vertex.normal[1] + vertex.normal[2];
+			sum += vertex.texcoord[0] + vertex.texcoord[1];
+		}
+		sink = sum;
+	});
+	printf("\tindexed traversal, all attributes:  planar %7.3fms, interleaved %7.3fms (x%.2f)\n",
+		1e3 * planar, 1e3 * interleaved, planar / interleaved);
+
+	// the positions alone, as a depth pass or a bounds computation reads them
+	planar = best_time([&]() {
+		float sum = 0;
+		for (size_t i = 0; i < indices.size(); i++) {
+			uint32_t v = indices[i];
+			sum += positions[3 * v] + positions[3 * v + 1] + positions[3 * v + 2];
+		}
+		sink = sum;
+	});
+	interleaved = best_time([&]() {
+		float sum = 0;
+		for (size_t i = 0; i < indices.size(); i++) {
+			const LayoutVertex& vertex = vertices[indices[i]];
+			sum += vertex.position[0] + vertex.position[1] + vertex.position[2];
+		}
+		sink = sum;
+	});
+	printf("\tindexed traversal, positions only:  planar %7.3fms, interleaved %7.3fms (x%.2f)\n",
+		1e3 * planar, 1e3 * interleaved, planar / interleaved);
+
+	// the copy into an interleaved vertex buffer: a gather of the planar
+	// arrays, a single memcpy of the records
+	vector<LayoutVertex> upload(n_vertices);
+	planar = best_time([&]() {
+		for (size_t v = 0; v < n_vertices; v++) {
+			memcpy(upload[v].position, &positions[3 * v], sizeof(upload[v].position));
+			memcpy(upload[v].normal, &normals[3 * v], sizeof(upload[v].normal));
+			memcpy(upload[v].texcoord, &texcoords[2 * v], sizeof(upload[v].texcoord));
+		}
+	});
+	bool same = memcmp(upload.data(), vertices.data(), n_vertices * sizeof(LayoutVertex)) == 0;
+	interleaved = best_time([&]() {
+		memcpy(upload.data(), vertices.data(), n_vertices * sizeof(LayoutVertex));
+	});
+	printf("\tupload to an interleaved buffer:    planar %7.3fms, interleaved %7.3fms (x%.2f)%s\n",
+		1e3 * planar, 1e3 * interleaved, planar / interleaved, same ? "" : ", BUFFERS DIFFER");
+}
+
+void BenchVertexLayout() {
+	// a mesh that stays in cache, and one that doesn't
+	bench_layout_size(128);
+	bench_layout_size(1024);
+}
+
+// encoded size and decoding speed of a vertex stream
+static void bench_codec_vertices(const char* name, const uint8_t* vertices, size_t n_vertices, size_t stride,
+	size_t& size_encoded, double& time) {
+	vector<uint8_t> data(encode_vertices_bound(n_vertices, stride));
+	data.resize(encode_vertices(data.data(), vertices, n_vertices, stride));
+
+	vector<uint8_t> decoded(n_vertices * stride);
+	bool ok = true;
+	time = best_time([&]() {
+		size_t used;
+		ok &= decode_vertices(decoded.data(), n_vertices, stride, data.data(), data.size(), used);
+	});
+	ok &= memcmp(decoded.data(), vertices, decoded.size()) == 0;
+
+	size_t size = n_vertices * stride;
+	printf("\t%-22s %8u -> %8u bytes (%5.1f%%), decoded at %.2f GB/s%s\n", name, (unsigned) size,
+		(unsigned) data.size(), 100.0 * data.size() / size, size / time / 1e9, ok ? "" : ", DECODING FAILED");
+	size_encoded = data.size();
+}
+
+void BenchMeshCodec() {
+	// a grid as the converter writes it with --vcache --vfetch
+	int n = 512;
+	uint32_t n_vertices = (uint32_t) (n + 1) * (n + 1);
+	vector<uint32_t> indices = grid_indices(n);
+	vector<uint32_t> remap;
+	OptimizeVertexCache(indices, n_vertices, 16);
+	OptimizeVertexFetch(indices, n_vertices, remap);
+
+	vector<float> records(8 * n_vertices);
+	for (uint32_t v = 0; v < n_vertices; v++) {
+		float x = (float) (v % (n + 1)), y = (float) (v / (n + 1));
+		float record[8] = {x * 0.01f, y * 0.01f, (float) ((v * 7) % 100) / 100.0f, 0.0f, 0.0f, 1.0f, x / n, y / n};
+		memcpy(&records[8 * v], record, sizeof(record));
+	}
+	RemapVertices(records, 8, remap, n_vertices);
+
+	// the same records quantized (--quantize --layout=interleaved)
+	vector<uint8_t> quantized(16 * n_vertices, 0);
+	for (uint32_t v = 0; v < n_vertices; v++) {
+		const float* r = &records[8 * v];
+		int16_t position[3] = {(int16_t) (r[0] * 6000 - 32768), (int16_t) (r[1] * 6000 - 32768), (int16_t) (r[2] * 65535 - 32768)};
+		int8_t normal[3] = {(int8_t) (r[3] * 127), (int8_t) (r[4] * 127), (int8_t) (r[5] * 127)};
+		int16_t texcoord[2] = {(int16_t) (r[6] * 1024), (int16_t) (r[7] * 1024)};
+		memcpy(&quantized[16 * v], position, sizeof(position));
+		memcpy(&quantized[16 * v + 6], normal, sizeof(normal));
+		memcpy(&quantized[16 * v + 10], texcoord, sizeof(texcoord));
+	}
+
+	printf("%u vertices, %u triangles\n", n_vertices, (unsigned) indices.size() / 3);
+
+	size_t size_f32, size_quantized;
+	double time_f32, time_quantized;
+	bench_codec_vertices("f32 records (32B)", (const uint8_t*) records.data(), n_vertices, 32, size_f32, time_f32);
+	bench_codec_vertices("quantized records (16B)", quantized.data(), n_vertices, 16, size_quantized, time_quantized);
+
+	vector<uint8_t> data(encode_indices_bound(indices.size(), true));
+	data.resize(encode_indices(data.data(), indices.data(), indices.size(), true));
+	vector<uint32_t> decoded(indices.size());
+	bool ok = true;
+	double time_indices = best_time([&]() {
+		size_t used;
+		ok &= decode_indices(decoded.data(), decoded.size(), 4, true, data.data(), data.size(), used);
+	});
+
+	// the triangles may start on another vertex
+	for (size_t t = 0; t < indices.size() && ok; t += 3) {
+		bool same = false;
+		for (int r = 0; r < 3; r++)
+			same |= decoded[t] == indices[t + r] && decoded[t + 1] == indices[t + (r + 1) % 3] && decoded[t + 2] == indices[t + (r + 2) % 3];
+		ok = same;
+	}
+
+	size_t size_indices = indices.size() * sizeof(uint32_t);
+	printf("\t%-22s %8u -> %8u bytes (%.1f bits per triangle), decoded at %.2f GB/s%s\n", "indices (32-bit)",
+		(unsigned) size_indices, (unsigned) data.size(), 8.0 * data.size() / (indices.size() / 3),
+		size_indices / time_indices / 1e9, ok ? "" : ", DECODING FAILED");
+
+	// reading size bytes at a storage speed s takes size / s: the encoded
+	// mesh loads faster as long as s < saved bytes / decoding time
+	size_t sizes[2] = {records.size() * sizeof(float), quantized.size()};
+	size_t encoded[2] = {size_f32, size_quantized};
+	double times[2] = {time_f32, time_quantized};
+	const char* names[2] = {"f32", "quantized"};
+	for (int i = 0; i < 2; i++) {
+		double saved = (double) (sizes[i] + size_indices) - (double) (encoded[i] + data.size());
+		double time = times[i] + time_indices;
+		printf("\t%s mesh loads faster encoded below %.0f MB/s of storage\n", names[i], saved / time / (1 << 20));
+	}
+}
+
+// compressed size and speeds of a body of data in MESH_BLOCK_SIZE blocks
+static void bench_compress_body(const char* name, const vector<uint8_t>& body, ThreadPool& pool) {
+	size_t n_blocks = (body.size() + MESH_BLOCK_SIZE - 1) / MESH_BLOCK_SIZE;
+	vector<vector<uint8_t> > blocks(n_blocks);
+	double time_compress = best_time([&]() {
+		for (size_t b = 0; b < n_blocks; b++) {
+			size_t size = min(body.size() - b * MESH_BLOCK_SIZE, (size_t) MESH_BLOCK_SIZE);
+			blocks[b].resize(lz_compress_bound(size));
+			blocks[b].resize(lz_compress(blocks[b].data(), body.data() + b * MESH_BLOCK_SIZE, size));
+		}
+	});
+
+	size_t size = 0;
+	for (size_t b = 0; b < n_blocks; b++)
+		size += blocks[b].size();
+
+	vector<uint8_t> decompressed(body.size());
+	bool ok = true;
+	auto decompress = [&](size_t b) {
+		size_t offset = b * MESH_BLOCK_SIZE;
+		return lz_decompress(decompressed.data() + offset, min(body.size() - offset, (size_t) MESH_BLOCK_SIZE),
+			blocks[b].data(), blocks[b].size());
+	};
+	double serial = best_time([&]() {
+		for (size_t b = 0; b < n_blocks; b++)
+			ok &= decompress(b);
+	});
+	ok &= memcmp(decompressed.data(), body.data(), body.size()) == 0;
+
+	memset(decompressed.data(), 0, decompressed.size());
+	vector<char> block_ok(n_blocks);
+	double parallel = best_time([&]() {
+		for (size_t b = 0; b < n_blocks; b++)
+			pool.push([&, b](int) { block_ok[b] = decompress(b); });
+		pool.wait();
+	});
+	for (size_t b = 0; b < n_blocks; b++)
+		ok &= block_ok[b] != 0;
+	ok &= memcmp(decompressed.data(), body.data(), body.size()) == 0;
+
+	printf("%s: %u -> %u bytes (%.1f%%) in %u blocks, compressed at %.0f MB/s%s\n", name, (unsigned) body.size(),
+		(unsigned) size, 100.0 * size / body.size(), (unsigned) n_blocks, body.size() / time_compress / (1 << 20),
+		ok ? "" : ", DECOMPRESSION FAILED");
+	printf("\tdecompressed at %.2f GB/s, 1 thread\n", body.size() / serial / 1e9);
+	printf("\tdecompressed at %.2f GB/s, %d threads (x%.1f)\n", body.size() / parallel / 1e9, pool.size(),
+		serial / parallel);
+
+	// reading size bytes at a storage speed s takes size / s. decompressing
+	// after reading, the mesh loads faster below saved bytes / decompression
+	// time. overlapped with reading, as mesh_read does, it only has to keep
+	// up with the storage: below the decompression speed
+	double saved = (double) body.size() - (double) size;
+	printf("\tloads faster compressed below %.0f MB/s of storage (%.0f MB/s overlapped, %.0f MB/s on every core)\n",
+		saved / serial / (1 << 20), body.size() / serial / (1 << 20), body.size() / parallel / (1 << 20));
+}
+
+void BenchCompress() {
+	// the sections of a grid as the converter writes it with --vcache --vfetch
+	int n = 512;
+	uint32_t n_vertices = (uint32_t) (n + 1) * (n + 1);
+	vector<uint32_t> indices = grid_indices(n);
+	vector<uint32_t> remap;
+	OptimizeVertexCache(indices, n_vertices, 16);
+	OptimizeVertexFetch(indices, n_vertices, remap);
+
+	vector<float> records(8 * n_vertices);
+	for (uint32_t v = 0; v < n_vertices; v++) {
+		float x = (float) (v % (n + 1)), y = (float) (v / (n + 1));
+		float record[8] = {x * 0.01f, y * 0.01f, (float) ((v * 7) % 100) / 100.0f, 0.0f, 0.0f, 1.0f, x / n, y / n};
+		memcpy(&records[8 * v], record, sizeof(record));
+	}
+	RemapVertices(records, 8, remap, n_vertices);
+
+	// planar f32 arrays, then the same quantized (--quantize), each followed
+	// by the indices
+	vector<uint8_t> f32, quantized;
+	const int sizes[3] = {3, 3, 2}, offsets[3] = {0, 3, 6};
+	for (int a = 0; a < 3; a++) {
+		for (uint32_t v = 0; v < n_vertices; v++) {
+			const float* r = &records[8 * v + offsets[a]];
+			f32.insert(f32.end(), (const uint8_t*) r, (const uint8_t*) (r + sizes[a]));
+			for (int c = 0; c < sizes[a]; c++) {
+				if (a == 1)
+					quantized.push_back((uint8_t) (int8_t) (r[c] * 127));
+				else {
+					int16_t q = (int16_t) (a == 0 ? r[c] * 6000 - 32768 : r[c] * 1024);
+					quantized.insert(quantized.end(), (const uint8_t*) &q, (const uint8_t*) (&q + 1));
+				}
+			}
+		}
+		quantized.resize((quantized.size() + 3) & ~3, 0);
+	}
+	f32.insert(f32.end(), (const uint8_t*) indices.data(), (const uint8_t*) (indices.data() + indices.size()));
+	quantized.insert(quantized.end(), (const uint8_t*) indices.data(), (const uint8_t*) (indices.data() + indices.size()));
+
+	printf("%u vertices, %u triangles\n", n_vertices, (unsigned) indices.size() / 3);
+
+	ThreadPool pool;
+	bench_compress_body("f32 arrays", f32, pool);
+	bench_compress_body("quantized arrays", quantized, pool);
+}
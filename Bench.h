@@ -0,0 +1,33 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <string>
+
+// throughput of the byte swap kernels (ByteSwap.h) against a per element swap
+void BenchByteSwap();
+
+// throughput of ObjReader on an OBJ file, or on a generated grid if path is
+// empty, serial and on every core
+void BenchObjParse(const std::string& path);
+
+// ObjReader on faces indexing past the vertices, before them or at 0, which
+// must fail with an error, serially and by chunks. false if one doesn't
+bool TestObjIndices();
+
+// time to weld the vertices of large triangle lists, std::map against VertexHashTable
+void BenchVertexWeld();
+
+// indexed traversal and upload of the vertices of a grid, planar arrays
+// against interleaved records (--layout=interleaved)
+void BenchVertexLayout();
+
+// compression and decoding speed of the vertex and index codecs of --encode
+// on a grid, and the storage speeds below which encoded meshes load faster
+void BenchMeshCodec();
+
+// compression and decompression speed of the LZ blocks of --compress on a
+// grid, serial and on every core, and the storage speeds below which
+// compressed meshes load faster
+void BenchCompress();
+
+#endif
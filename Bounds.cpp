@@ -0,0 +1,103 @@
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "Bounds.h"
+
+using namespace std;
+
+static inline float distance2(const float* a, const float* b) {
+	float d[3] = {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+	return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+}
+
+// the largest distance from center to one of the positions
+static float enclosing_radius(const float* positions, size_t n_vertices, const float center[3]) {
+	float radius2 = 0;
+	for (size_t v = 0; v < n_vertices; v++)
+		radius2 = max(radius2, distance2(&positions[3 * v], center));
+	return sqrtf(radius2);
+}
+
+Bounds ComputeBounds(const float* positions, size_t n_vertices) {
+	Bounds bounds;
+	for (int k = 0; k < 3; k++) {
+		bounds.min[k] = bounds.max[k] = bounds.center[k] = 0;
+	}
+	bounds.radius = 0;
+	if (n_vertices == 0)
+		return bounds;
+
+	// extreme vertices along the axes and the diagonals
+	static const float directions[7][3] = {
+		{1, 0, 0}, {0, 1, 0}, {0, 0, 1},
+		{1, 1, 1}, {1, 1, -1}, {1, -1, 1}, {-1, 1, 1}
+	};
+	size_t lo[7] = {0}, hi[7] = {0};
+	float lo_d[7], hi_d[7];
+	for (int d = 0; d < 7; d++) {
+		lo_d[d] = FLT_MAX;
+		hi_d[d] = -FLT_MAX;
+	}
+	for (int k = 0; k < 3; k++) {
+		bounds.min[k] = FLT_MAX;
+		bounds.max[k] = -FLT_MAX;
+	}
+
+	for (size_t v = 0; v < n_vertices; v++) {
+		const float* p = &positions[3 * v];
+		for (int k = 0; k < 3; k++) {
+			bounds.min[k] = min(bounds.min[k], p[k]);
+			bounds.max[k] = max(bounds.max[k], p[k]);
+		}
+		for (int d = 0; d < 7; d++) {
+			float t = p[0] * directions[d][0] + p[1] * directions[d][1] + p[2] * directions[d][2];
+			if (t < lo_d[d]) { lo_d[d] = t; lo[d] = v; }
+			if (t > hi_d[d]) { hi_d[d] = t; hi[d] = v; }
+		}
+	}
+
+	// the farthest pair starts the sphere, which grows to every vertex
+	// outside it, keeping the far side of the sphere where it is
+	int axis = 0;
+	for (int d = 1; d < 7; d++) {
+		if (distance2(&positions[3 * lo[d]], &positions[3 * hi[d]]) > distance2(&positions[3 * lo[axis]], &positions[3 * hi[axis]]))
+			axis = d;
+	}
+	const float* a = &positions[3 * lo[axis]];
+	const float* b = &positions[3 * hi[axis]];
+	float center[3] = {(a[0] + b[0]) / 2, (a[1] + b[1]) / 2, (a[2] + b[2]) / 2};
+	float radius = sqrtf(distance2(a, b)) / 2;
+
+	for (size_t v = 0; v < n_vertices; v++) {
+		const float* p = &positions[3 * v];
+		float d2 = distance2(p, center);
+		if (d2 <= radius * radius)
+			continue;
+
+		float d = sqrtf(d2);
+		float grown = (radius + d) / 2;
+		float t = (grown - radius) / d;
+		for (int k = 0; k < 3; k++)
+			center[k] += (p[k] - center[k]) * t;
+		radius = grown;
+	}
+
+	// rounding can leave a vertex just out of the sphere
+	radius = max(radius, enclosing_radius(positions, n_vertices, center));
+
+	float box_center[3];
+	for (int k = 0; k < 3; k++)
+		box_center[k] = (bounds.min[k] + bounds.max[k]) / 2;
+	float box_radius = enclosing_radius(positions, n_vertices, box_center);
+
+	if (box_radius < radius) {
+		copy(box_center, box_center + 3, bounds.center);
+		bounds.radius = box_radius;
+	}
+	else {
+		copy(center, center + 3, bounds.center);
+		bounds.radius = radius;
+	}
+	return bounds;
+}
@@ -0,0 +1,21 @@
+#ifndef _BOUNDS_H_
+#define _BOUNDS_H_
+
+#include <cstddef>
+
+// bounding volumes of the converter, the same layout as the MeshBounds
+// records of the .m file: an axis-aligned box and a sphere
+struct Bounds {
+	float min[3];
+	float max[3];
+	float center[3];
+	float radius;
+};
+
+// box and sphere of n_vertices positions (x, y, z). the sphere grows from
+// the farthest pair of extreme points along the axes and the diagonals
+// (Ritter, "An Efficient Bounding Sphere"), or is centered on the box if
+// that one is smaller. no vertices gives an empty box and sphere at 0
+Bounds ComputeBounds(const float* positions, size_t n_vertices);
+
+#endif
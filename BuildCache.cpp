@@ -0,0 +1,214 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "BuildCache.h"
+#include "Hash.h"
+
+using namespace std;
+
+struct BuildInput {
+	std::string path;
+	bool present;
+	uint64_t size;
+	uint64_t time;
+	uint64_t hash;
+};
+
+static std::string DependencyPath(const std::string& filename) {
+	return filename + ".dep";
+}
+
+static bool FileExists(const std::string& path) {
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f)
+		fclose(f);
+	return f != 0;
+}
+
+// size and modification time (sub-second when the platform has it)
+static bool FileStat(const std::string& path, uint64_t& size, uint64_t& time) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+		return false;
+
+	size = ((uint64_t) data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	time = ((uint64_t) data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	size = (uint64_t) st.st_size;
+#if defined(__APPLE__)
+	time = (uint64_t) st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#else
+	time = (uint64_t) st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+static BuildInput ReadInput(const std::string& path) {
+	BuildInput input;
+	input.path = path;
+	input.size = 0;
+	input.time = 0;
+	input.hash = 0;
+	input.present = FileStat(path, input.size, input.time) && hash_file(path, input.hash);
+	return input;
+}
+
+// the .mtl files referenced by an .obj, relative to its directory
+static void ScanMaterialLibs(const std::string& objPath, std::vector<std::string>& libs) {
+	ifstream input(objPath.c_str());
+
+	size_t sep = objPath.find_last_of("/\\");
+	std::string dir = (sep == std::string::npos) ? "" : objPath.substr(0, sep + 1);
+
+	std::string line;
+	while (getline(input, line)) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 6, "mtllib") != 0)
+			continue;
+
+		size_t name = line.find_first_not_of(" \t", start + 6);
+		size_t end = line.find_last_not_of(" \t\r");
+		if (name == std::string::npos || name == start + 6)
+			continue;
+
+		libs.push_back(dir + line.substr(name, end - name + 1));
+	}
+}
+
+static bool ReadDependencies(const std::string& filename, uint32_t& version, uint64_t& options, std::vector<BuildInput>& inputs) {
+	ifstream input(DependencyPath(filename).c_str());
+	if (!input)
+		return false;
+
+	version = 0;
+	options = 0;
+
+	std::string line;
+	while (getline(input, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		char path[1024];
+		unsigned long long a, b, c;
+		BuildInput in;
+		if (sscanf(line.c_str(), "version %u", &version) == 1)
+			continue;
+		else if (sscanf(line.c_str(), "options %llx", &a) == 1)
+			options = a;
+		else if (sscanf(line.c_str(), "input %llu %llu %llx %1023[^\n]", &a, &b, &c, path) == 4) {
+			in.path = path;
+			in.present = true;
+			in.size = a;
+			in.time = b;
+			in.hash = c;
+			inputs.push_back(in);
+		}
+		else if (sscanf(line.c_str(), "missing %1023[^\n]", path) == 1) {
+			in.path = path;
+			in.present = false;
+			in.size = in.time = in.hash = 0;
+			inputs.push_back(in);
+		}
+		else
+			return false;
+	}
+	return true;
+}
+
+static bool SaveDependencies(const std::string& filename, uint64_t options, const std::vector<BuildInput>& inputs) {
+	std::string path = DependencyPath(filename);
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f)
+		return false;
+
+	fprintf(f, "# MeshConv dependencies of %s\n", filename.c_str());
+	fprintf(f, "version %u\n", (unsigned) CONVERTER_VERSION);
+	fprintf(f, "options %016llx\n", (unsigned long long) options);
+	for (size_t i = 0; i < inputs.size(); i++) {
+		const BuildInput& in = inputs[i];
+		if (in.present)
+			fprintf(f, "input %llu %llu %016llx %s\n", (unsigned long long) in.size, (unsigned long long) in.time, (unsigned long long) in.hash, in.path.c_str());
+		else
+			fprintf(f, "missing %s\n", in.path.c_str());
+	}
+
+	bool ok = !ferror(f);
+	fclose(f);
+	if (!ok)
+		remove(path.c_str());
+	return ok;
+}
+
+bool IsUpToDate(const std::string& filename, uint64_t options) {
+	uint32_t version;
+	uint64_t recorded_options;
+	std::vector<BuildInput> inputs;
+	if (!ReadDependencies(filename, version, recorded_options, inputs))
+		return false;
+
+	if (version != CONVERTER_VERSION || recorded_options != options || inputs.empty())
+		return false;
+
+	if (!FileExists(filename + ".m") || !FileExists(filename + ".mat"))
+		return false;
+
+	bool touched = false;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		BuildInput& in = inputs[i];
+
+		uint64_t size, time;
+		bool present = FileStat(in.path, size, time);
+		if (present != in.present)
+			return false;
+		if (!present || (size == in.size && time == in.time))
+			continue;
+
+		// touched, compare the contents
+		uint64_t hash;
+		if (size != in.size || !hash_file(in.path, hash) || hash != in.hash)
+			return false;
+
+		in.time = time;
+		touched = true;
+	}
+
+	// save the new times, so the contents aren't hashed again next time
+	if (touched)
+		SaveDependencies(filename, options, inputs);
+
+	return true;
+}
+
+bool WriteDependencies(const std::string& filename, uint64_t options) {
+	std::string objPath = filename + ".obj";
+
+	std::vector<BuildInput> inputs;
+	inputs.push_back(ReadInput(objPath));
+
+	std::vector<std::string> libs;
+	ScanMaterialLibs(objPath, libs);
+	for (size_t i = 0; i < libs.size(); i++)
+		inputs.push_back(ReadInput(libs[i]));
+
+	return SaveDependencies(filename, options, inputs);
+}
+
+void RemoveDependencies(const std::string& filename) {
+	remove(DependencyPath(filename).c_str());
+}
@@ -0,0 +1,28 @@
+#ifndef _BUILD_CACHE_H_
+#define _BUILD_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+// bump when a change of the converter changes its output, so every mesh
+// converted by an older version is converted again
+#define CONVERTER_VERSION 10
+
+// incremental conversion. each converted mesh gets a meshname.dep file next
+// to its .m/.mat with the converter version, a hash of the options, and the
+// size, time and content hash of its inputs: the .obj and every .mtl it
+// references. a mesh is only converted again when one of these changed, so
+// editing a shared .mtl reconverts just the meshes using it
+
+// true if the .m/.mat of filename were converted from the current inputs with
+// the same options. inputs with a new time but the same contents still count
+// as up to date (their time is refreshed in the .dep)
+bool IsUpToDate(const std::string& filename, uint64_t options);
+
+// record the inputs of a mesh that was just converted
+bool WriteDependencies(const std::string& filename, uint64_t options);
+
+// forget the inputs of a mesh, ie. before converting it again
+void RemoveDependencies(const std::string& filename);
+
+#endif
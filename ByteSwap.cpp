@@ -0,0 +1,198 @@
+#include <cstring>
+
+#include "ByteSwap.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SWAP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+typedef void (*SwapFunc)(void*, const void*, size_t);
+
+static void swap32_scalar(void* dst, const void* src, size_t count) {
+	const uint8_t* s = (const uint8_t*) src;
+	uint8_t* d = (uint8_t*) dst;
+
+	for (size_t i = 0; i < count; i++, s += 4, d += 4) {
+		uint32_t v;
+		memcpy(&v, s, 4);
+		v = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+		memcpy(d, &v, 4);
+	}
+}
+
+static void swap16_scalar(void* dst, const void* src, size_t count) {
+	const uint8_t* s = (const uint8_t*) src;
+	uint8_t* d = (uint8_t*) dst;
+
+	for (size_t i = 0; i < count; i++, s += 2, d += 2) {
+		uint16_t v;
+		memcpy(&v, s, 2);
+		v = (uint16_t) ((v >> 8) | (v << 8));
+		memcpy(d, &v, 2);
+	}
+}
+
+static bool supported_scalar() {
+	return true;
+}
+
+#ifdef SWAP_X86
+
+// shuffle masks reversing the bytes of each 32/16-bit lane
+#define MASK32 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#define MASK16 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+
+TARGET_SSSE3 static void swap_bytes_ssse3(uint8_t* d, const uint8_t* s, size_t size, __m128i mask) {
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*) (s + i));
+		__m128i v1 = _mm_loadu_si128((const __m128i*) (s + i + 16));
+		_mm_storeu_si128((__m128i*) (d + i), _mm_shuffle_epi8(v0, mask));
+		_mm_storeu_si128((__m128i*) (d + i + 16), _mm_shuffle_epi8(v1, mask));
+	}
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+		_mm_storeu_si128((__m128i*) (d + i), _mm_shuffle_epi8(v, mask));
+	}
+}
+
+TARGET_SSSE3 static void swap32_ssse3(void* dst, const void* src, size_t count) {
+	size_t n = count & ~(size_t) 3;
+	swap_bytes_ssse3((uint8_t*) dst, (const uint8_t*) src, 4 * n, _mm_setr_epi8(MASK32));
+	swap32_scalar((uint8_t*) dst + 4 * n, (const uint8_t*) src + 4 * n, count - n);
+}
+
+TARGET_SSSE3 static void swap16_ssse3(void* dst, const void* src, size_t count) {
+	size_t n = count & ~(size_t) 7;
+	swap_bytes_ssse3((uint8_t*) dst, (const uint8_t*) src, 2 * n, _mm_setr_epi8(MASK16));
+	swap16_scalar((uint8_t*) dst + 2 * n, (const uint8_t*) src + 2 * n, count - n);
+}
+
+TARGET_AVX2 static void swap_bytes_avx2(uint8_t* d, const uint8_t* s, size_t size, __m256i mask) {
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i*) (s + i));
+		__m256i v1 = _mm256_loadu_si256((const __m256i*) (s + i + 32));
+		_mm256_storeu_si256((__m256i*) (d + i), _mm256_shuffle_epi8(v0, mask));
+		_mm256_storeu_si256((__m256i*) (d + i + 32), _mm256_shuffle_epi8(v1, mask));
+	}
+	for (; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (s + i));
+		_mm256_storeu_si256((__m256i*) (d + i), _mm256_shuffle_epi8(v, mask));
+	}
+}
+
+TARGET_AVX2 static void swap32_avx2(void* dst, const void* src, size_t count) {
+	size_t n = count & ~(size_t) 7;
+	swap_bytes_avx2((uint8_t*) dst, (const uint8_t*) src, 4 * n, _mm256_setr_epi8(MASK32, MASK32));
+	swap32_scalar((uint8_t*) dst + 4 * n, (const uint8_t*) src + 4 * n, count - n);
+}
+
+TARGET_AVX2 static void swap16_avx2(void* dst, const void* src, size_t count) {
+	size_t n = count & ~(size_t) 15;
+	swap_bytes_avx2((uint8_t*) dst, (const uint8_t*) src, 2 * n, _mm256_setr_epi8(MASK16, MASK16));
+	swap16_scalar((uint8_t*) dst + 2 * n, (const uint8_t*) src + 2 * n, count - n);
+}
+
+#ifdef _MSC_VER
+static bool supported_ssse3() {
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+}
+
+static bool supported_avx2() {
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// the os must save the ymm registers
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+#else
+static bool supported_ssse3() {
+	return __builtin_cpu_supports("ssse3") != 0;
+}
+
+static bool supported_avx2() {
+	return __builtin_cpu_supports("avx2") != 0;
+}
+#endif
+
+#endif // SWAP_X86
+
+struct SwapKernel {
+	const char* name;
+	SwapFunc swap32;
+	SwapFunc swap16;
+	bool (*supported)();
+};
+
+// in order of preference
+static const SwapKernel g_kernels[] = {
+#ifdef SWAP_X86
+	{"avx2",	swap32_avx2,	swap16_avx2,	supported_avx2},
+	{"ssse3",	swap32_ssse3,	swap16_ssse3,	supported_ssse3},
+#endif
+	{"scalar",	swap32_scalar,	swap16_scalar,	supported_scalar},
+};
+
+static const int g_n_kernels = sizeof(g_kernels) / sizeof(g_kernels[0]);
+
+static const SwapKernel* best_kernel() {
+	int i = 0;
+	while (!g_kernels[i].supported())
+		i++;
+	return &g_kernels[i];
+}
+
+// the kernel forced by swap_select_kernel, if any
+static const SwapKernel* g_kernel = 0;
+
+// the best kernel is found once, on the first call from any thread (a local
+// static is initialized once even when threads race to it)
+static const SwapKernel* kernel() {
+	static const SwapKernel* best = best_kernel();
+	return g_kernel ? g_kernel : best;
+}
+
+void swap32(void* dst, const void* src, size_t count) {
+	kernel()->swap32(dst, src, count);
+}
+
+void swap16(void* dst, const void* src, size_t count) {
+	kernel()->swap16(dst, src, count);
+}
+
+const char* swap_kernel_name() {
+	return kernel()->name;
+}
+
+bool swap_select_kernel(const char* name) {
+	for (int i = 0; i < g_n_kernels; i++) {
+		if (strcmp(g_kernels[i].name, name) == 0) {
+			if (!g_kernels[i].supported())
+				return false;
+
+			g_kernel = &g_kernels[i];
+			return true;
+		}
+	}
+	return false;
+}
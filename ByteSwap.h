@@ -0,0 +1,53 @@
+#ifndef _BYTE_SWAP_H_
+#define _BYTE_SWAP_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// swap the bytes in a float (to change big/little-endian
+inline float swap_f32(float f) {
+	union {
+		float f;
+		uint8_t b[4];
+	} u1, u2;
+
+	u1.f = f;
+	u2.b[0] = u1.b[3];
+	u2.b[1] = u1.b[2];
+	u2.b[2] = u1.b[1];
+	u2.b[3] = u1.b[0];
+	return u2.f;
+}
+
+inline uint16_t swap_u16(uint16_t i) {
+	union {
+		uint16_t i;
+		uint8_t b[2];
+	} u1, u2;
+
+	u1.i = i;
+	u2.b[0] = u1.b[1];
+	u2.b[1] = u1.b[0];
+	return u2.i;
+}
+
+inline bool host_big_endian() {
+	const uint16_t one = 1;
+	return *(const uint8_t*) &one == 0;
+}
+
+// bulk swaps of count 32/16-bit elements from src to dst. src and dst may be
+// the same array (in place), but must not overlap otherwise. the kernel
+// (AVX2, SSSE3 or scalar) is picked at runtime from the host cpu
+void swap32(void* dst, const void* src, size_t count);
+void swap16(void* dst, const void* src, size_t count);
+
+// name of the kernel used by swap32/swap16
+const char* swap_kernel_name();
+
+// force a kernel ("avx2", "ssse3" or "scalar"), returns false if the cpu
+// doesn't support it. used to compare the kernels, not while other threads
+// swap
+bool swap_select_kernel(const char* name);
+
+#endif
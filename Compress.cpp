@@ -0,0 +1,163 @@
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "Compress.h"
+
+using namespace std;
+
+// matches of at least MIN_MATCH bytes, found through a hash table of the
+// last position of each 4 bytes
+#define MIN_MATCH	4
+#define HASH_BITS	14
+#define NO_POSITION	0xFFFFFFFFu
+
+static inline uint32_t read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hash4(uint32_t v) {
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// the rest of a length of 15 or more, 255 per byte up to the last one
+static uint8_t* write_length(uint8_t* p, size_t length) {
+	for (; length >= 255; length -= 255)
+		*p++ = 255;
+	*p++ = (uint8_t) length;
+	return p;
+}
+
+static inline bool read_length(const uint8_t*& p, const uint8_t* end, size_t limit, size_t& length) {
+	uint8_t b;
+	do {
+		if (p == end || length > limit)
+			return false;
+		b = *p++;
+		length += b;
+	} while (b == 255);
+	return true;
+}
+
+// a sequence of n_literals literals, then a match of length bytes offset
+// bytes back (no match in the last sequence)
+static uint8_t* write_sequence(uint8_t* p, const uint8_t* literals, size_t n_literals, size_t offset, size_t length) {
+	uint8_t* token = p++;
+	size_t match = length ? length - MIN_MATCH : 0;
+	*token = (uint8_t) (min(n_literals, (size_t) 15) << 4 | min(match, (size_t) 15));
+
+	if (n_literals >= 15)
+		p = write_length(p, n_literals - 15);
+	memcpy(p, literals, n_literals);
+	p += n_literals;
+
+	if (length) {
+		*p++ = (uint8_t) offset;
+		*p++ = (uint8_t) (offset >> 8);
+		if (match >= 15)
+			p = write_length(p, match - 15);
+	}
+	return p;
+}
+
+size_t lz_compress_bound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+size_t lz_compress(uint8_t* out, const uint8_t* data, size_t size) {
+	vector<uint32_t> table(1 << HASH_BITS, NO_POSITION);
+	uint8_t* p = out;
+	size_t anchor = 0;
+
+	// greedy: the first match of a position is taken. positions are skipped
+	// faster the longer it has been since the last match
+	size_t i = 0;
+	while (i + MIN_MATCH <= size) {
+		uint32_t v = read32(data + i);
+		uint32_t h = hash4(v);
+		size_t candidate = table[h];
+		table[h] = (uint32_t) i;
+
+		if (candidate == NO_POSITION || i - candidate > 0xFFFF || read32(data + candidate) != v) {
+			i += 1 + ((i - anchor) >> 6);
+			continue;
+		}
+
+		size_t length = MIN_MATCH;
+		while (i + length < size && data[candidate + length] == data[i + length])
+			length++;
+		while (i > anchor && candidate > 0 && data[i - 1] == data[candidate - 1]) {
+			i--;
+			candidate--;
+			length++;
+		}
+
+		p = write_sequence(p, data + anchor, i - anchor, i - candidate, length);
+		i += length;
+		anchor = i;
+
+		// the end of the match is likely to match again
+		if (i + MIN_MATCH <= size + 2)
+			table[hash4(read32(data + i - 2))] = (uint32_t) (i - 2);
+	}
+
+	p = write_sequence(p, data + anchor, size - anchor, 0, 0);
+	return p - out;
+}
+
+bool lz_decompress(uint8_t* out, size_t out_size, const uint8_t* data, size_t size) {
+	const uint8_t* ip = data;
+	const uint8_t* iend = data + size;
+	uint8_t* op = out;
+	uint8_t* oend = out + out_size;
+
+	while (ip < iend) {
+		uint8_t token = *ip++;
+
+		// short literals are copied 16 bytes at once when the block has room
+		// for them, the next sequence writes over the rest
+		size_t n_literals = token >> 4;
+		if (n_literals < 15 && iend - ip >= 16 && oend - op >= 16)
+			memcpy(op, ip, 16);
+		else {
+			if (n_literals == 15 && !read_length(ip, iend, out_size, n_literals))
+				return false;
+			if (n_literals > (size_t) (iend - ip) || n_literals > (size_t) (oend - op))
+				return false;
+			memcpy(op, ip, n_literals);
+		}
+		op += n_literals;
+		ip += n_literals;
+
+		// the last sequence
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		size_t offset = ip[0] | ip[1] << 8;
+		ip += 2;
+
+		size_t length = (token & 15) + MIN_MATCH;
+		if ((token & 15) == 15 && !read_length(ip, iend, out_size, length))
+			return false;
+		if (offset == 0 || offset > (size_t) (op - out) || length > (size_t) (oend - op))
+			return false;
+
+		// 8 bytes at a time when the match doesn't overlap them
+		const uint8_t* src = op - offset;
+		if (offset >= 8 && (length + 7) / 8 * 8 <= (size_t) (oend - op)) {
+			for (size_t k = 0; k < length; k += 8)
+				memcpy(op + k, src + k, 8);
+		}
+		else {
+			for (size_t k = 0; k < length; k++)
+				op[k] = src[k];
+		}
+		op += length;
+	}
+
+	return op == oend;
+}
@@ -0,0 +1,29 @@
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// general purpose LZ compression of independent blocks of up to 64KB (the
+// sections of the .m files with MESH_COMPRESSED), shared by the converter
+// and the reader. a block is a series of sequences, each one a token (the
+// literal count in the high nibble, the match length - 4 in the low one,
+// 15 for both adds bytes up to one under 255), the literals, the offset of
+// the match (u16 little-endian) and the rest of its length. the last
+// sequence has literals only
+
+#define LZ_MAX_BLOCK_SIZE 65536
+
+// the largest size lz_compress can write for size bytes
+size_t lz_compress_bound(size_t size);
+
+// compress size bytes (up to LZ_MAX_BLOCK_SIZE) of data to out, returns the
+// bytes written
+size_t lz_compress(uint8_t* out, const uint8_t* data, size_t size);
+
+// decompress the size bytes of a block from data to out, which must be
+// out_size bytes once decompressed. false on a malformed block, out is
+// never written out of out_size bytes
+bool lz_decompress(uint8_t* out, size_t out_size, const uint8_t* data, size_t size);
+
+#endif
@@ -0,0 +1,109 @@
+#include <cstring>
+#include <cstdio>
+#include <vector>
+
+#include "Hash.h"
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+	acc += input * PRIME2;
+	acc = rotl(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t val) {
+	acc ^= round64(0, val);
+	return acc * PRIME1 + PRIME4;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+	const uint8_t* p = (const uint8_t*) data;
+	const uint8_t* end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+
+		const uint8_t* limit = end - 32;
+		do {
+			v1 = round64(v1, read64(p));
+			v2 = round64(v2, read64(p + 8));
+			v3 = round64(v3, read64(p + 16));
+			v4 = round64(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge64(h, v1);
+		h = merge64(h, v2);
+		h = merge64(h, v3);
+		h = merge64(h, v4);
+	}
+	else {
+		h = seed + PRIME5;
+	}
+
+	h += (uint64_t) size;
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= round64(0, read64(p));
+		h = rotl(h, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t) read32(p) * PRIME1;
+		h = rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= (*p) * PRIME5;
+		h = rotl(h, 11) * PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+bool hash_file(const std::string& path, uint64_t& hash) {
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+
+	// chain the hashes of 1MB blocks
+	std::vector<uint8_t> block(1 << 20);
+	hash = 0;
+	size_t n;
+	while ((n = fread(&block[0], 1, block.size(), f)) > 0)
+		hash = hash64(&block[0], n, hash);
+
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
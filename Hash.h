@@ -0,0 +1,14 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// 64-bit non cryptographic hash (XXH64), seed chains several buffers
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+// hash of the contents of a file, false if it can't be read
+bool hash_file(const std::string& path, uint64_t& hash);
+
+#endif
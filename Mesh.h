@@ -3,9 +3,19 @@
 
 //#include <gctypes.h>
 #include <cstdint>
+#include <cstddef>
+
+#include "MeshFormat.h"
 
 typedef float f32;
+typedef uint8_t u8;
 typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int8_t s8;
+typedef int16_t s16;
+
+// alignment of each array of a mesh (GX DMA requirement)
+#define MESH_ALIGNMENT 32
 
 struct Vec3 {
 	f32 x, y, z;
@@ -37,37 +47,261 @@ struct Vec2 {
 	*/
 };
 
+// the quantized attributes (see Mesh::vertex_format)
+struct Vec3s16 {
+	s16 x, y, z;
+};
+
+struct Vec3s8 {
+	s8 x, y, z;
+};
+
+struct Vec2s16 {
+	s16 x, y;
+};
+
+// the attributes of a vertex (see Mesh::view)
+enum VertexAttribute {
+	VERTEX_POSITION,
+	VERTEX_NORMAL,
+	VERTEX_TEXCOORD
+};
+
+// typed access to an attribute of the vertices whatever the layout: view[v]
+// is the attribute of vertex v, stride bytes after the one of vertex v - 1
+template <class T>
+struct VertexView {
+	u8* data;
+	u32 stride;
+
+	VertexView(void* pData, u32 pStride) : data((u8*) pData), stride(pStride) {}
+
+	T& operator[](u32 v) const {
+		return *(T*) (data + (size_t) v * stride);
+	}
+};
+
+// same layout as the submesh records of the .m file (versions 2 and later)
 struct SubMesh {
-	u16 start;
-	u16 size;
+	u32 start;			// first triangle
+	u32 size;			// number of triangles, of indices for the strips
+	u32 base_vertex;	// added to the indices of the submesh
+	u32 index_offset;	// of the submesh indices in Mesh::indices, in bytes
+	u8 index_size;		// bytes per index: 1, 2 or 4
+	u8 material;		// 255 for the default material
+	u8 primitive;		// MESH_TRIANGLES or one of the strips (MeshFormat.h)
+	u8 reserved;
 
-	void set(u16 pStart, u16 pSize) {
+	void set(u32 pStart, u32 pSize) {
 		start = pStart;
 		size = pSize;
 	}
+
+	u32 index_count() const {
+		return primitive == MESH_TRIANGLES ? 3 * size : size;
+	}
+};
+
+// dequantization of the s16 positions of a submesh (MESH_POSITION_S16), same
+// layout as the records of the .m file: p = offset + q * scale
+struct PositionQuant {
+	f32 offset[3];
+	f32 scale[3];
+};
+
+// bounding volumes of a mesh or a submesh (version 9), same layout as the
+// records of the .m file: the box and a sphere around its vertices
+struct MeshBounds {
+	f32 min[3];
+	f32 max[3];
+	f32 center[3];
+	f32 radius;
 };
 
+// a cluster of triangles of a submesh (version 10, MESH_MESHLETS), same
+// layout as the meshlet records of the .m file. its vertices are
+// Mesh::meshlet_vertices[vertex_offset...] (mesh vertices), triangle t is
+// the vertices of Mesh::meshlet_triangles[triangle_offset + 3 * t...].
+// center and radius bound its vertices, it faces away from a camera at c
+// when dot(center - c, cone_axis) >= cone_cutoff * |center - c| + radius
+// (see MeshCull.h)
+struct Meshlet {
+	u32 vertex_offset;
+	u32 triangle_offset;	// in bytes
+	u8 vertex_count;
+	u8 triangle_count;
+	u16 subMesh;
+	f32 center[3];
+	f32 radius;
+	f32 cone_axis[3];
+	f32 cone_cutoff;		// 1 for no cone
+};
+
+// allocator for the mesh arrays. all the arrays of a mesh live in a single
+// block, so a mesh makes exactly one alloc/release pair. an allocator that
+// drops all its blocks at once (MeshPool::reset) moves to a new generation,
+// the blocks of an earlier one aren't released anymore
+struct MeshAllocator {
+	virtual void* alloc(size_t size, size_t alignment) = 0;
+	virtual void release(void* ptr) = 0;
+	virtual u32 generation() const { return 0; }
+};
+
+struct Mesh;
+
+// free the memory (or mapping) owned by a mesh, defined in MeshReader.cpp
+void mesh_release(Mesh& mesh);
+
 struct Mesh {
-	u16 n_vertices;
-	u16 n_tris;
-	u16 n_texcoord;
-	u16 n_normals;
-	u16 n_subMeshes;
+	u32 n_vertices;
+	u32 n_tris;
+	u32 n_texcoord;
+	u32 n_normals;
+	u32 n_subMeshes;
 
 	Vec3* vertices;
-	u16* indices;
+
+	// indices of every submesh, each one with its own size (see SubMesh and
+	// mesh_index)
+	void* indices;
+	u32 indices_size;
 	
 	Vec2* texcoord;
 	Vec3* normals;
 	SubMesh* subMeshes;
 
+	// the arrays kept quantized (see mesh_read), MESH_POSITION_S16... 0 when
+	// vertices, normals and texcoord hold them all. an array kept quantized
+	// replaces its f32 one, which is null:
+	//	q_vertices (x, y, z) with the PositionQuant of the submesh
+	//	q_normals (x, y, z) / 127
+	//	q_texcoord (u, v) * texcoord_scale()
+	u16 vertex_format;
+	s16* q_vertices;
+	s8* q_normals;
+	s16* q_texcoord;
+	PositionQuant* quant;	// per submesh, with MESH_POSITION_S16
+
+	// with MESH_INTERLEAVED in vertex_format, the vertices are records of
+	// vertex_stride bytes with each attribute at its offset, and all the
+	// arrays above but quant are null. view reads both layouts
+	u8* vertex_data;
+	u16 vertex_stride;
+	u16 vertex_offsets[3];	// by VertexAttribute
+
+	// the level of detail of the triangles (0 for the full detail) among
+	// the n_lods of the file, and the geometric error of each one in mesh
+	// units (see SimplifyMesh in MeshOptimize.h)
+	u32 lod;
+	u32 n_lods;
+	f32 lod_errors[MESH_MAX_LODS];
+
+	// the bounds of the whole mesh and of each submesh (by index in
+	// subMeshes), from the file so culling needs no pass over the vertices.
+	// subMesh_bounds is null and bounds empty for files before version 9
+	MeshBounds bounds;
+	MeshBounds* subMesh_bounds;
+
+	// the full detail in clusters (MESH_MESHLETS in the file), with only the
+	// level of detail 0. 0 and null without
+	u32 n_meshlets;
+	Meshlet* meshlets;
+	u32* meshlet_vertices;
+	u8* meshlet_triangles;
+
+	// block owning the arrays above (see mesh_read), from allocator in
+	// generation
+	void* block;
+	MeshAllocator* allocator;
+	u32 generation;
+
+	// file mapping owning the arrays above (see mesh_map)
+	void* mapping;
+	size_t mappingSize;
+
 	Mesh() {
 		vertices = 0;
 		//faces = 0;
+		indices = 0;
+		indices_size = 0;
 		texcoord = 0;
 		normals = 0;
 		subMeshes = 0;
+		vertex_format = 0;
+		q_vertices = 0;
+		q_normals = 0;
+		q_texcoord = 0;
+		quant = 0;
+		vertex_data = 0;
+		vertex_stride = 0;
+		vertex_offsets[0] = vertex_offsets[1] = vertex_offsets[2] = 0;
+		lod = 0;
+		n_lods = 0;
+		for (int l = 0; l < MESH_MAX_LODS; l++)
+			lod_errors[l] = 0;
+		bounds = MeshBounds();
+		subMesh_bounds = 0;
+		n_meshlets = 0;
+		meshlets = 0;
+		meshlet_vertices = 0;
+		meshlet_triangles = 0;
+		block = 0;
+		allocator = 0;
+		generation = 0;
+		mapping = 0;
+		mappingSize = 0;
 	}
+
+	~Mesh() {
+		mesh_release(*this);
+	}
+
+	// the vertices of an attribute, T is Vec3/Vec2 or the quantized type
+	// vertex_format gives (Vec3s16, Vec3s8, Vec2s16)
+	template <class T>
+	VertexView<T> view(VertexAttribute attribute) const {
+		if (vertex_format & MESH_INTERLEAVED)
+			return VertexView<T>(vertex_data + vertex_offsets[attribute], vertex_stride);
+
+		void* arrays[3] = {
+			vertex_format & MESH_POSITION_S16 ? (void*) q_vertices : (void*) vertices,
+			vertex_format & MESH_NORMAL_S8 ? (void*) q_normals : (void*) normals,
+			vertex_format & MESH_TEXCOORD_S16 ? (void*) q_texcoord : (void*) texcoord,
+		};
+		return VertexView<T>(arrays[attribute], sizeof(T));
+	}
+
+	f32 texcoord_scale() const {
+		return 1.0f / (1 << MESH_TEXCOORD_SHIFT(vertex_format));
+	}
+
+	// vertex of index i (0 <= i < subMesh.index_count()) of a submesh. the
+	// restart index of MESH_TRIANGLE_STRIP_RESTART isn't a vertex, check
+	// it with is_restart first
+	bool is_restart(const SubMesh& subMesh, u32 i) const {
+		if (subMesh.primitive != MESH_TRIANGLE_STRIP_RESTART)
+			return false;
+		const u8* data = (const u8*) indices + subMesh.index_offset;
+		switch (subMesh.index_size) {
+			case 1:		return data[i] == 0xFF;
+			case 2:		return ((const u16*) data)[i] == 0xFFFF;
+			default:	return ((const u32*) data)[i] == 0xFFFFFFFF;
+		}
+	}
+
+	u32 mesh_index(const SubMesh& subMesh, u32 i) const {
+		const u8* data = (const u8*) indices + subMesh.index_offset;
+		switch (subMesh.index_size) {
+			case 1:		return subMesh.base_vertex + data[i];
+			case 2:		return subMesh.base_vertex + ((const u16*) data)[i];
+			default:	return subMesh.base_vertex + ((const u32*) data)[i];
+		}
+	}
+
+private:
+	// a mesh owns its arrays, it can't be copied
+	Mesh(const Mesh&);
+	Mesh& operator=(const Mesh&);
 };
 
 #endif
\ No newline at end of file
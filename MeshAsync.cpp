@@ -0,0 +1,294 @@
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+
+#include "MeshAsync.h"
+
+using namespace std;
+
+// the whole file in data
+static bool read_file(const char* filename, std::vector<u8>& data) {
+	ifstream inFile(filename, ios::in | ios::binary);
+	if (!inFile)
+		return false;
+
+	inFile.seekg(0, ios::end);
+	streamoff size = inFile.tellg();
+	inFile.seekg(0, ios::beg);
+	if (!inFile || size <= 0)
+		return false;
+
+	data.resize((size_t) size);
+	inFile.read((char*) data.data(), data.size());
+	return !!inFile;
+}
+
+static bool finished_status(MeshStatus status) {
+	return status == MESH_LOADED || status == MESH_FAILED || status == MESH_CANCELLED;
+}
+
+MeshLoader::MeshLoader(int n_decoders, size_t read_ahead, MeshAllocator* allocator)
+	: allocator(allocator), read_ahead(read_ahead), next(1), read_bytes(0), stop(false) {
+	if (n_decoders <= 0)
+		n_decoders = max((int) std::thread::hardware_concurrency(), 1);
+
+	reader = std::thread(&MeshLoader::read_loop, this);
+	for (int i = 0; i < n_decoders; i++)
+		decoder_threads.push_back(std::thread(&MeshLoader::decode_loop, this));
+}
+
+MeshLoader::~MeshLoader() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+		for (auto it = requests.begin(); it != requests.end(); ++it) {
+			Request& r = *it->second;
+			if (!finished_status(r.status) && !r.decoding)
+				r.status = MESH_CANCELLED;
+		}
+	}
+	wake_reader.notify_all();
+	wake_decoders.notify_all();
+
+	reader.join();
+	for (size_t i = 0; i < decoder_threads.size(); i++)
+		decoder_threads[i].join();
+
+	for (auto it = requests.begin(); it != requests.end(); ++it)
+		delete it->second;
+}
+
+// queue a read, with lock held
+MeshRequest MeshLoader::push(const MeshPrefetch& mesh) {
+	MeshRequest request = next++;
+	if (next == 0)
+		next = 1;
+
+	Request* r = new Request;
+	r->filename			= mesh.filename;
+	r->out				= mesh.out;
+	r->priority			= mesh.priority;
+	r->order			= request;
+	r->keep_quantized	= mesh.keep_quantized;
+	r->lod				= mesh.lod;
+	r->status			= MESH_QUEUED;
+	r->decoding			= false;
+	requests[request] = r;
+
+	Entry entry = {r->priority, r->order, request};
+	reads.push(entry);
+	return request;
+}
+
+// the most urgent request of queue still in status (and not taken by a
+// decoder), dropping the stale entries on the way. with lock held
+bool MeshLoader::pop(std::priority_queue<Entry>& queue, MeshStatus status, MeshRequest& request) {
+	while (!queue.empty()) {
+		Entry entry = queue.top();
+		queue.pop();
+
+		auto it = requests.find(entry.request);
+		if (it == requests.end())
+			continue;
+		const Request& r = *it->second;
+		if (r.status == status && !r.decoding && r.priority == entry.priority) {
+			request = entry.request;
+			return true;
+		}
+	}
+	return false;
+}
+
+// with lock held
+void MeshLoader::finish(MeshRequest request, Request& r, MeshStatus status) {
+	r.status = status;
+	finished.push_back(request);
+	finished_cond.notify_all();
+}
+
+void MeshLoader::read_loop() {
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		// no further ahead of the decoders than read_ahead, but always one file
+		wake_reader.wait(guard, [&]() {
+			return stop || (!reads.empty() && (read_bytes == 0 || read_bytes < read_ahead));
+		});
+		if (stop)
+			return;
+
+		MeshRequest request;
+		if (!pop(reads, MESH_QUEUED, request))
+			continue;
+
+		Request* r = requests[request];
+		r->status = MESH_READING;
+		std::string filename = r->filename;
+		guard.unlock();
+
+		std::vector<u8> data;
+		bool ok = read_file(filename.c_str(), data);
+
+		// cancelled while reading (and maybe forgotten already)
+		guard.lock();
+		auto it = requests.find(request);
+		if (it == requests.end() || it->second->status != MESH_READING)
+			continue;
+
+		r = it->second;
+		if (!ok) {
+			printf("mesh_read_async: can't read '%s'\n", filename.c_str());
+			mesh_release(*r->out);
+			finish(request, *r, MESH_FAILED);
+			continue;
+		}
+
+		r->data.swap(data);
+		r->status = MESH_DECODING;
+		read_bytes += r->data.size();
+
+		Entry entry = {r->priority, r->order, request};
+		decodes.push(entry);
+		wake_decoders.notify_one();
+	}
+}
+
+void MeshLoader::decode_loop() {
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		wake_decoders.wait(guard, [&]() { return stop || !decodes.empty(); });
+		if (stop)
+			return;
+
+		MeshRequest request;
+		if (!pop(decodes, MESH_DECODING, request))
+			continue;
+
+		// the request stays until it is finished, and only its priority
+		// changes until then (not anymore once decoding)
+		Request& r = *requests[request];
+		r.decoding = true;
+		std::vector<u8> data;
+		data.swap(r.data);
+		guard.unlock();
+
+		bool ok = mesh_read_memory(data.data(), data.size(), r.filename.c_str(), *r.out, allocator, r.keep_quantized, r.lod);
+		size_t size = data.size();
+		std::vector<u8>().swap(data);
+
+		guard.lock();
+		read_bytes -= size;
+		finish(request, r, ok ? MESH_LOADED : MESH_FAILED);
+		wake_reader.notify_one();
+	}
+}
+
+MeshRequest mesh_read_async(MeshLoader& loader, const char* filename, Mesh& out, int priority, bool keep_quantized, u32 lod) {
+	MeshPrefetch mesh = {filename, &out, priority, keep_quantized, lod};
+	MeshRequest request;
+	{
+		std::lock_guard<std::mutex> guard(loader.lock);
+		request = loader.push(mesh);
+	}
+	loader.wake_reader.notify_one();
+	return request;
+}
+
+void mesh_prefetch(MeshLoader& loader, const MeshPrefetch* meshes, u32 count, MeshRequest* requests) {
+	{
+		std::lock_guard<std::mutex> guard(loader.lock);
+		for (u32 i = 0; i < count; i++) {
+			MeshRequest request = loader.push(meshes[i]);
+			if (requests)
+				requests[i] = request;
+		}
+	}
+	loader.wake_reader.notify_one();
+}
+
+bool mesh_reprioritize(MeshLoader& loader, MeshRequest request, int priority) {
+	std::lock_guard<std::mutex> guard(loader.lock);
+	auto it = loader.requests.find(request);
+	if (it == loader.requests.end())
+		return false;
+
+	MeshLoader::Request& r = *it->second;
+	if (finished_status(r.status) || r.decoding)
+		return false;
+
+	// the entry with the old priority goes stale, a file being read gets
+	// its decode entry with the new one
+	r.priority = priority;
+	MeshLoader::Entry entry = {r.priority, r.order, request};
+	if (r.status == MESH_QUEUED)
+		loader.reads.push(entry);
+	else if (r.status == MESH_DECODING)
+		loader.decodes.push(entry);
+	return true;
+}
+
+bool mesh_cancel(MeshLoader& loader, MeshRequest request) {
+	std::lock_guard<std::mutex> guard(loader.lock);
+	auto it = loader.requests.find(request);
+	if (it == loader.requests.end())
+		return false;
+
+	MeshLoader::Request& r = *it->second;
+	if (finished_status(r.status) || r.decoding)
+		return false;
+
+	// a file being read is dropped by the I/O thread once read
+	if (r.status == MESH_DECODING) {
+		loader.read_bytes -= r.data.size();
+		std::vector<u8>().swap(r.data);
+		loader.wake_reader.notify_one();
+	}
+	loader.finish(request, r, MESH_CANCELLED);
+	return true;
+}
+
+MeshStatus mesh_status(MeshLoader& loader, MeshRequest request) {
+	std::lock_guard<std::mutex> guard(loader.lock);
+	auto it = loader.requests.find(request);
+	return it != loader.requests.end() ? it->second->status : MESH_UNKNOWN;
+}
+
+MeshStatus mesh_wait(MeshLoader& loader, MeshRequest request) {
+	std::unique_lock<std::mutex> guard(loader.lock);
+	auto it = loader.requests.find(request);
+	loader.finished_cond.wait(guard, [&]() {
+		it = loader.requests.find(request);
+		return it == loader.requests.end() || finished_status(it->second->status);
+	});
+	if (it == loader.requests.end())
+		return MESH_UNKNOWN;
+
+	// its entry in finished goes stale
+	MeshStatus status = it->second->status;
+	delete it->second;
+	loader.requests.erase(it);
+	return status;
+}
+
+MeshRequest mesh_wait_any(MeshLoader& loader, MeshStatus* status) {
+	std::unique_lock<std::mutex> guard(loader.lock);
+	for (;;) {
+		while (!loader.finished.empty()) {
+			MeshRequest request = loader.finished.front();
+			loader.finished.pop_front();
+
+			auto it = loader.requests.find(request);
+			if (it == loader.requests.end())
+				continue;
+			if (status)
+				*status = it->second->status;
+			delete it->second;
+			loader.requests.erase(it);
+			return request;
+		}
+
+		// every request left is on its way
+		if (loader.requests.empty())
+			return 0;
+		loader.finished_cond.wait(guard);
+	}
+}
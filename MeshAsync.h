@@ -0,0 +1,146 @@
+#ifndef _MESH_ASYNC_H_
+#define _MESH_ASYNC_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "MeshReader.h"
+
+// where a request of mesh_read_async is
+enum MeshStatus {
+	MESH_QUEUED,		// waiting for the I/O thread
+	MESH_READING,		// being read by the I/O thread
+	MESH_DECODING,		// read, waiting for or being decoded by a decoder
+	MESH_LOADED,		// done, out holds the mesh
+	MESH_FAILED,		// the file can't be read or is invalid, out is empty
+	MESH_CANCELLED,		// cancelled before decoding, out is untouched
+	MESH_UNKNOWN		// not a request of the loader, or already waited for
+};
+
+// a request of mesh_read_async, 0 for none
+typedef u32 MeshRequest;
+
+// a mesh for mesh_prefetch, the arguments of mesh_read_async
+struct MeshPrefetch {
+	const char* filename;
+	Mesh* out;
+	int priority;
+	bool keep_quantized;
+	u32 lod;
+};
+
+// loads meshes in the background: a single I/O thread reads whole files,
+// most urgent first, then decoders turn them into meshes with
+// mesh_read_memory (byte swap, decoding, decompression and dequantization),
+// also most urgent first. the I/O thread reads at most read_ahead bytes ahead
+// of the decoders. the blocks come from allocator (aligned heap memory by
+// default), which is called from the decoders and must be thread safe
+// (MeshPool isn't). destroying the loader cancels the requests not being
+// decoded yet and waits for the others
+class MeshLoader {
+public:
+	// n_decoders = 0 uses one decoder per hardware thread
+	MeshLoader(int n_decoders = 0, size_t read_ahead = 64 << 20, MeshAllocator* allocator = 0);
+	~MeshLoader();
+
+	int decoders() const { return (int) decoder_threads.size(); }
+
+private:
+	struct Request {
+		std::string filename;
+		Mesh* out;
+		int priority;
+		u32 order;			// of the requests, the first ones first at the same priority
+		bool keep_quantized;
+		u32 lod;
+		MeshStatus status;
+		bool decoding;		// taken by a decoder, too late to cancel
+		std::vector<u8> data;	// the file, between reading and decoding
+	};
+
+	// an entry of the queues, stale once the request moved on or got
+	// another priority (the queues are never searched, a request gets a new
+	// entry instead)
+	struct Entry {
+		int priority;
+		u32 order;
+		MeshRequest request;
+
+		bool operator<(const Entry& other) const {
+			return priority != other.priority ? priority < other.priority : order > other.order;
+		}
+	};
+
+	MeshRequest push(const MeshPrefetch& mesh);
+	bool pop(std::priority_queue<Entry>& queue, MeshStatus status, MeshRequest& request);
+	void finish(MeshRequest request, Request& r, MeshStatus status);
+	void read_loop();
+	void decode_loop();
+
+	MeshAllocator* allocator;
+	size_t read_ahead;
+
+	std::mutex lock;
+	std::condition_variable wake_reader;	// new requests, bytes decoded or stop
+	std::condition_variable wake_decoders;	// files read or stop
+	std::condition_variable finished_cond;	// a request finished
+
+	std::unordered_map<MeshRequest, Request*> requests;
+	std::priority_queue<Entry> reads;
+	std::priority_queue<Entry> decodes;
+	std::deque<MeshRequest> finished;	// for mesh_wait_any, in order
+	MeshRequest next;
+	size_t read_bytes;		// read, not decoded yet
+	bool stop;
+
+	std::thread reader;
+	std::vector<std::thread> decoder_threads;
+
+	friend MeshRequest mesh_read_async(MeshLoader&, const char*, Mesh&, int, bool, u32);
+	friend void mesh_prefetch(MeshLoader&, const MeshPrefetch*, u32, MeshRequest*);
+	friend bool mesh_reprioritize(MeshLoader&, MeshRequest, int);
+	friend bool mesh_cancel(MeshLoader&, MeshRequest);
+	friend MeshStatus mesh_status(MeshLoader&, MeshRequest);
+	friend MeshStatus mesh_wait(MeshLoader&, MeshRequest);
+	friend MeshRequest mesh_wait_any(MeshLoader&, MeshStatus*);
+
+	MeshLoader(const MeshLoader&);
+	MeshLoader& operator=(const MeshLoader&);
+};
+
+// queue the read of a .m file into out, as mesh_read would, higher
+// priorities first. out must not be used (or destroyed) until the request is
+// finished (see mesh_wait)
+MeshRequest mesh_read_async(MeshLoader& loader, const char* filename, Mesh& out, int priority = 0, bool keep_quantized = false, u32 lod = 0);
+
+// queue count reads at once, ie. the meshes of the next area of a level.
+// requests (if not 0) gets the request of each one
+void mesh_prefetch(MeshLoader& loader, const MeshPrefetch* meshes, u32 count, MeshRequest* requests = 0);
+
+// change the priority of a request not being decoded yet, false if it is
+// too late
+bool mesh_reprioritize(MeshLoader& loader, MeshRequest request, int priority);
+
+// drop a request not being decoded yet (MESH_CANCELLED), false if it is too
+// late. out stays as it is
+bool mesh_cancel(MeshLoader& loader, MeshRequest request);
+
+// where a request is, without waiting
+MeshStatus mesh_status(MeshLoader& loader, MeshRequest request);
+
+// wait until a request is finished (loaded, failed or cancelled), the
+// loader forgets it after
+MeshStatus mesh_wait(MeshLoader& loader, MeshRequest request);
+
+// wait until any request is finished and return it (in the order they
+// finish) with its status, the loader forgets it after. 0 if there are no
+// requests left to wait for
+MeshRequest mesh_wait_any(MeshLoader& loader, MeshStatus* status = 0);
+
+#endif
@@ -0,0 +1,520 @@
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "MeshCodec.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// the FIFOs of the index codec: a matching edge takes its position (0 to
+// EDGE_FIFO_CODES - 1) in the high nibble of the code byte, the third vertex
+// its position in the vertex FIFO plus 1 in the low nibble, 0 when it is the
+// next new vertex and 15 when it follows in the data. 0xF0 to 0xF7 code the
+// triangles without a matching edge, one bit per vertex that follows
+#define EDGE_FIFO_SIZE		16
+#define EDGE_FIFO_CODES		15
+#define VERTEX_FIFO_SIZE	16
+#define VERTEX_FIFO_CODES	14
+
+// at most 5 bytes per varint
+#define VARINT_SIZE			5
+
+static inline uint8_t zigzag8(uint8_t d) {
+	return (uint8_t) ((d << 1) ^ (uint8_t) ((int8_t) d >> 7));
+}
+
+static inline uint8_t unzigzag8(uint8_t z) {
+	return (uint8_t) ((z >> 1) ^ (uint8_t) -(z & 1));
+}
+
+static inline uint32_t zigzag32(uint32_t d) {
+	return (d << 1) ^ (uint32_t) ((int32_t) d >> 31);
+}
+
+static inline uint32_t unzigzag32(uint32_t z) {
+	return (z >> 1) ^ (uint32_t) -(int32_t) (z & 1);
+}
+
+static inline uint8_t* write_varint(uint8_t* p, uint32_t v) {
+	while (v >= 0x80) {
+		*p++ = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (uint8_t) v;
+	return p;
+}
+
+static inline bool read_varint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+	v = 0;
+	for (int shift = 0; shift < 7 * VARINT_SIZE; shift += 7) {
+		if (p == end)
+			return false;
+		uint8_t b = *p++;
+		v |= (uint32_t) (b & 0x7F) << shift;
+		if (b < 0x80)
+			return true;
+	}
+	return false;
+}
+
+// bits per delta of a group of 16 by the 2-bit code of the group
+static const int group_bits[4] = {0, 2, 4, 8};
+
+size_t encode_vertices_bound(size_t n_vertices, size_t stride) {
+	size_t n_blocks = (n_vertices + VERTEX_BLOCK_SIZE - 1) / VERTEX_BLOCK_SIZE;
+	size_t header = (VERTEX_BLOCK_SIZE / 16 + 3) / 4;
+	return n_vertices * stride + n_blocks * stride * (header + 15);
+}
+
+// the zigzagged deltas of count vertices (a multiple of 16 with zeros)
+static uint8_t* encode_deltas(uint8_t* p, const uint8_t* deltas, size_t count) {
+	size_t n_groups = (count + 15) / 16;
+	uint8_t* header = p;
+	memset(header, 0, (n_groups + 3) / 4);
+	p += (n_groups + 3) / 4;
+
+	for (size_t g = 0; g < n_groups; g++) {
+		const uint8_t* group = deltas + 16 * g;
+		uint8_t largest = 0;
+		for (int i = 0; i < 16; i++)
+			largest = max(largest, group[i]);
+
+		int code = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+		header[g / 4] |= (uint8_t) (code << (2 * (g % 4)));
+
+		if (code == 1) {
+			for (int i = 0; i < 16; i += 4)
+				*p++ = (uint8_t) (group[i] | group[i + 1] << 2 | group[i + 2] << 4 | group[i + 3] << 6);
+		}
+		else if (code == 2) {
+			for (int i = 0; i < 16; i += 2)
+				*p++ = (uint8_t) (group[i] | group[i + 1] << 4);
+		}
+		else if (code == 3) {
+			memcpy(p, group, 16);
+			p += 16;
+		}
+	}
+	return p;
+}
+
+#ifndef CODEC_SSE2
+// the group of 16 deltas coded on 0, 2, 4 or 8 bits at p
+static inline void unpack_group(const uint8_t*& p, int code, uint8_t group[16]) {
+	if (code == 0)
+		memset(group, 0, 16);
+	else if (code == 1) {
+		for (int i = 0; i < 16; i += 4, p++) {
+			group[i]		= *p & 3;
+			group[i + 1]	= (*p >> 2) & 3;
+			group[i + 2]	= (*p >> 4) & 3;
+			group[i + 3]	= *p >> 6;
+		}
+	}
+	else if (code == 2) {
+		for (int i = 0; i < 16; i += 2, p++) {
+			group[i]		= *p & 15;
+			group[i + 1]	= *p >> 4;
+		}
+	}
+	else {
+		memcpy(group, p, 16);
+		p += 16;
+	}
+}
+#endif
+
+#ifdef CODEC_SSE2
+// the group of 16 deltas coded on 0, 2, 4 or 8 bits at p, added up from value
+static inline __m128i unpack_group_sse2(const uint8_t*& p, int code, uint8_t value) {
+	__m128i z;
+	if (code == 0)
+		return _mm_set1_epi8((char) value);
+	else if (code == 1) {
+		uint32_t bits;
+		memcpy(&bits, p, 4);
+		p += 4;
+		__m128i v = _mm_cvtsi32_si128((int) bits);
+		__m128i mask = _mm_set1_epi8(3);
+		__m128i ab = _mm_unpacklo_epi8(_mm_and_si128(v, mask), _mm_and_si128(_mm_srli_epi16(v, 2), mask));
+		__m128i cd = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(_mm_srli_epi16(v, 6), mask));
+		z = _mm_unpacklo_epi16(ab, cd);
+	}
+	else if (code == 2) {
+		__m128i v = _mm_loadl_epi64((const __m128i*) p);
+		p += 8;
+		__m128i mask = _mm_set1_epi8(15);
+		z = _mm_unpacklo_epi8(_mm_and_si128(v, mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+	}
+	else {
+		z = _mm_loadu_si128((const __m128i*) p);
+		p += 16;
+	}
+
+	// unzigzag, then a prefix sum in 4 steps
+	__m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), _mm_set1_epi8(0x7F)),
+		_mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi8(1))));
+	d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+	d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+	d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+	d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+	return _mm_add_epi8(d, _mm_set1_epi8((char) value));
+}
+#endif
+
+// decode the deltas of a byte of count vertices and add them up from last
+// to row (count rounded up to 16 bytes)
+static bool decode_row(const uint8_t*& p, const uint8_t* end, uint8_t* row, size_t count, uint8_t& last) {
+	size_t n_groups = (count + 15) / 16;
+	size_t size_header = (n_groups + 3) / 4;
+	if ((size_t) (end - p) < size_header)
+		return false;
+
+	const uint8_t* header = p;
+	p += size_header;
+
+	uint8_t value = last;
+	for (size_t g = 0; g < n_groups; g++) {
+		int code = (header[g / 4] >> (2 * (g % 4))) & 3;
+		if ((size_t) (end - p) < (size_t) 2 * group_bits[code])
+			return false;
+
+		uint8_t* group = row + 16 * g;
+#ifdef CODEC_SSE2
+		_mm_storeu_si128((__m128i*) group, unpack_group_sse2(p, code, value));
+#else
+		unpack_group(p, code, group);
+		for (int i = 0; i < 16; i++) {
+			value += unzigzag8(group[i]);
+			group[i] = value;
+		}
+#endif
+		value = group[min((size_t) 16, count - 16 * g) - 1];
+	}
+
+	last = value;
+	return true;
+}
+
+// write the rows (a byte of VERTEX_BLOCK_SIZE vertices each) to the records
+// of count vertices
+static void transpose_rows(uint8_t* dst, const uint8_t* rows, size_t count, size_t stride) {
+	size_t k = 0;
+#ifdef CODEC_SSE2
+	// 4 bytes of 16 vertices at once
+	for (; stride % 4 == 0 && k < stride; k += 4) {
+		const uint8_t* row = rows + k * VERTEX_BLOCK_SIZE;
+		for (size_t v = 0; v < count; v += 16) {
+			__m128i r0 = _mm_loadu_si128((const __m128i*) (row + v));
+			__m128i r1 = _mm_loadu_si128((const __m128i*) (row + VERTEX_BLOCK_SIZE + v));
+			__m128i r2 = _mm_loadu_si128((const __m128i*) (row + 2 * VERTEX_BLOCK_SIZE + v));
+			__m128i r3 = _mm_loadu_si128((const __m128i*) (row + 3 * VERTEX_BLOCK_SIZE + v));
+
+			__m128i t0 = _mm_unpacklo_epi8(r0, r1);
+			__m128i t1 = _mm_unpackhi_epi8(r0, r1);
+			__m128i t2 = _mm_unpacklo_epi8(r2, r3);
+			__m128i t3 = _mm_unpackhi_epi8(r2, r3);
+
+			uint32_t words[16];
+			_mm_storeu_si128((__m128i*) words, _mm_unpacklo_epi16(t0, t2));
+			_mm_storeu_si128((__m128i*) (words + 4), _mm_unpackhi_epi16(t0, t2));
+			_mm_storeu_si128((__m128i*) (words + 8), _mm_unpacklo_epi16(t1, t3));
+			_mm_storeu_si128((__m128i*) (words + 12), _mm_unpackhi_epi16(t1, t3));
+
+			size_t n = min((size_t) 16, count - v);
+			uint8_t* out = dst + v * stride + k;
+			for (size_t i = 0; i < n; i++, out += stride)
+				memcpy(out, &words[i], 4);
+		}
+	}
+#endif
+	for (; k < stride; k++) {
+		const uint8_t* row = rows + k * VERTEX_BLOCK_SIZE;
+		uint8_t* out = dst + k;
+		for (size_t v = 0; v < count; v++, out += stride)
+			*out = row[v];
+	}
+}
+
+size_t encode_vertices(uint8_t* out, const uint8_t* vertices, size_t n_vertices, size_t stride) {
+	vector<uint8_t> last(stride, 0);
+	uint8_t deltas[VERTEX_BLOCK_SIZE];
+	uint8_t* p = out;
+
+	for (size_t start = 0; start < n_vertices; start += VERTEX_BLOCK_SIZE) {
+		size_t count = min((size_t) VERTEX_BLOCK_SIZE, n_vertices - start);
+		memset(deltas, 0, sizeof(deltas));
+
+		for (size_t k = 0; k < stride; k++) {
+			const uint8_t* src = vertices + start * stride + k;
+			uint8_t prev = last[k];
+			for (size_t v = 0; v < count; v++) {
+				uint8_t b = src[v * stride];
+				deltas[v] = zigzag8((uint8_t) (b - prev));
+				prev = b;
+			}
+			last[k] = prev;
+			p = encode_deltas(p, deltas, count);
+		}
+	}
+	return p - out;
+}
+
+bool decode_vertices(uint8_t* vertices, size_t n_vertices, size_t stride, const uint8_t* data, size_t size, size_t& used) {
+	// the bytes of a block row by row, then transposed to the records
+	vector<uint8_t> last(stride, 0);
+	vector<uint8_t> rows(stride * VERTEX_BLOCK_SIZE);
+	const uint8_t* p = data;
+	const uint8_t* end = data + size;
+
+	for (size_t start = 0; start < n_vertices; start += VERTEX_BLOCK_SIZE) {
+		size_t count = min((size_t) VERTEX_BLOCK_SIZE, n_vertices - start);
+		for (size_t k = 0; k < stride; k++) {
+			if (!decode_row(p, end, &rows[k * VERTEX_BLOCK_SIZE], count, last[k]))
+				return false;
+		}
+		transpose_rows(vertices + start * stride, rows.data(), count, stride);
+	}
+
+	used = p - data;
+	return true;
+}
+
+// the FIFOs of the index codec, the same on both sides
+struct IndexState {
+	uint32_t edges[EDGE_FIFO_SIZE][2];
+	uint32_t vertices[VERTEX_FIFO_SIZE];
+	uint32_t edge_offset;
+	uint32_t vertex_offset;
+	uint32_t next;		// the next new vertex
+	uint32_t last;		// the last vertex written in the data
+
+	IndexState() {
+		memset(this, 0, sizeof(*this));
+	}
+
+	void push_edge(uint32_t a, uint32_t b) {
+		edges[edge_offset][0] = a;
+		edges[edge_offset][1] = b;
+		edge_offset = (edge_offset + 1) % EDGE_FIFO_SIZE;
+	}
+
+	// the edge i pushes ago
+	const uint32_t* edge(int i) const {
+		return edges[(edge_offset + EDGE_FIFO_SIZE - 1 - i) % EDGE_FIFO_SIZE];
+	}
+
+	int find_edge(uint32_t a, uint32_t b) const {
+		for (int i = 0; i < EDGE_FIFO_CODES; i++) {
+			const uint32_t* e = edge(i);
+			if (e[0] == a && e[1] == b)
+				return i;
+		}
+		return -1;
+	}
+
+	void push_vertex(uint32_t v) {
+		vertices[vertex_offset] = v;
+		vertex_offset = (vertex_offset + 1) % VERTEX_FIFO_SIZE;
+	}
+
+	uint32_t vertex(int i) const {
+		return vertices[(vertex_offset + VERTEX_FIFO_SIZE - 1 - i) % VERTEX_FIFO_SIZE];
+	}
+
+	int find_vertex(uint32_t v) const {
+		for (int i = 0; i < VERTEX_FIFO_CODES; i++) {
+			if (vertex(i) == v)
+				return i;
+		}
+		return -1;
+	}
+
+	// the edges a neighbor of triangle a, b, c shares with it, as the
+	// neighbor has them (reversed)
+	void push_triangle(uint32_t a, uint32_t b, uint32_t c) {
+		push_edge(b, a);
+		push_edge(c, b);
+		push_edge(a, c);
+	}
+};
+
+size_t encode_indices_bound(size_t n_indices, bool triangles) {
+	return triangles ? n_indices / 3 * (1 + 3 * VARINT_SIZE) : n_indices * VARINT_SIZE;
+}
+
+size_t encode_indices(uint8_t* out, const uint32_t* indices, size_t n_indices, bool triangles) {
+	uint8_t* p = out;
+	IndexState state;
+
+	if (!triangles) {
+		for (size_t i = 0; i < n_indices; i++) {
+			p = write_varint(p, zigzag32(indices[i] - state.last));
+			state.last = indices[i];
+		}
+		return p - out;
+	}
+
+	// the codes, then the data
+	size_t n_tris = n_indices / 3;
+	uint8_t* codes = p;
+	p += n_tris;
+
+	for (size_t t = 0; t < n_tris; t++) {
+		uint32_t a = indices[3 * t], b = indices[3 * t + 1], c = indices[3 * t + 2];
+
+		// the rotation sharing an edge with a recent triangle
+		int fe = -1;
+		for (int r = 0; r < 3 && fe < 0; r++) {
+			fe = state.find_edge(a, b);
+			if (fe < 0) {
+				uint32_t first = a;
+				a = b;
+				b = c;
+				c = first;
+			}
+		}
+
+		if (fe >= 0) {
+			int fv = state.find_vertex(c);
+			int low;
+			if (c == state.next) {
+				low = 0;
+				state.next++;
+				state.push_vertex(c);
+			}
+			else if (fv >= 0)
+				low = 1 + fv;
+			else {
+				low = 15;
+				p = write_varint(p, zigzag32(c - state.last));
+				state.last = c;
+				state.push_vertex(c);
+			}
+
+			codes[t] = (uint8_t) (fe << 4 | low);
+			state.push_edge(c, b);
+			state.push_edge(a, c);
+			continue;
+		}
+
+		uint8_t code = 0xF0;
+		uint32_t tri[3] = {a, b, c};
+		for (int k = 0; k < 3; k++) {
+			if (tri[k] == state.next)
+				state.next++;
+			else {
+				code |= 1 << k;
+				p = write_varint(p, zigzag32(tri[k] - state.last));
+				state.last = tri[k];
+			}
+			state.push_vertex(tri[k]);
+		}
+		codes[t] = code;
+		state.push_triangle(a, b, c);
+	}
+	return p - out;
+}
+
+// out[i] = v on the index size of out
+template <typename T>
+static bool store_index(void* out, size_t i, uint32_t v) {
+	if (v > (T) ~0u)
+		return false;
+	((T*) out)[i] = (T) v;
+	return true;
+}
+
+template <typename T>
+static bool decode_indices_as(T* out, size_t n_indices, bool triangles, const uint8_t* data, size_t size, size_t& used) {
+	const uint8_t* p = data;
+	const uint8_t* end = data + size;
+	IndexState state;
+
+	if (!triangles) {
+		for (size_t i = 0; i < n_indices; i++) {
+			uint32_t z;
+			if (!read_varint(p, end, z))
+				return false;
+			state.last += unzigzag32(z);
+			if (!store_index<T>(out, i, state.last))
+				return false;
+		}
+		used = p - data;
+		return true;
+	}
+
+	size_t n_tris = n_indices / 3;
+	if (size < n_tris)
+		return false;
+	const uint8_t* codes = p;
+	p += n_tris;
+
+	for (size_t t = 0; t < n_tris; t++) {
+		uint8_t code = codes[t];
+		uint32_t tri[3];
+
+		if (code < 0xF0) {
+			const uint32_t* e = state.edge(code >> 4);
+			uint32_t a = e[0], b = e[1], c;
+			int low = code & 15;
+			if (low == 0) {
+				c = state.next++;
+				state.push_vertex(c);
+			}
+			else if (low <= VERTEX_FIFO_CODES)
+				c = state.vertex(low - 1);
+			else {
+				uint32_t z;
+				if (!read_varint(p, end, z))
+					return false;
+				c = state.last += unzigzag32(z);
+				state.push_vertex(c);
+			}
+
+			state.push_edge(c, b);
+			state.push_edge(a, c);
+			tri[0] = a;
+			tri[1] = b;
+			tri[2] = c;
+		}
+		else {
+			if (code > 0xF7)
+				return false;
+			for (int k = 0; k < 3; k++) {
+				if (code & (1 << k)) {
+					uint32_t z;
+					if (!read_varint(p, end, z))
+						return false;
+					tri[k] = state.last += unzigzag32(z);
+				}
+				else
+					tri[k] = state.next++;
+				state.push_vertex(tri[k]);
+			}
+			state.push_triangle(tri[0], tri[1], tri[2]);
+		}
+
+		for (int k = 0; k < 3; k++) {
+			if (!store_index<T>(out, 3 * t + k, tri[k]))
+				return false;
+		}
+	}
+
+	used = p - data;
+	return true;
+}
+
+bool decode_indices(void* indices, size_t n_indices, int index_size, bool triangles, const uint8_t* data, size_t size, size_t& used) {
+	switch (index_size) {
+		case 1:		return decode_indices_as((uint8_t*) indices, n_indices, triangles, data, size, used);
+		case 2:		return decode_indices_as((uint16_t*) indices, n_indices, triangles, data, size, used);
+		case 4:		return decode_indices_as((uint32_t*) indices, n_indices, triangles, data, size, used);
+		default:	return false;
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef _MESH_CODEC_H_
+#define _MESH_CODEC_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// lossless compression of the vertex and index data of the .m files
+// (MESH_ENCODED), shared by the converter and the reader. the decoders
+// never read out of data and return false on a malformed stream
+
+// vertex streams: n_vertices records of stride bytes, in blocks of
+// VERTEX_BLOCK_SIZE vertices. each byte of the records is delta coded
+// against the same byte of the previous vertex, and the deltas of 16
+// vertices are packed on 0, 2, 4 or 8 bits. the bytes are coded as they
+// are, so the streams keep the byte order of the file
+#define VERTEX_BLOCK_SIZE 256
+
+// the largest size encode_vertices can write
+size_t encode_vertices_bound(size_t n_vertices, size_t stride);
+
+// encode the records to out, returns the bytes written
+size_t encode_vertices(uint8_t* out, const uint8_t* vertices, size_t n_vertices, size_t stride);
+
+// decode n_vertices records of stride bytes from data (size bytes at most),
+// used is set to the bytes of the stream
+bool decode_vertices(uint8_t* vertices, size_t n_vertices, size_t stride, const uint8_t* data, size_t size, size_t& used);
+
+// index streams. triangle lists take a code byte per triangle, from a
+// FIFO of recent edges and one of recent vertices, followed by the vertices
+// that aren't in them as varint deltas; each triangle may start on another
+// of its vertices, with the same winding. other primitives (the strips)
+// are varint deltas from index to index. the indices are values, the
+// decoder writes them on index_size bytes in the host byte order
+
+// the largest size encode_indices can write
+size_t encode_indices_bound(size_t n_indices, bool triangles);
+
+// encode n_indices indices to out, returns the bytes written
+size_t encode_indices(uint8_t* out, const uint32_t* indices, size_t n_indices, bool triangles);
+
+// decode n_indices indices on index_size bytes (1, 2 or 4) from data
+// (size bytes at most), used is set to the bytes of the stream
+bool decode_indices(void* indices, size_t n_indices, int index_size, bool triangles, const uint8_t* data, size_t size, size_t& used);
+
+#endif
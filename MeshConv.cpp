@@ -1,45 +1,48 @@
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <cstdarg>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
 #include <assert.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
 #include <assimp\mesh.h>
 #include <assimp\Importer.hpp>
 #include <assimp\scene.h>
 #include <assimp\postprocess.h>
 
-using namespace std;
-
-// swap the bytes in a float (to change big/little-endian
-inline float swap_f32(float f) {
-	union {
-		float f;
-		uint8_t b[4];
-	} u1, u2;
-
-	u1.f = f;
-	u2.b[0] = u1.b[3];
-	u2.b[1] = u1.b[2];
-	u2.b[2] = u1.b[1];
-	u2.b[3] = u1.b[0];
-	return u2.f;
-}
-
-inline uint16_t swap_u16(uint16_t i) {
-	union {
-		uint16_t i;
-		uint8_t b[2];
-	} u1, u2;
+#include "ByteSwap.h"
+#include "MeshFormat.h"
+#include "Bench.h"
+#include "ThreadPool.h"
+#include "BuildCache.h"
+#include "Hash.h"
+#include "MeshData.h"
+#include "objloader.h"
+#include "MeshOptimize.h"
+#include "MeshCodec.h"
+#include "Compress.h"
+#include "Bounds.h"
+#include "PackWriter.h"
 
-	u1.i = i;
-	u2.b[0] = u1.b[1];
-	u2.b[1] = u1.b[0];
-	return u2.i;
-}
-
-typedef void (*CopyDataFunc)(float*, const aiVector3D&, int&);
+using namespace std;
 
 uint32_t g_process_flags = 
 	aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_OptimizeMeshes |
@@ -53,255 +56,926 @@ uint32_t g_process_flags =
 //		aiProcess_JoinIdenticalVertices	|
 //		aiProcess_SortByPType;
 
-void CopyData_2f(float* dest, const aiVector3D& src, int& idx) {
-	dest[idx]	= swap_f32(src.x);
-	dest[idx+1] = swap_f32(src.y);
+// print the conversion details, off in batch mode unless --verbose
+bool g_verbose = true;
+
+// dump the imported scene before converting it (--info)
+bool g_mesh_info = false;
+
+// skip the meshes whose inputs didn't change since they were converted (see
+// BuildCache.h), --force converts everything
+bool g_use_cache = true;
+
+void Log(const char* format, ...) {
+	if (!g_verbose)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+// read the .obj files with ObjReader instead of Assimp (--fast-obj)
+bool g_fast_obj = false;
+
+// threads parsing each .obj with --fast-obj, all the cores for a single mesh
+// (a batch already runs a mesh per core)
+int g_obj_threads = 1;
+
+// reorder the triangles of each submesh for a post-transform vertex cache of
+// this size (--vcache), 0 keeps the imported order
+int g_vcache_size = 0;
+
+// reorder clusters of triangles of each submesh to reduce overdraw after the
+// vertex cache pass (--overdraw), a cluster ends where its ACMR is below this
+// times the ACMR of its run. 0 is off
+float g_overdraw_threshold = 0;
+
+// renumber the vertices of each submesh in the order the triangles use them
+// (--vfetch), after the triangle reordering
+bool g_vertex_fetch = false;
+
+// write the submeshes as triangle strips (--strip), MESH_TRIANGLE_STRIP or
+// MESH_TRIANGLE_STRIP_RESTART, MESH_TRIANGLES keeps the lists
+int g_strip = MESH_TRIANGLES;
+
+// levels of detail 1 and up (--lod, --lod-error), each one simplified from
+// the full detail down to ratio times its triangles (0 for as few as the
+// error allows) or to an error of error times the size of the mesh
+struct LodTarget {
+	float ratio;
+	float error;
+};
+std::vector<LodTarget> g_lods;
+
+// largest vertex and triangle counts of the meshlets of the full detail
+// (--meshlets), 0 for no meshlets
+int g_meshlet_vertices = 0;
+int g_meshlet_triangles = 0;
+
+// quantized vertex arrays (--quantize), MESH_POSITION_S16... with the
+// fractional bits of the texcoords (--uv-shift). 0 writes f32 arrays
+uint16_t g_vertex_format = 0;
 
-	idx += 2;
+// byte order of the .m files (--endian), big-endian for the console by default
+bool g_big_endian = true;
+
+// the output byte order isn't the host's
+inline bool SwapOutput() {
+	return g_big_endian != host_big_endian();
 }
 
-void CopyData_3f(float* dest, const aiVector3D& src, int& idx) {
-	dest[idx]	= swap_f32(src.x);
-	dest[idx+1] = swap_f32(src.y);
-	dest[idx+2] = swap_f32(src.z);
+// convert arrays to the output byte order in place
+inline void ToOutput32(void* data, size_t count) {
+	if (SwapOutput())
+		swap32(data, data, count);
+}
 
-	idx += 3;
+inline void ToOutput16(void* data, size_t count) {
+	if (SwapOutput())
+		swap16(data, data, count);
 }
 
-void WriteData(ofstream& outFile, aiVector3D* data_src, int n, int element_size, CopyDataFunc copyFunc) {
-	int n_elements = n * element_size;
-	float* data_out = new float[n_elements];
-	
-	for (int i = 0, v = 0; i < n; i++)
-		copyFunc(data_out, data_src[i], v);
+// write count floats in the output byte order
+void WriteData(std::ostream& outFile, const float* data_src, size_t count) {
+	if (count == 0)
+		return;
 
-	outFile.write((char*)data_out, n_elements * sizeof(float));
-	delete data_out;
+	if (!SwapOutput()) {
+		outFile.write((const char*)data_src, count * sizeof(float));
+		return;
+	}
+
+	std::vector<float> data_out(count);
+	swap32(&data_out[0], data_src, count);
+	outFile.write((char*)&data_out[0], count * sizeof(float));
+}
+
+// bytes of the position (0), normal (1) or texcoord (2) of a vertex in
+// g_vertex_format
+uint16_t AttributeSize(int attribute) {
+	switch (attribute) {
+		case 0:		return g_vertex_format & MESH_POSITION_S16 ? 3 * sizeof(int16_t) : 3 * sizeof(float);
+		case 1:		return g_vertex_format & MESH_NORMAL_S8 ? 3 * sizeof(int8_t) : 3 * sizeof(float);
+		default:	return g_vertex_format & MESH_TEXCOORD_S16 ? 2 * sizeof(int16_t) : 2 * sizeof(float);
+	}
 }
 
-void WriteHeader(ofstream& output, const aiScene* pScene, uint16_t len_material) {
+// stride and offsets of the interleaved vertex records of g_vertex_format:
+// position, normal and texcoord in order, each aligned to its elements,
+// the records to 4 bytes. 32 bytes with f32 arrays, 16 all quantized
+void VertexLayout(uint16_t layout[4]) {
+	uint16_t offset = 0;
+	for (int a = 0; a < 3; a++) {
+		uint16_t alignment = AttributeSize(a) / (a == 2 ? 2 : 3);
+		offset = (offset + alignment - 1) & ~(alignment - 1);
+		layout[1 + a] = offset;
+		offset += AttributeSize(a);
+	}
+	layout[0] = (offset + 3) & ~3;
+}
+
+// bytes per index of a submesh at a level of detail, the smallest size
+// holding its vertex indices (and the restart index, with all the bits set)
+uint8_t IndexSize(const SubMeshData& subMesh, int lod = 0) {
+	uint32_t n_vertices = subMesh.n_vertices();
+	if (subMesh.lod(lod).primitive == MESH_TRIANGLE_STRIP_RESTART)
+		n_vertices++;
+	if (n_vertices <= 0x100)
+		return 1;
+	if (n_vertices <= 0x10000)
+		return 2;
+	return 4;
+}
+
+// bytes of the indices of a submesh in the .m file, padded to 4 so the
+// indices of the next one stay aligned
+uint32_t IndicesSize(const SubMeshData& subMesh, int lod = 0) {
+	return (subMesh.lod(lod).indices.size() * IndexSize(subMesh, lod) + 3) & ~3;
+}
+
+void WriteHeader(ofstream& output, const MeshData& mesh, uint32_t indices_size, uint16_t len_material) {
 	//n_vertex, n_normals, n_texcoord, n_faces, n_submeshes
 	
 	// compute total of vertices
-	uint16_t n_vertices = 0;
-	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++)
-		n_vertices += pScene->mMeshes[i]->mNumVertices;
+	uint32_t n_vertices = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++)
+		n_vertices += mesh.subMeshes[i].n_vertices();
 
 	// compute total of faces
-	uint16_t n_faces = 0;
-	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++)
-		n_faces += pScene->mMeshes[i]->mNumFaces;
+	uint32_t n_faces = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++)
+		n_faces += mesh.subMeshes[i].n_tris();
+
+	uint32_t n_subMeshes = mesh.subMeshes.size();
+
+	uint16_t version[] = {MESH_BOM, MESH_VERSION};
+	uint32_t counts[] = {n_vertices, n_faces, n_subMeshes, indices_size};
+	uint16_t material[] = {len_material, g_vertex_format};
+	ToOutput16(version, 2);
+	ToOutput32(counts, 4);
+	ToOutput16(material, 2);
+
+	output.write(MESH_MAGIC, 4);
+	output.write((char*)version, sizeof(version));
+	output.write((char*)counts, sizeof(counts));
+	output.write((char*)material, sizeof(material));
+
+	if (g_vertex_format & MESH_INTERLEAVED) {
+		uint16_t layout[4];
+		VertexLayout(layout);
+		Log("Vertex layout: %d bytes, offsets %d %d %d\n", layout[0], layout[1], layout[2], layout[3]);
+		ToOutput16(layout, 4);
+		output.write((char*)layout, sizeof(layout));
+	}
 
-	uint16_t n_subMeshes = pScene->mNumMeshes;
+	// the triangle count, index data size and error of each level of detail
+	uint32_t n_lods = mesh.n_lods();
+	ToOutput32(&n_lods, 1);
+	output.write((char*)&n_lods, sizeof(n_lods));
+	for (int lod = 0; lod < mesh.n_lods(); lod++) {
+		uint32_t record[3] = {0, 0, 0};
+		for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+			record[0] += mesh.subMeshes[i].lod(lod).n_tris();
+			record[1] += IndicesSize(mesh.subMeshes[i], lod);
+		}
+		memcpy(&record[2], &mesh.lod_errors[lod], sizeof(float));
+		if (lod > 0)
+			Log("LOD %d: %d faces, error %g\n", lod, record[0], mesh.lod_errors[lod]);
+		ToOutput32(record, 3);
+		output.write((char*)record, sizeof(record));
+	}
 
-	uint16_t header[] = {n_vertices, n_faces, n_subMeshes, len_material};
-	header[0] = swap_u16(header[0]);
-	header[1] = swap_u16(header[1]);
-	header[2] = swap_u16(header[2]);
-	header[3] = swap_u16(header[3]);
+	// the meshlet, meshlet vertex and meshlet triangle counts
+	if (g_vertex_format & MESH_MESHLETS) {
+		uint32_t meshlet_counts[3] = {0, 0, 0};
+		for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+			const std::vector<MeshletData>& meshlets = mesh.subMeshes[i].meshlets;
+			meshlet_counts[0] += (uint32_t) meshlets.size();
+			for (size_t m = 0; m < meshlets.size(); m++) {
+				meshlet_counts[1] += (uint32_t) meshlets[m].vertices.size();
+				meshlet_counts[2] += (uint32_t) meshlets[m].triangles.size() / 3;
+			}
+		}
+		Log("Meshlets: %d, %d vertices, %d triangles\n", meshlet_counts[0], meshlet_counts[1], meshlet_counts[2]);
+		ToOutput32(meshlet_counts, 3);
+		output.write((char*)meshlet_counts, sizeof(meshlet_counts));
+	}
 
-	output.write((char*)header, 4 * sizeof(uint16_t));
+	Log("Total_Vertices: %d\n", n_vertices);
+	Log("Total_Faces: %d\n", n_faces);
+	Log("Total_Submeshes: %d\n", n_subMeshes);
+}
 
-	printf("Total_Vertices: %d\n", n_vertices);
-	printf("Total_Faces: %d\n", n_faces);
-	printf("Total_Submeshes: %d\n", n_subMeshes);
+// size of the material name in the .m file, padded so the arrays that follow
+// stay 4-byte aligned and can be used in place by mesh_map
+uint16_t MaterialNameSize(const std::string& materialName) {
+	return (materialName.length() + 1 + 3) & ~3;
 }
 
 void WriteMaterialName(ofstream& output, const std::string materialName) {
 	const char* name = materialName.c_str();
-	int size = materialName.length()+1;
-	printf("Material Name=%s, size=%d\n", name, size);
-	output.write(name, size);
+	int size = MaterialNameSize(materialName);
+	Log("Material Name=%s, size=%d\n", name, size);
+
+	char padding[4] = {0, 0, 0, 0};
+	int len = materialName.length();
+	output.write(name, len);
+	output.write(padding, size - len);
 }
 
-void WritePositions(ofstream& output, const aiScene* pScene) {
-	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
-		WriteData(output, mesh->mVertices, mesh->mNumVertices, 3, CopyData_3f);
+// offset x, y, z and scale x, y, z of the s16 positions of a submesh (the
+// PositionQuant records of the .m file): its bounds on 65536 steps
+void PositionQuantization(const SubMeshData& subMesh, float quant[6]) {
+	float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+	float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	for (size_t j = 0; j < subMesh.positions.size(); j++) {
+		lo[j % 3] = std::min(lo[j % 3], subMesh.positions[j]);
+		hi[j % 3] = std::max(hi[j % 3], subMesh.positions[j]);
+	}
+
+	for (int k = 0; k < 3; k++) {
+		if (lo[k] > hi[k])
+			lo[k] = hi[k] = 0;
+		quant[3 + k] = (hi[k] - lo[k]) / 65535.0f;
+		quant[k] = lo[k] + 32768.0f * quant[3 + k];
 	}
 }
 
-void WriteNormals(ofstream& output, const aiScene* pScene) {
-	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
-		WriteData(output, mesh->mNormals, mesh->mNumVertices, 3, CopyData_3f);
+// the largest distance an s16 position of a submesh can move from its f32
+// one, half a step of its quantization. 0 with f32 positions
+float PositionError(const SubMeshData& subMesh) {
+	if (!(g_vertex_format & MESH_POSITION_S16))
+		return 0;
+	float quant[6];
+	PositionQuantization(subMesh, quant);
+	return 0.5f * sqrtf(quant[3] * quant[3] + quant[4] * quant[4] + quant[5] * quant[5]);
+}
+
+// the bounds of the whole mesh, then of each submesh (the MeshBounds records
+// ending the header), of the vertices as the reader gets them: s16 positions
+// stay in the box their quantization spans, but can move out of the sphere
+void WriteBounds(ofstream& output, const MeshData& mesh) {
+	std::vector<Bounds> bounds(1 + mesh.subMeshes.size());
+	std::vector<float> positions;
+	float error = 0;
+	for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		float subMesh_error = PositionError(subMesh);
+		bounds[1 + i] = ComputeBounds(subMesh.positions.data(), subMesh.n_vertices());
+		bounds[1 + i].radius += subMesh_error;
+		error = std::max(error, subMesh_error);
+		positions.insert(positions.end(), subMesh.positions.begin(), subMesh.positions.end());
 	}
+	bounds[0] = ComputeBounds(positions.data(), positions.size() / 3);
+	bounds[0].radius += error;
+
+	const Bounds& b = bounds[0];
+	Log("Bounds: (%g, %g, %g) to (%g, %g, %g), sphere (%g, %g, %g) radius %g\n",
+		b.min[0], b.min[1], b.min[2], b.max[0], b.max[1], b.max[2], b.center[0], b.center[1], b.center[2], b.radius);
+
+	static_assert(sizeof(Bounds) == MESH_BOUNDS_SIZE, "Bounds must match the .m bounds records");
+	WriteData(output, (const float*) bounds.data(), bounds.size() * sizeof(Bounds) / sizeof(float));
 }
 
-void WriteTexCoord(ofstream& output, const aiScene* pScene) {
-	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
-		if (mesh->HasTextureCoords(0))
-			WriteData(output, mesh->mTextureCoords[0], mesh->mNumVertices, 2, CopyData_2f);
+int16_t QuantizePosition(float p, float offset, float scale) {
+	if (scale == 0)
+		return 0;
+	float q = floorf((p - offset) / scale + 0.5f);
+	return (int16_t) std::min(std::max(q, -32768.0f), 32767.0f);
+}
+
+int8_t QuantizeNormal(float n) {
+	float q = floorf(n * 127.0f + 0.5f);
+	return (int8_t) std::min(std::max(q, -127.0f), 127.0f);
+}
+
+// fixed point with the --uv-shift fractional bits, clamped to the s16 range
+int16_t QuantizeTexCoord(float t) {
+	float q = floorf(t * (1 << MESH_TEXCOORD_SHIFT(g_vertex_format)) + 0.5f);
+	return (int16_t) std::min(std::max(q, -32768.0f), 32767.0f);
+}
+
+// zeros up to the next multiple of 4 bytes after an array of size bytes, so
+// the quantized arrays keep the next ones aligned
+void WritePadding(std::ostream& output, size_t size) {
+	char padding[4] = {0, 0, 0, 0};
+	output.write(padding, (4 - size % 4) % 4);
+}
+
+void WriteData16(std::ostream& output, std::vector<int16_t>& data) {
+	ToOutput16(data.data(), data.size());
+	output.write((char*) data.data(), data.size() * sizeof(int16_t));
+}
+
+void WritePositions(std::ostream& output, const MeshData& mesh) {
+	size_t size = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const std::vector<float>& positions = mesh.subMeshes[i].positions;
+		if (!(g_vertex_format & MESH_POSITION_S16)) {
+			WriteData(output, positions.data(), positions.size());
+			continue;
+		}
+
+		float quant[6];
+		PositionQuantization(mesh.subMeshes[i], quant);
+		std::vector<int16_t> data(positions.size());
+		for (size_t j = 0; j < positions.size(); j++)
+			data[j] = QuantizePosition(positions[j], quant[j % 3], quant[3 + j % 3]);
+		WriteData16(output, data);
+		size += data.size() * sizeof(int16_t);
 	}
+	WritePadding(output, size);
 }
 
-void WriteIndices(ofstream& output, const aiScene* pScene) {
-	int acc = 0;
-	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
+void WriteNormals(std::ostream& output, const MeshData& mesh) {
+	size_t size = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const std::vector<float>& normals = mesh.subMeshes[i].normals;
+		if (!(g_vertex_format & MESH_NORMAL_S8)) {
+			WriteData(output, normals.data(), normals.size());
+			continue;
+		}
 
-		int n_indices = 3 * mesh->mNumFaces;
-		uint16_t* indices = new uint16_t[n_indices];
+		std::vector<int8_t> data(normals.size());
+		for (size_t j = 0; j < normals.size(); j++)
+			data[j] = QuantizeNormal(normals[j]);
+		output.write((char*) data.data(), data.size());
+		size += data.size();
+	}
+	WritePadding(output, size);
+}
 
-		for (uint32_t f = 0, idx=0; f < mesh->mNumFaces ; f++) {
-			const aiFace& face = mesh->mFaces[f];
-			assert(face.mNumIndices == 3);
-			indices[idx]	= swap_u16(acc + face.mIndices[0]);
-			indices[idx+1]  = swap_u16(acc + face.mIndices[1]);
-			indices[idx+2]  = swap_u16(acc + face.mIndices[2]);
+void WriteTexCoord(std::ostream& output, const MeshData& mesh) {
+	size_t size = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
 
-			idx += 3;
+		// every vertex has texture coordinates in the file, 0 if it has none
+		std::vector<float> zero;
+		const std::vector<float>& texcoords = subMesh.texcoords.empty() ? zero : subMesh.texcoords;
+		if (subMesh.texcoords.empty())
+			zero.resize(2 * subMesh.n_vertices(), 0.0f);
+
+		if (!(g_vertex_format & MESH_TEXCOORD_S16)) {
+			WriteData(output, texcoords.data(), texcoords.size());
+			continue;
 		}
 
-		output.write((char*)indices, n_indices * sizeof(uint16_t));
-		delete[] indices;
+		std::vector<int16_t> data(texcoords.size());
+		for (size_t j = 0; j < texcoords.size(); j++)
+			data[j] = QuantizeTexCoord(texcoords[j]);
+		WriteData16(output, data);
+		size += data.size() * sizeof(int16_t);
+	}
+	WritePadding(output, size);
+}
+
+// the vertices as records of VertexLayout, with the attributes quantized as
+// g_vertex_format says. the records keep the following arrays aligned
+void WriteVertices(std::ostream& output, const MeshData& mesh) {
+	uint16_t layout[4];
+	VertexLayout(layout);
+	uint16_t stride = layout[0];
+
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		size_t n_vertices = subMesh.n_vertices();
+
+		float quant[6];
+		if (g_vertex_format & MESH_POSITION_S16)
+			PositionQuantization(subMesh, quant);
+
+		std::vector<uint8_t> data(n_vertices * stride, 0);
+		for (size_t v = 0; v < n_vertices; v++) {
+			uint8_t* record = &data[v * stride];
+
+			const float* position = &subMesh.positions[3 * v];
+			if (g_vertex_format & MESH_POSITION_S16) {
+				int16_t p[3];
+				for (int k = 0; k < 3; k++)
+					p[k] = QuantizePosition(position[k], quant[k], quant[3 + k]);
+				ToOutput16(p, 3);
+				memcpy(record + layout[1], p, sizeof(p));
+			}
+			else {
+				float p[3] = {position[0], position[1], position[2]};
+				ToOutput32(p, 3);
+				memcpy(record + layout[1], p, sizeof(p));
+			}
+
+			const float* normal = &subMesh.normals[3 * v];
+			if (g_vertex_format & MESH_NORMAL_S8) {
+				int8_t n[3];
+				for (int k = 0; k < 3; k++)
+					n[k] = QuantizeNormal(normal[k]);
+				memcpy(record + layout[2], n, sizeof(n));
+			}
+			else {
+				float n[3] = {normal[0], normal[1], normal[2]};
+				ToOutput32(n, 3);
+				memcpy(record + layout[2], n, sizeof(n));
+			}
 
-		acc += mesh->mNumVertices;
+			// 0 for the vertices without texture coordinates
+			float texcoord[2] = {0.0f, 0.0f};
+			if (!subMesh.texcoords.empty()) {
+				texcoord[0] = subMesh.texcoords[2 * v];
+				texcoord[1] = subMesh.texcoords[2 * v + 1];
+			}
+			if (g_vertex_format & MESH_TEXCOORD_S16) {
+				int16_t t[2] = {QuantizeTexCoord(texcoord[0]), QuantizeTexCoord(texcoord[1])};
+				ToOutput16(t, 2);
+				memcpy(record + layout[3], t, sizeof(t));
+			}
+			else {
+				ToOutput32(texcoord, 2);
+				memcpy(record + layout[3], texcoord, sizeof(texcoord));
+			}
+		}
+		output.write((char*) data.data(), data.size());
 	}
 }
 
-void WriteSubMeshes(ofstream& output, const aiScene* pScene) {
-	int n_elements = 2*pScene->mNumMeshes;
+// the PositionQuant records of the submeshes, with quantized positions
+void WriteQuantization(std::ostream& output, const MeshData& mesh) {
+	if (!(g_vertex_format & MESH_POSITION_S16))
+		return;
 
-	uint16_t* subMeshes = new uint16_t[n_elements];
-	uint16_t start = 0;
-	for (uint32_t i = 0, m = 0; i < pScene->mNumMeshes ; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
-	
-		uint16_t n_tris = mesh->mNumFaces;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		float quant[6];
+		PositionQuantization(mesh.subMeshes[i], quant);
+		WriteData(output, quant, 6);
+	}
+}
+
+// the largest errors of the quantized arrays and the bytes they save
+void QuantizationInfo(const MeshData& mesh) {
+	if (!(g_vertex_format & MESH_QUANTIZED))
+		return;
+
+	float position = 0, normal = 0, texcoord = 0;
+	size_t n_vertices = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		n_vertices += subMesh.n_vertices();
+
+		float quant[6];
+		PositionQuantization(subMesh, quant);
+		for (size_t j = 0; j < subMesh.positions.size(); j++) {
+			float p = subMesh.positions[j];
+			float q = QuantizePosition(p, quant[j % 3], quant[3 + j % 3]);
+			position = std::max(position, fabsf(quant[j % 3] + q * quant[3 + j % 3] - p));
+		}
+		for (size_t j = 0; j < subMesh.normals.size(); j++) {
+			float n = subMesh.normals[j];
+			normal = std::max(normal, fabsf(QuantizeNormal(n) / 127.0f - n));
+		}
+		for (size_t j = 0; j < subMesh.texcoords.size(); j++) {
+			float t = subMesh.texcoords[j];
+			texcoord = std::max(texcoord, fabsf(QuantizeTexCoord(t) / (float) (1 << MESH_TEXCOORD_SHIFT(g_vertex_format)) - t));
+		}
+	}
+
+	size_t size = n_vertices * 8 * sizeof(float);
+	size_t size_quantized = 0;
+	if (g_vertex_format & MESH_POSITION_S16)
+		size_quantized += ((n_vertices * 3 * sizeof(int16_t) + 3) & ~3) + mesh.subMeshes.size() * MESH_QUANT_SIZE;
+	else
+		size_quantized += n_vertices * 3 * sizeof(float);
+	if (g_vertex_format & MESH_NORMAL_S8)
+		size_quantized += (n_vertices * 3 + 3) & ~3;
+	else
+		size_quantized += n_vertices * 3 * sizeof(float);
+	if (g_vertex_format & MESH_TEXCOORD_S16)
+		size_quantized += n_vertices * 2 * sizeof(int16_t);
+	else
+		size_quantized += n_vertices * 2 * sizeof(float);
+
+	// the records replace the arrays, with their padding
+	if (g_vertex_format & MESH_INTERLEAVED) {
+		uint16_t layout[4];
+		VertexLayout(layout);
+		size_quantized = n_vertices * layout[0];
+		if (g_vertex_format & MESH_POSITION_S16)
+			size_quantized += mesh.subMeshes.size() * MESH_QUANT_SIZE;
+	}
+
+	Log("Quantized vertices: %u -> %u bytes (%.1f%% saved), max error:", (unsigned) size, (unsigned) size_quantized,
+		size ? 100.0 * (size - (double) size_quantized) / size : 0.0);
+	if (g_vertex_format & MESH_POSITION_S16)
+		Log(" position %g", position);
+	if (g_vertex_format & MESH_NORMAL_S8)
+		Log(" normal %g", normal);
+	if (g_vertex_format & MESH_TEXCOORD_S16)
+		Log(" texcoord %g", texcoord);
+	Log("\n");
+}
+
+// the indices of each submesh at a level of detail, relative to its first
+// vertex, on IndexSize bytes. STRIP_RESTART keeps all its bits set at any size
+void WriteIndices(std::ostream& output, const MeshData& mesh, int lod = 0) {
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		const std::vector<uint32_t>& src = subMesh.lod(lod).indices;
+
+		uint8_t index_size = IndexSize(subMesh, lod);
+		std::vector<uint8_t> indices(IndicesSize(subMesh, lod), 0);
+		if (indices.empty())
+			continue;
+
+		if (index_size == 1) {
+			for (size_t idx = 0; idx < src.size(); idx++)
+				indices[idx] = (uint8_t) src[idx];
+		}
+		else if (index_size == 2) {
+			uint16_t* dst = (uint16_t*) &indices[0];
+			for (size_t idx = 0; idx < src.size(); idx++)
+				dst[idx] = (uint16_t) src[idx];
+			ToOutput16(dst, src.size());
+		}
+		else {
+			memcpy(&indices[0], &src[0], src.size() * sizeof(uint32_t));
+			ToOutput32(&indices[0], src.size());
+		}
+
+		output.write((char*)&indices[0], indices.size());
+	}
+}
+
+// a section of encoded data (--encode): its size, then the data padded to 4 bytes
+void WriteEncoded(ofstream& output, const std::vector<uint8_t>& data) {
+	uint32_t size = (uint32_t) data.size();
+	ToOutput32(&size, 1);
+	output.write((char*)&size, sizeof(size));
+	output.write((const char*)data.data(), data.size());
+	WritePadding(output, data.size());
+}
+
+// append the encoding of n_vertices records of stride bytes to data
+void EncodeVertices(std::vector<uint8_t>& data, const std::string& vertices, size_t n_vertices, size_t stride) {
+	size_t offset = data.size();
+	data.resize(offset + encode_vertices_bound(n_vertices, stride));
+	data.resize(offset + encode_vertices(data.data() + offset, (const uint8_t*) vertices.data(), n_vertices, stride));
+}
+
+// the vertex arrays (or records) as they would be written, encoded with
+// MeshCodec: a stream per array, or one for the records
+void WriteEncodedVertices(ofstream& output, const MeshData& mesh) {
+	size_t n_vertices = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++)
+		n_vertices += mesh.subMeshes[i].n_vertices();
+
+	std::vector<uint8_t> data;
+	size_t size = 0;
+	if (g_vertex_format & MESH_INTERLEAVED) {
+		uint16_t layout[4];
+		VertexLayout(layout);
+		std::ostringstream records;
+		WriteVertices(records, mesh);
+		EncodeVertices(data, records.str(), n_vertices, layout[0]);
+		size = records.str().size();
+	}
+	else {
+		std::ostringstream arrays[3];
+		WritePositions(arrays[0], mesh);
+		WriteNormals(arrays[1], mesh);
+		WriteTexCoord(arrays[2], mesh);
+		for (int a = 0; a < 3; a++) {
+			EncodeVertices(data, arrays[a].str(), n_vertices, AttributeSize(a));
+			size += arrays[a].str().size();
+		}
+	}
+
+	Log("Encoded vertices: %u -> %u bytes (%.1f%%)\n", (unsigned) size, (unsigned) data.size(),
+		size ? 100.0 * data.size() / size : 0.0);
+	WriteEncoded(output, data);
+}
+
+// the indices of each submesh encoded with MeshCodec, as values on their
+// index size (the restart index has all the bits of the index size set)
+void WriteEncodedIndices(ofstream& output, const MeshData& mesh, int lod = 0) {
+	std::vector<uint8_t> data;
+	size_t size = 0;
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		const SubMeshIndices& src = subMesh.lod(lod);
+		uint8_t index_size = IndexSize(subMesh, lod);
+		uint32_t mask = index_size == 4 ? ~0u : (1u << (8 * index_size)) - 1;
+
+		std::vector<uint32_t> indices(src.indices.size());
+		for (size_t idx = 0; idx < indices.size(); idx++)
+			indices[idx] = src.indices[idx] & mask;
+
+		bool triangles = src.primitive == MESH_TRIANGLES;
+		size_t offset = data.size();
+		data.resize(offset + encode_indices_bound(indices.size(), triangles));
+		data.resize(offset + encode_indices(data.data() + offset, indices.data(), indices.size(), triangles));
+		size += IndicesSize(subMesh, lod);
+	}
+
+	Log("Encoded indices: %u -> %u bytes (%.1f%%)\n", (unsigned) size, (unsigned) data.size(),
+		size ? 100.0 * data.size() / size : 0.0);
+	WriteEncoded(output, data);
+}
+
+// the submesh records of a level of detail (see SubMesh in Mesh.h), with
+// their material
+void WriteSubMeshes(std::ostream& output, const MeshData& mesh, int lod = 0) {
+	uint32_t start = 0, base_vertex = 0, index_offset = 0;
+	for (size_t i = 0; i < mesh.subMeshes.size() ; i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		const SubMeshIndices& src = subMesh.lod(lod);
+		uint32_t n_tris = src.n_tris();
+		uint8_t index_size = IndexSize(subMesh, lod);
+
+		// the strips give their number of indices instead of triangles
+		uint32_t size = src.primitive == MESH_TRIANGLES ? n_tris : (uint32_t) src.indices.size();
+
+		if (lod > 0)
+			Log("\tLOD %d", lod);
+		Log("\tSubMesh %d, start=%d, size=%d, index size=%d, primitive=%d\n", (int) i, start, size, index_size,
+			src.primitive);
+
+		uint32_t record[4] = {start, size, base_vertex, index_offset};
+		ToOutput32(record, 4);
+
+		// the default material is 255
+		uint8_t materialIdx = (uint8_t) subMesh.material;
+		uint8_t tail[4] = {index_size, materialIdx, src.primitive, 0};
+
+		output.write((char*)record, sizeof(record));
+		output.write((char*)tail, sizeof(tail));
 
-		printf("\tSubMesh %d, start=%d, size=%d\n", i, start, n_tris);
-		
-		subMeshes[m]	= swap_u16(start);
-		subMeshes[m+1]	= swap_u16(n_tris);
-		
-		m += 2;
 		start += n_tris;
+		base_vertex += subMesh.n_vertices();
+		index_offset += IndicesSize(subMesh, lod);
 	}
-	
-	output.write((char*)subMeshes, n_elements * sizeof(uint16_t));
-	delete[] subMeshes;
 }
 
-void WriteSubMeshMaterials(ofstream& output, const aiScene* pScene) {
-	int n = pScene->mNumMeshes;
-	uint8_t* materials = new uint8_t[n];
-	for (uint32_t i = 0; i < pScene->mNumMeshes ; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
-	
-		uint8_t materialIdx = mesh->mMaterialIndex - 1;
-		
-		materials[i]	= materialIdx;
+// the meshlets of every submesh (--meshlets): their records, then the
+// vertices they use (mesh vertices), then their triangles (3 indices in
+// the vertices of the meshlet each), zero padded to a multiple of 4 bytes
+void WriteMeshlets(std::ostream& records, std::ostream& vertices, std::ostream& triangles, const MeshData& mesh) {
+	std::vector<uint32_t> vertex_data;
+	std::vector<uint8_t> triangle_data;
+	uint32_t base_vertex = 0;
+	for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		float error = PositionError(subMesh);
+		for (size_t m = 0; m < subMesh.meshlets.size(); m++) {
+			const MeshletData& meshlet = subMesh.meshlets[m];
+			uint32_t offsets[2] = {(uint32_t) vertex_data.size(), (uint32_t) triangle_data.size()};
+			uint8_t counts[2] = {(uint8_t) meshlet.vertices.size(), (uint8_t) (meshlet.triangles.size() / 3)};
+			uint16_t subMesh_index = (uint16_t) i;
+			float bounds[8] = {meshlet.center[0], meshlet.center[1], meshlet.center[2], meshlet.radius + error,
+				meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2], meshlet.cone_cutoff};
+			ToOutput32(offsets, 2);
+			ToOutput16(&subMesh_index, 1);
+			records.write((char*)offsets, sizeof(offsets));
+			records.write((char*)counts, sizeof(counts));
+			records.write((char*)&subMesh_index, sizeof(subMesh_index));
+			WriteData(records, bounds, 8);
+
+			for (size_t v = 0; v < meshlet.vertices.size(); v++)
+				vertex_data.push_back(base_vertex + meshlet.vertices[v]);
+			triangle_data.insert(triangle_data.end(), meshlet.triangles.begin(), meshlet.triangles.end());
+		}
+		base_vertex += subMesh.n_vertices();
 	}
 
-	output.write((char*)materials, n * sizeof(uint8_t));
-	delete[] materials;
+	ToOutput32(vertex_data.data(), vertex_data.size());
+	vertices.write((char*)vertex_data.data(), vertex_data.size() * sizeof(uint32_t));
+	triangles.write((const char*)triangle_data.data(), triangle_data.size());
+	WritePadding(triangles, triangle_data.size());
 }
 
+// the sections after the material name in LZ blocks (--compress): the
+// block count and the compressed size of each block, then the blocks. a
+// block that doesn't get smaller is stored as it is
+void WriteCompressed(ofstream& output, const MeshData& mesh) {
+	std::ostringstream sections[6 + 2 * (MESH_MAX_LODS - 1) + 3];
+	if (g_vertex_format & MESH_INTERLEAVED)
+		WriteVertices(sections[0], mesh);
+	else {
+		WritePositions(sections[0], mesh);
+		WriteNormals(sections[1], mesh);
+		WriteTexCoord(sections[2], mesh);
+	}
+	WriteSubMeshes(sections[3], mesh);
+	WriteQuantization(sections[4], mesh);
+	WriteIndices(sections[5], mesh);
+	int n_sections = 6;
+	for (int lod = 1; lod < mesh.n_lods(); lod++) {
+		WriteSubMeshes(sections[n_sections++], mesh, lod);
+		WriteIndices(sections[n_sections++], mesh, lod);
+	}
+	if (g_vertex_format & MESH_MESHLETS) {
+		WriteMeshlets(sections[n_sections], sections[n_sections + 1], sections[n_sections + 2], mesh);
+		n_sections += 3;
+	}
 
-void MaterialInfo(const aiScene* pScene) {
-	for (uint32_t i = 0; i < pScene->mNumMeshes; i++) {
-		const aiMesh* mesh = pScene->mMeshes[i];
-		const aiMaterial* pMaterial = pScene->mMaterials[mesh->mMaterialIndex];
+	std::vector<uint32_t> sizes;
+	std::vector<uint8_t> data;
+	size_t size = 0;
+	for (int s = 0; s < n_sections; s++) {
+		std::string section = sections[s].str();
+		for (size_t offset = 0; offset < section.size(); offset += MESH_BLOCK_SIZE) {
+			const uint8_t* block = (const uint8_t*) section.data() + offset;
+			size_t block_size = std::min(section.size() - offset, (size_t) MESH_BLOCK_SIZE);
+
+			size_t start = data.size();
+			data.resize(start + lz_compress_bound(block_size));
+			size_t compressed = lz_compress(data.data() + start, block, block_size);
+			if (compressed < block_size) {
+				data.resize(start + compressed);
+				sizes.push_back((uint32_t) compressed);
+			}
+			else {
+				data.resize(start + block_size);
+				memcpy(data.data() + start, block, block_size);
+				sizes.push_back((uint32_t) block_size | MESH_BLOCK_RAW);
+			}
+		}
+		size += section.size();
+	}
+
+	Log("Compressed: %u -> %u bytes (%.1f%%) in %u blocks\n", (unsigned) size, (unsigned) data.size(),
+		size ? 100.0 * data.size() / size : 0.0, (unsigned) sizes.size());
+
+	uint32_t n_blocks = (uint32_t) sizes.size();
+	ToOutput32(&n_blocks, 1);
+	output.write((char*)&n_blocks, sizeof(n_blocks));
+	if (!sizes.empty()) {
+		ToOutput32(sizes.data(), sizes.size());
+		output.write((char*)sizes.data(), sizes.size() * sizeof(uint32_t));
+	}
+	output.write((const char*)data.data(), data.size());
+}
+
+void MaterialInfo(const MeshData& mesh) {
+	for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+		int material = mesh.subMeshes[i].material;
+		bool diffuse = material >= 0 && !mesh.materials[material].diffuse.empty();
 
-		int nt = pMaterial->GetTextureCount(aiTextureType_DIFFUSE);
-		printf("Mesh %d, Material Id: %d, TextureCount: %d", i, mesh->mMaterialIndex, nt);
+		Log("Mesh %d, Material Id: %d, TextureCount: %d", (int) i, material + 1, diffuse ? 1 : 0);
 		
-		if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-			aiString path;
+		if (diffuse) {
 			std::string dir = ".";
-			if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
-				std::string fullPath = dir + "/" + path.data;
-				printf(", Texture: %s", fullPath.c_str());
+			std::string fullPath = dir + "/" + mesh.materials[material].diffuse;
+			Log(", Texture: %s", fullPath.c_str());
+		}
+		Log("\n");
+	}
+}
+
+// copy the meshes and materials of an imported scene. material 0 is
+// Assimp's default material, it isn't part of mesh.materials
+void ImportScene(const aiScene* pScene, MeshData& mesh) {
+	mesh.subMeshes.resize(pScene->mNumMeshes);
+	for (uint32_t i = 0 ; i < pScene->mNumMeshes ; i++) {
+		const aiMesh* src = pScene->mMeshes[i];
+		SubMeshData& dst = mesh.subMeshes[i];
+		uint32_t n = src->mNumVertices;
+
+		// aiVector3D is 3 packed floats
+		const float* positions = (const float*) src->mVertices;
+		dst.positions.assign(positions, positions + 3 * n);
+
+		if (src->HasNormals()) {
+			const float* normals = (const float*) src->mNormals;
+			dst.normals.assign(normals, normals + 3 * n);
+		}
+		else
+			dst.normals.assign(3 * n, 0.0f);
+
+		if (src->HasTextureCoords(0)) {
+			dst.texcoords.resize(2 * n);
+			for (uint32_t v = 0; v < n; v++) {
+				dst.texcoords[2 * v]		= src->mTextureCoords[0][v].x;
+				dst.texcoords[2 * v + 1]	= src->mTextureCoords[0][v].y;
 			}
 		}
-		puts("");
+
+		dst.indices.resize(3 * src->mNumFaces);
+		for (uint32_t f = 0, idx = 0; f < src->mNumFaces ; f++, idx += 3) {
+			const aiFace& face = src->mFaces[f];
+			assert(face.mNumIndices == 3);
+			dst.indices[idx]	= face.mIndices[0];
+			dst.indices[idx+1]	= face.mIndices[1];
+			dst.indices[idx+2]	= face.mIndices[2];
+		}
+
+		dst.material = (int) src->mMaterialIndex - 1;
+	}
+
+	int n_materials = pScene->mNumMaterials > 0 ? pScene->mNumMaterials - 1 : 0;
+	mesh.materials.resize(n_materials);
+	for (int i = 0; i < n_materials; i++) {
+		const aiMaterial* pMaterial = pScene->mMaterials[i + 1];
+
+		aiString name;
+		pMaterial->Get(AI_MATKEY_NAME, name);
+		mesh.materials[i].name = name.C_Str();
+
+		aiString path;
+		if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
+			mesh.materials[i].diffuse = path.data;
 	}
 }
 
-bool ConvertMesh(const std::string& filename) {
+bool ConvertMesh(const MeshData& mesh, const std::string& filename) {
+	Log("converting mesh: %s.obj\n", filename.c_str());
+
 	ofstream output(filename + ".m", ios::out | ios::binary);
+	if (!output) {
+		printf("Error writing '%s.m'\n", filename.c_str());
+		return false;
+	}
 
-	printf("converting mesh: %s.obj\n", filename.c_str());
-	
-	Assimp::Importer Importer;
-	const aiScene* pScene = Importer.ReadFile(filename + ".obj", g_process_flags);
-    const aiVector3D vecZero;
+	uint32_t indices_size = 0;
+	for (size_t i = 0; i < mesh.subMeshes.size(); i++)
+		indices_size += IndicesSize(mesh.subMeshes[i]);
 
 	std::string materialName = filename + ".mat";
-    bool ret = false;
-    if (pScene) {
-		WriteHeader(output, pScene, materialName.length() + 1);
-		WriteMaterialName(output, materialName);
-		WritePositions(output, pScene);
-		WriteNormals(output, pScene);
-		WriteTexCoord(output, pScene);
-		WriteIndices(output, pScene);
-		WriteSubMeshes(output, pScene);
-		WriteSubMeshMaterials(output, pScene);
-
-		MaterialInfo(pScene);
-    }
-    else {
-		printf("Error parsing '%s': '%s'\n", filename.c_str(), Importer.GetErrorString());
-    }
+	WriteHeader(output, mesh, indices_size, MaterialNameSize(materialName));
+	WriteBounds(output, mesh);
+	WriteMaterialName(output, materialName);
+	if (g_vertex_format & MESH_COMPRESSED)
+		WriteCompressed(output, mesh);
+	else {
+		if (g_vertex_format & MESH_ENCODED)
+			WriteEncodedVertices(output, mesh);
+		else if (g_vertex_format & MESH_INTERLEAVED)
+			WriteVertices(output, mesh);
+		else {
+			WritePositions(output, mesh);
+			WriteNormals(output, mesh);
+			WriteTexCoord(output, mesh);
+		}
+		WriteSubMeshes(output, mesh);
+		WriteQuantization(output, mesh);
+		for (int lod = 0; lod < mesh.n_lods(); lod++) {
+			if (lod > 0)
+				WriteSubMeshes(output, mesh, lod);
+			if (g_vertex_format & MESH_ENCODED)
+				WriteEncodedIndices(output, mesh, lod);
+			else
+				WriteIndices(output, mesh, lod);
+		}
+		if (g_vertex_format & MESH_MESHLETS)
+			WriteMeshlets(output, output, output, mesh);
+	}
+
+	QuantizationInfo(mesh);
+	MaterialInfo(mesh);
 
+	bool ret = output.good();
 	output.close();
 
     return ret;
 }
 
-bool MeshInfo(std::string& filename) {
+void MeshInfo(const MeshData& mesh, const std::string& filename) {
 	string filenameFull = filename + ".obj";
 	printf("Mesh Info: %s\n", filenameFull.c_str());
-    bool ret = false;
-	Assimp::Importer Importer;
-
-    const aiScene* pScene = Importer.ReadFile(filenameFull.c_str(), g_process_flags);
-    const aiVector3D vecZero;
-
-    if (pScene) {
-		printf("#Meshes: %d\n", pScene->mNumMeshes);
-		for (unsigned int i = 0 ; i < pScene->mNumMeshes ; i++) {
-			printf("mesh[%d]:", i);
-			const aiMesh* mesh = pScene->mMeshes[i];
-
-			printf(" (normals: %s,", mesh->HasNormals() ? "yes" : "no");
-			printf(" texcoord: %s)\n", mesh->HasTextureCoords(0) ? "yes" : "no");
-			printf("\tVertices (%d):\n", mesh->mNumVertices);
-			for (unsigned int v = 0 ; v < mesh->mNumVertices; v++) {
-				const aiVector3D* pos = &(mesh->mVertices[v]);
-				printf("\t\t(%.3f, %.3f, %.3f)\n", pos->x, pos->y, pos->z);
-			}
 
-			printf("\tNormals(%d):\n", mesh->mNumVertices);
-			for (unsigned int v = 0 ; v < mesh->mNumVertices; v++) {
-				const aiVector3D* normal = &(mesh->mNormals[v]);
-				printf("\t\t(%.3f, %.3f, %.3f)\n", normal->x, normal->y, normal->z);
-			}
+	printf("#Meshes: %d\n", (int) mesh.subMeshes.size());
+	for (size_t i = 0 ; i < mesh.subMeshes.size() ; i++) {
+		printf("mesh[%d]:", (int) i);
+		const SubMeshData& subMesh = mesh.subMeshes[i];
+		int n_vertices = subMesh.n_vertices();
+
+		printf(" (normals: %s,", subMesh.normals.empty() ? "no" : "yes");
+		printf(" texcoord: %s)\n", subMesh.texcoords.empty() ? "no" : "yes");
+		printf("\tVertices (%d):\n", n_vertices);
+		for (int v = 0 ; v < n_vertices; v++) {
+			const float* pos = &subMesh.positions[3 * v];
+			printf("\t\t(%.3f, %.3f, %.3f)\n", pos[0], pos[1], pos[2]);
+		}
 
-			if (mesh->HasTextureCoords(0)) {
-				printf("\tTexCoord(%d):\n", mesh->mNumVertices);
-				for (unsigned int t = 0 ; t < mesh->mNumVertices; t++) {
-					const aiVector3D& normal = mesh->mTextureCoords[0][t];
-					printf("\t\t(%.3f, %.3f)\n", normal.x, normal.y);
-				}
-			}
+		printf("\tNormals(%d):\n", n_vertices);
+		for (int v = 0 ; v < n_vertices; v++) {
+			const float* normal = &subMesh.normals[3 * v];
+			printf("\t\t(%.3f, %.3f, %.3f)\n", normal[0], normal[1], normal[2]);
+		}
 
-			printf("\tFaces (%d):\n", mesh->mNumFaces);
-			for (unsigned int f = 0 ; f < mesh->mNumFaces ; f++) {
-				const aiFace& face = mesh->mFaces[f];
-				assert(face.mNumIndices == 3);
-				printf("\t\t%d: (%d, %d, %d)\n", f, face.mIndices[0], face.mIndices[1], face.mIndices[2]);
+		if (!subMesh.texcoords.empty()) {
+			printf("\tTexCoord(%d):\n", n_vertices);
+			for (int t = 0 ; t < n_vertices; t++) {
+				const float* texcoord = &subMesh.texcoords[2 * t];
+				printf("\t\t(%.3f, %.3f)\n", texcoord[0], texcoord[1]);
 			}
 		}
-    }
-    else {
-		printf("Error parsing '%s': '%s'\n", filename.c_str(), Importer.GetErrorString());
-    }
 
-    return ret;
+		int n_tris = subMesh.n_tris();
+		printf("\tFaces (%d):\n", n_tris);
+		for (int f = 0 ; f < n_tris ; f++) {
+			const uint32_t* face = &subMesh.indices[3 * f];
+			printf("\t\t%d: (%d, %d, %d)\n", f, face[0], face[1], face[2]);
+		}
+	}
 }
 
 long fsize(FILE* f) {
@@ -312,45 +986,41 @@ long fsize(FILE* f) {
 	return size;
 }
 
-void WriteMaterial(const std::string& filename) {
-	Assimp::Importer Importer;
-    const aiScene* pScene = Importer.ReadFile(filename + ".obj", g_process_flags);
-
+bool WriteMaterial(const MeshData& mesh, const std::string& filename) {
 	ofstream output(filename + ".mat", ios::out | ios::binary);
+	if (!output) {
+		printf("Error writing '%s.mat'\n", filename.c_str());
+		return false;
+	}
 
 	std::string path = filename+".mat";
 	const char* matName = path.c_str();
 	char name_size = (char) strlen(matName)+1;
-	char n_subMat = (char) pScene->mNumMaterials - 1;	// doesnt count DefaultMaterial (Material[0])
+	char n_subMat = (char) mesh.materials.size();	// doesnt count the default material
 
 	char header[2] = {name_size, n_subMat};
 	output.write((char*)header, 2);
 	output.write(matName, name_size*sizeof(char));
 
-	printf("#Materials= %d\n", n_subMat);
+	Log("#Materials= %d\n", n_subMat);
 	for (int i = 1; i <= n_subMat; i++) {
-		const aiMaterial* pMaterial = pScene->mMaterials[i];
-		printf("Writing material %d, ", i);
-		printf("#Textures= %d", pMaterial->GetTextureCount(aiTextureType_DIFFUSE));
-
-		aiString name;
-		pMaterial->Get(AI_MATKEY_NAME, name);
-
-		printf(", name=%s\n", name.C_Str());
-		//if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-			aiString path;
-			//std::string dir = ".";
-			if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
-				const char* diffuse_name = path.data;
-				char diffuse_size = (char) strlen(diffuse_name) + 1;
-				//printf("Texture: %s\n", fullPath.c_str());
-				output.write(&diffuse_size, 1);
-				output.write(diffuse_name, diffuse_size);
-			}
-		//}
+		const MaterialData& material = mesh.materials[i - 1];
+		Log("Writing material %d, ", i);
+		Log("#Textures= %d", material.diffuse.empty() ? 0 : 1);
+
+		Log(", name=%s\n", material.name.c_str());
+		if (!material.diffuse.empty()) {
+			const char* diffuse_name = material.diffuse.c_str();
+			char diffuse_size = (char) strlen(diffuse_name) + 1;
+			output.write(&diffuse_size, 1);
+			output.write(diffuse_name, diffuse_size);
+		}
 	}
 
+	bool ret = output.good();
 	output.close();
+
+	return ret;
 }
 
 void ReadMaterial(const std::string& filename) {
@@ -378,6 +1048,443 @@ void ReadMaterial(const std::string& filename) {
 	}
 }
 
+// mesh name of an input file (the converter works on names without extension)
+std::string MeshName(const std::string& path) {
+	size_t n = path.length();
+	if (n > 4 && path.compare(n - 4, 4, ".obj") == 0)
+		return path.substr(0, n - 4);
+	return path;
+}
+
+// the numbers of a --lod or --lod-error list, false if one isn't in (0, limit]
+bool ParseList(const char* list, std::vector<float>& values, float limit) {
+	values.clear();
+	for (;;) {
+		char* end;
+		float value = strtof(list, &end);
+		if (end == list || !(value > 0 && value <= limit))
+			return false;
+		values.push_back(value);
+		if (*end == 0)
+			return true;
+		if (*end != ',')
+			return false;
+		list = end + 1;
+	}
+}
+
+// the quantized arrays of a --quantize list, 0 if it names an unknown array
+int QuantizeFormat(const char* list) {
+	int format = 0;
+	std::string names = list;
+	size_t start = 0;
+	for (;;) {
+		size_t end = names.find(',', start);
+		std::string name = names.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		if (name == "position")
+			format |= MESH_POSITION_S16;
+		else if (name == "normal")
+			format |= MESH_NORMAL_S8;
+		else if (name == "texcoord")
+			format |= MESH_TEXCOORD_S16;
+		else
+			return 0;
+
+		if (end == std::string::npos)
+			return format;
+		start = end + 1;
+	}
+}
+
+// add the mesh names of all the .obj files under dir
+void ListMeshes(const std::string& dir, std::vector<std::string>& names) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		std::string name = entry.cFileName;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string path = dir + "/" + name;
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ListMeshes(path, names);
+		else if (MeshName(path) != path)
+			names.push_back(MeshName(path));
+	} while (FindNextFileA(find, &entry));
+
+	FindClose(find);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (!d)
+		return;
+
+	while (dirent* entry = readdir(d)) {
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string path = dir + "/" + name;
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			continue;
+
+		if (S_ISDIR(st.st_mode))
+			ListMeshes(path, names);
+		else if (MeshName(path) != path)
+			names.push_back(MeshName(path));
+	}
+
+	closedir(d);
+#endif
+}
+
+// add the meshes of a manifest, one .obj per line relative to the manifest
+// directory. empty lines and lines starting with # are skipped
+bool ReadManifest(const std::string& path, std::vector<std::string>& names) {
+	ifstream input(path.c_str());
+	if (!input) {
+		printf("Error reading manifest '%s'\n", path.c_str());
+		return false;
+	}
+
+	size_t sep = path.find_last_of("/\\");
+	std::string dir = (sep == std::string::npos) ? "" : path.substr(0, sep + 1);
+
+	std::string line;
+	while (getline(input, line)) {
+		size_t end = line.find_last_not_of(" \t\r");
+		if (end == std::string::npos || line[0] == '#')
+			continue;
+		line.erase(end + 1);
+
+		bool absolute = line[0] == '/' || line[0] == '\\' || (line.length() > 1 && line[1] == ':');
+		names.push_back(MeshName(absolute ? line : dir + line));
+	}
+
+	return true;
+}
+
+// hash of every setting that changes the converted files, part of the build
+// cache key. new options affecting the output must be added here
+uint64_t OptionsHash() {
+	uint64_t hash = hash64(&g_process_flags, sizeof(g_process_flags));
+	hash = hash64(&g_big_endian, sizeof(g_big_endian), hash);
+	hash = hash64(&g_fast_obj, sizeof(g_fast_obj), hash);
+	hash = hash64(&g_vcache_size, sizeof(g_vcache_size), hash);
+	hash = hash64(&g_overdraw_threshold, sizeof(g_overdraw_threshold), hash);
+	hash = hash64(&g_vertex_fetch, sizeof(g_vertex_fetch), hash);
+	hash = hash64(&g_strip, sizeof(g_strip), hash);
+	hash = hash64(&g_vertex_format, sizeof(g_vertex_format), hash);
+	if (!g_lods.empty())
+		hash = hash64(g_lods.data(), g_lods.size() * sizeof(LodTarget), hash);
+	hash = hash64(&g_meshlet_vertices, sizeof(g_meshlet_vertices), hash);
+	hash = hash64(&g_meshlet_triangles, sizeof(g_meshlet_triangles), hash);
+	return hash;
+}
+
+enum ConvertStatus {
+	CONVERT_OK,
+	CONVERT_UP_TO_DATE,
+	CONVERT_FAILED
+};
+
+// import a mesh with Assimp (triangulation, welding and the other
+// g_process_flags steps)
+bool ImportAssimp(Assimp::Importer& importer, const std::string& filename, MeshData& mesh) {
+	const aiScene* pScene = importer.ReadFile(filename + ".obj", g_process_flags);
+	if (!pScene) {
+		printf("Error parsing '%s': '%s'\n", filename.c_str(), importer.GetErrorString());
+		return false;
+	}
+
+	// the scene is only needed until it's copied
+	ImportScene(pScene, mesh);
+	importer.FreeScene();
+	return true;
+}
+
+// import a mesh with ObjReader, without Assimp's importer and post processing
+// (see conv_obj for the steps done natively)
+bool ImportObj(const std::string& filename, MeshData& mesh) {
+	ObjReader reader((filename + ".obj").c_str(), g_obj_threads);
+	if (!reader.error.empty()) {
+		printf("Error parsing '%s': '%s'\n", filename.c_str(), reader.error.c_str());
+		return false;
+	}
+	for (size_t i = 0; i < reader.warnings.size(); i++)
+		printf("warning: '%s': %s\n", filename.c_str(), reader.warnings[i].c_str());
+
+	if (!conv_obj(reader.model, mesh)) {
+		printf("Error parsing '%s': 'no triangles'\n", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+// diagonal of the bounding box of a mesh
+float MeshExtent(const MeshData& mesh) {
+	float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+		const std::vector<float>& positions = mesh.subMeshes[i].positions;
+		for (size_t j = 0; j < positions.size(); j++) {
+			lo[j % 3] = std::min(lo[j % 3], positions[j]);
+			hi[j % 3] = std::max(hi[j % 3], positions[j]);
+		}
+	}
+	if (lo[0] > hi[0])
+		return 0;
+	return sqrtf((hi[0] - lo[0]) * (hi[0] - lo[0]) + (hi[1] - lo[1]) * (hi[1] - lo[1]) + (hi[2] - lo[2]) * (hi[2] - lo[2]));
+}
+
+// the optional passes over the imported mesh, each submesh on its own
+void OptimizeMesh(MeshData& mesh) {
+	float extent = MeshExtent(mesh);
+	mesh.lod_errors.assign(1 + g_lods.size(), 0.0f);
+
+	for (size_t i = 0; i < mesh.subMeshes.size(); i++) {
+		SubMeshData& subMesh = mesh.subMeshes[i];
+		float overdraw = g_overdraw_threshold > 0 ? AnalyzeOverdraw(subMesh.indices, subMesh.positions) : 0;
+
+		if (g_vcache_size > 0) {
+			VertexCacheStats before = AnalyzeVertexCache(subMesh.indices, subMesh.n_vertices(), g_vcache_size);
+			OptimizeVertexCache(subMesh.indices, subMesh.n_vertices(), g_vcache_size);
+			VertexCacheStats after = AnalyzeVertexCache(subMesh.indices, subMesh.n_vertices(), g_vcache_size);
+			Log("\tSubMesh %d, vertex cache %d: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", (int) i, g_vcache_size,
+				before.acmr, after.acmr, before.atvr, after.atvr);
+		}
+
+		if (g_overdraw_threshold > 0) {
+			VertexCacheStats before = AnalyzeVertexCache(subMesh.indices, subMesh.n_vertices(), g_vcache_size);
+			OptimizeOverdraw(subMesh.indices, subMesh.positions, g_vcache_size, g_overdraw_threshold);
+			VertexCacheStats after = AnalyzeVertexCache(subMesh.indices, subMesh.n_vertices(), g_vcache_size);
+			Log("\tSubMesh %d, overdraw %.2f: overdraw %.3f -> %.3f, ACMR %.3f -> %.3f\n", (int) i, g_overdraw_threshold,
+				overdraw, AnalyzeOverdraw(subMesh.indices, subMesh.positions), before.acmr, after.acmr);
+		}
+
+		// the levels of detail, each one simplified from the full detail on
+		// the same vertices, then reordered for the vertex cache
+		subMesh.lods.clear();
+		for (size_t l = 0; l < g_lods.size(); l++) {
+			SubMeshIndices lod;
+			lod.indices = subMesh.indices;
+			size_t target = (size_t) (subMesh.indices.size() / 3 * g_lods[l].ratio) * 3;
+			float max_error = g_lods[l].error < FLT_MAX ? g_lods[l].error * extent : FLT_MAX;
+			float error = SimplifyMesh(lod.indices, subMesh.positions, target, max_error);
+			if (g_vcache_size > 0)
+				OptimizeVertexCache(lod.indices, subMesh.n_vertices(), g_vcache_size);
+
+			Log("\tSubMesh %d, LOD %d: %d -> %d triangles, error %g\n", (int) i, (int) l + 1,
+				(int) subMesh.indices.size() / 3, (int) lod.indices.size() / 3, error);
+			mesh.lod_errors[l + 1] = std::max(mesh.lod_errors[l + 1], error);
+			subMesh.lods.push_back(lod);
+		}
+
+		if (g_vertex_fetch) {
+			uint32_t n_vertices = subMesh.n_vertices();
+			int strides[3] = {12, 12, subMesh.texcoords.empty() ? 0 : 8};
+			float before = AnalyzeVertexFetch(subMesh.indices, n_vertices, strides);
+
+			std::vector<uint32_t> remap;
+			uint32_t n_used = OptimizeVertexFetch(subMesh.indices, n_vertices, remap);
+			RemapVertices(subMesh.positions, 3, remap, n_used);
+			RemapVertices(subMesh.normals, 3, remap, n_used);
+			RemapVertices(subMesh.texcoords, 2, remap, n_used);
+			for (size_t l = 0; l < subMesh.lods.size(); l++) {
+				std::vector<uint32_t>& indices = subMesh.lods[l].indices;
+				for (size_t idx = 0; idx < indices.size(); idx++)
+					indices[idx] = remap[indices[idx]];
+			}
+
+			float after = AnalyzeVertexFetch(subMesh.indices, n_used, strides);
+			Log("\tSubMesh %d, vertex fetch: overfetch %.3f -> %.3f", (int) i, before, after);
+			if (n_used < n_vertices)
+				Log(", %d unused vertices removed", n_vertices - n_used);
+			Log("\n");
+		}
+
+		// the meshlets are cut from the final triangle order, before the
+		// strips
+		if (g_meshlet_vertices > 0) {
+			BuildMeshlets(subMesh.indices, subMesh.positions, g_meshlet_vertices, g_meshlet_triangles, subMesh.meshlets);
+			size_t n_vertices = 0, n_cones = 0;
+			for (size_t m = 0; m < subMesh.meshlets.size(); m++) {
+				n_vertices += subMesh.meshlets[m].vertices.size();
+				n_cones += subMesh.meshlets[m].cone_cutoff < 1;
+			}
+			size_t n_meshlets = std::max(subMesh.meshlets.size(), (size_t) 1);
+			Log("\tSubMesh %d, meshlets: %d, %.1f vertices and %.1f triangles each, %.0f%% with a cone\n", (int) i,
+				(int) subMesh.meshlets.size(), (double) n_vertices / n_meshlets, subMesh.indices.size() / 3.0 / n_meshlets,
+				100.0 * n_cones / n_meshlets);
+		}
+
+		// last, the strips follow the triangle order of the passes above. a
+		// submesh (or level of detail) whose strips take more indices than
+		// its list stays a list
+		for (size_t l = 0; l <= subMesh.lods.size() && g_strip != MESH_TRIANGLES; l++) {
+			SubMeshIndices& level = l == 0 ? subMesh : subMesh.lods[l - 1];
+			std::vector<uint32_t> strips = level.indices;
+			uint32_t n_tris = Stripify(strips, subMesh.n_vertices(), g_strip == MESH_TRIANGLE_STRIP_RESTART);
+			size_t before = level.indices.size();
+
+			Log("\tSubMesh %d", (int) i);
+			if (l > 0)
+				Log(", LOD %d", (int) l);
+			Log(", strips: %d -> %d indices (%.1f%%)", (int) before, (int) strips.size(),
+				before ? 100.0 * strips.size() / before : 0.0);
+			if (strips.size() < before) {
+				level.indices.swap(strips);
+				level.primitive = (uint8_t) g_strip;
+				level.strip_tris = n_tris;
+				Log("\n");
+			}
+			else
+				Log(", kept as a list\n");
+		}
+	}
+}
+
+// import a mesh once and write its .m and .mat files from it
+ConvertStatus ConvertAsset(Assimp::Importer& importer, const std::string& filename) {
+	uint64_t options = OptionsHash();
+	if (g_use_cache && !g_mesh_info && IsUpToDate(filename, options))
+		return CONVERT_UP_TO_DATE;
+
+	// a conversion that fails halfway must not look up to date
+	RemoveDependencies(filename);
+
+	MeshData mesh;
+	bool imported = g_fast_obj ? ImportObj(filename, mesh) : ImportAssimp(importer, filename, mesh);
+	if (!imported)
+		return CONVERT_FAILED;
+
+	if (g_mesh_info)
+		MeshInfo(mesh, filename);
+
+	OptimizeMesh(mesh);
+
+	bool ok = ConvertMesh(mesh, filename);
+	ok = WriteMaterial(mesh, filename) && ok;
+
+	if (ok && !WriteDependencies(filename, options))
+		printf("Error writing the dependencies of '%s'\n", filename.c_str());
+
+	return ok ? CONVERT_OK : CONVERT_FAILED;
+}
+
+// convert all the meshes on n_jobs threads (0 = one per core), each worker
+// with its own importer. returns the number of failures
+int ConvertBatch(const std::vector<std::string>& names, int n_jobs) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	ThreadPool pool(n_jobs);
+	std::vector<std::unique_ptr<Assimp::Importer> > importers(pool.size());
+	std::vector<ConvertStatus> results(names.size(), CONVERT_FAILED);
+	std::mutex print_lock;
+	int n_done = 0;
+
+	for (size_t i = 0; i < names.size(); i++) {
+		pool.push([&, i](int worker) {
+			if (!importers[worker])
+				importers[worker].reset(new Assimp::Importer);
+
+			ConvertStatus status = ConvertAsset(*importers[worker], names[i]);
+			results[i] = status;
+
+			const char* status_name[] = {"ok    ", "cached", "FAILED"};
+
+			std::lock_guard<std::mutex> guard(print_lock);
+			n_done++;
+			printf("[%d/%d] %s %s\n", n_done, (int) names.size(), status_name[status], names[i].c_str());
+		});
+	}
+	pool.wait();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int n_status[3] = {0, 0, 0};
+	for (size_t i = 0; i < names.size(); i++)
+		n_status[results[i]]++;
+
+	int n_failed = n_status[CONVERT_FAILED];
+	printf("%d converted, %d up to date, %d failed in %.2fs (%d jobs)\n", n_status[CONVERT_OK], n_status[CONVERT_UP_TO_DATE], n_failed, seconds, pool.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		if (results[i] == CONVERT_FAILED)
+			printf("\tfailed: %s\n", names[i].c_str());
+	}
+
+	return n_failed;
+}
+
+// largest difference between two float arrays of the same size
+float MaxDifference(const std::vector<float>& a, const std::vector<float>& b) {
+	float diff = 0;
+	for (size_t i = 0; i < a.size(); i++)
+		diff = std::max(diff, fabsf(a[i] - b[i]));
+	return diff;
+}
+
+// import a mesh with Assimp and with --fast-obj, and print how long each
+// takes and how their results differ. returns false if they don't match
+bool CompareImports(const std::string& filename) {
+	Assimp::Importer importer;
+	MeshData assimp, fast;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = ImportAssimp(importer, filename, assimp);
+	double assimp_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	ok = ImportObj(filename, fast) && ok;
+	double fast_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!ok)
+		return false;
+
+	printf("%s.obj\n", filename.c_str());
+	printf("\tAssimp:     %.3fs\n", assimp_time);
+	printf("\t--fast-obj: %.3fs (x%.1f)\n", fast_time, assimp_time / fast_time);
+
+	bool same = assimp.subMeshes.size() == fast.subMeshes.size() && assimp.materials.size() == fast.materials.size();
+	printf("\t%d/%d submeshes, %d/%d materials\n", (int) assimp.subMeshes.size(), (int) fast.subMeshes.size(),
+		(int) assimp.materials.size(), (int) fast.materials.size());
+
+	for (size_t i = 0; i < assimp.materials.size() && i < fast.materials.size(); i++) {
+		const MaterialData& a = assimp.materials[i];
+		const MaterialData& b = fast.materials[i];
+		if (a.name != b.name || a.diffuse != b.diffuse) {
+			printf("\tmaterial %d: %s (%s) / %s (%s)\n", (int) i, a.name.c_str(), a.diffuse.c_str(), b.name.c_str(), b.diffuse.c_str());
+			same = false;
+		}
+	}
+
+	for (size_t i = 0; i < assimp.subMeshes.size() && i < fast.subMeshes.size(); i++) {
+		const SubMeshData& a = assimp.subMeshes[i];
+		const SubMeshData& b = fast.subMeshes[i];
+		printf("\tsubmesh %d: %d/%d vertices, %d/%d triangles, material %d/%d", (int) i,
+			a.n_vertices(), b.n_vertices(), a.n_tris(), b.n_tris(), a.material, b.material);
+
+		if (a.positions.size() != b.positions.size() || a.texcoords.size() != b.texcoords.size()
+			|| a.indices != b.indices || a.material != b.material) {
+			printf(", DIFFERENT\n");
+			same = false;
+			continue;
+		}
+
+		// the geometry is the same, the generated normals may differ slightly
+		float position_diff = MaxDifference(a.positions, b.positions);
+		float normal_diff = MaxDifference(a.normals, b.normals);
+		float texcoord_diff = MaxDifference(a.texcoords, b.texcoords);
+		printf(", max difference: position %g, normal %g, texcoord %g\n", position_diff, normal_diff, texcoord_diff);
+		same = same && position_diff < 1e-5f && normal_diff < 1e-3f && texcoord_diff < 1e-5f;
+	}
+
+	printf("\t%s\n", same ? "equivalent" : "NOT EQUIVALENT");
+	return same;
+}
+
 /*
 void read_input(int argc, char** argv, char* file_in, char* file_out) {
 	for (int i = 1; i < argc; i++) {
@@ -390,38 +1497,286 @@ void read_input(int argc, char** argv, char* file_in, char* file_out) {
 }
 */
 
-struct Obj {
-	int id;
-};
-
 int main(int argc, char **argv) {
 	if (argc < 2) {
-		puts("usage: prog meshname");
+		puts("usage: prog [options] meshname...");
+		puts("       prog --bench-swap");
+		puts("       prog --bench-obj[=file.obj]");
+		puts("       prog --test-obj");
+		puts("       prog --bench-weld");
+		puts("       prog --bench-layout");
+		puts("       prog --bench-codec");
+		puts("       prog --bench-compress");
+		puts("       prog --compare-obj meshname...");
+		puts("options:");
+		puts("\t--endian=big|little|native");
+		puts("\t--dir=path        convert every .obj under path");
+		puts("\t--manifest=file   convert the .obj files listed in file");
+		puts("\t--jobs=n          batch threads (default: one per core)");
+		puts("\t--verbose         print the conversion details in batch mode");
+		puts("\t--info            dump the imported meshes");
+		puts("\t--force           convert the meshes even if they are up to date");
+		puts("\t--fast-obj        read the .obj files without Assimp");
+		puts("\t--vcache[=n]      optimize the triangle order for a vertex cache of n (16)");
+		puts("\t--overdraw[=t]    reorder clusters of triangles to reduce overdraw, t >= 1 (1.05)");
+		puts("\t--vfetch          order the vertices as the triangles use them");
+		puts("\t--strip[=restart] write triangle strips, joined by degenerate triangles or restarts");
+		puts("\t--quantize[=list] quantize position,normal,texcoord (all by default)");
+		puts("\t--uv-shift=n      fractional bits of the quantized texcoords (10)");
+		puts("\t--layout=interleaved  write a record per vertex instead of an array per attribute");
+		puts("\t--lod=ratios      levels of detail with these ratios of the triangles (ie. 0.5,0.25)");
+		puts("\t--lod-error=list  largest error of each level of detail, relative to the mesh size");
+		puts("\t--meshlets[=v,t]  split the submeshes in clusters of v vertices and t triangles (64,124)");
+		puts("\t--encode          compress the vertex and index data (decoded by mesh_read)");
+		puts("\t--compress        compress the sections in LZ blocks (not with --encode)");
+		puts("\t--pack=file.pak   bundle the .m/.mat files and their textures in a single file");
 		exit(0);
 	}
 
-	std::string filename = argv[1];
-	//std::string filename = "box";
+	std::vector<std::string> names;
+	bool batch = false;
+	bool verbose = false;
+	bool compare = false;
+	int n_jobs = 0;
+	int quantize = 0;
+	int uv_shift = 10;
+	bool interleaved = false;
+	bool encode = false;
+	bool compress = false;
+	std::string pack;
+	std::vector<float> lod_ratios, lod_errors;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		if (strcmp(arg, "--bench-swap") == 0) {
+			BenchByteSwap();
+			return 0;
+		}
+		else if (strncmp(arg, "--bench-obj", 11) == 0) {
+			BenchObjParse(arg[11] == '=' ? arg + 12 : "");
+			return 0;
+		}
+		else if (strcmp(arg, "--test-obj") == 0) {
+			return TestObjIndices() ? 0 : 1;
+		}
+		else if (strcmp(arg, "--bench-weld") == 0) {
+			BenchVertexWeld();
+			return 0;
+		}
+		else if (strcmp(arg, "--bench-layout") == 0) {
+			BenchVertexLayout();
+			return 0;
+		}
+		else if (strcmp(arg, "--bench-codec") == 0) {
+			BenchMeshCodec();
+			return 0;
+		}
+		else if (strcmp(arg, "--bench-compress") == 0) {
+			BenchCompress();
+			return 0;
+		}
+		else if (strncmp(arg, "--endian=", 9) == 0) {
+			const char* endian = arg + 9;
+			if (strcmp(endian, "big") == 0)
+				g_big_endian = true;
+			else if (strcmp(endian, "little") == 0)
+				g_big_endian = false;
+			else if (strcmp(endian, "native") == 0)
+				g_big_endian = host_big_endian();
+			else {
+				printf("unknown endianness '%s'\n", endian);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--dir=", 6) == 0) {
+			ListMeshes(arg + 6, names);
+			batch = true;
+		}
+		else if (strncmp(arg, "--manifest=", 11) == 0) {
+			if (!ReadManifest(arg + 11, names))
+				return 1;
+			batch = true;
+		}
+		else if (strncmp(arg, "--jobs=", 7) == 0) {
+			n_jobs = atoi(arg + 7);
+		}
+		else if (strcmp(arg, "--verbose") == 0) {
+			verbose = true;
+		}
+		else if (strcmp(arg, "--info") == 0) {
+			g_mesh_info = true;
+		}
+		else if (strcmp(arg, "--force") == 0) {
+			g_use_cache = false;
+		}
+		else if (strcmp(arg, "--fast-obj") == 0) {
+			g_fast_obj = true;
+		}
+		else if (strncmp(arg, "--vcache", 8) == 0 && (arg[8] == 0 || arg[8] == '=')) {
+			g_vcache_size = arg[8] == '=' ? atoi(arg + 9) : 16;
+			if (g_vcache_size < 4) {
+				printf("invalid vertex cache size '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--overdraw", 10) == 0 && (arg[10] == 0 || arg[10] == '=')) {
+			g_overdraw_threshold = arg[10] == '=' ? (float) atof(arg + 11) : 1.05f;
+			if (g_overdraw_threshold < 1) {
+				printf("invalid overdraw threshold '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "--vfetch") == 0) {
+			g_vertex_fetch = true;
+		}
+		else if (strcmp(arg, "--strip") == 0 || strcmp(arg, "--strip=degenerate") == 0) {
+			g_strip = MESH_TRIANGLE_STRIP;
+		}
+		else if (strcmp(arg, "--strip=restart") == 0) {
+			g_strip = MESH_TRIANGLE_STRIP_RESTART;
+		}
+		else if (strncmp(arg, "--quantize", 10) == 0 && (arg[10] == 0 || arg[10] == '=')) {
+			quantize = arg[10] == '=' ? QuantizeFormat(arg + 11) : (MESH_POSITION_S16 | MESH_NORMAL_S8 | MESH_TEXCOORD_S16);
+			if (quantize == 0) {
+				printf("invalid quantized arrays '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--lod=", 6) == 0) {
+			if (!ParseList(arg + 6, lod_ratios, 1.0f)) {
+				printf("invalid level of detail ratios '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--lod-error=", 12) == 0) {
+			if (!ParseList(arg + 12, lod_errors, FLT_MAX)) {
+				printf("invalid level of detail errors '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--meshlets", 10) == 0 && (arg[10] == 0 || arg[10] == '=')) {
+			g_meshlet_vertices = 64;
+			g_meshlet_triangles = 124;
+			if (arg[10] == '=' && sscanf(arg + 11, "%d,%d", &g_meshlet_vertices, &g_meshlet_triangles) != 2)
+				g_meshlet_vertices = 0;
+			if (g_meshlet_vertices < 3 || g_meshlet_vertices > 255 || g_meshlet_triangles < 1 || g_meshlet_triangles > 255) {
+				printf("invalid meshlet sizes '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--uv-shift=", 11) == 0) {
+			uv_shift = atoi(arg + 11);
+			if (uv_shift < 0 || uv_shift > 15) {
+				printf("invalid texcoord shift '%s'\n", arg);
+				return 1;
+			}
+		}
+		else if (strncmp(arg, "--layout=", 9) == 0) {
+			const char* layout = arg + 9;
+			if (strcmp(layout, "planar") == 0)
+				interleaved = false;
+			else if (strcmp(layout, "interleaved") == 0)
+				interleaved = true;
+			else {
+				printf("unknown vertex layout '%s'\n", layout);
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "--encode") == 0) {
+			encode = true;
+		}
+		else if (strcmp(arg, "--compress") == 0) {
+			compress = true;
+		}
+		else if (strncmp(arg, "--pack=", 7) == 0) {
+			pack = arg + 7;
+		}
+		else if (strcmp(arg, "--compare-obj") == 0) {
+			compare = true;
+		}
+		else if (strncmp(arg, "--", 2) == 0) {
+			printf("unknown option '%s'\n", arg);
+			return 1;
+		}
+		else {
+			names.push_back(MeshName(arg));
+		}
+	}
+
+	if (quantize & MESH_TEXCOORD_S16)
+		quantize |= uv_shift << 8;
+	if (interleaved)
+		quantize |= MESH_INTERLEAVED;
+	// one level of detail per ratio and error, the other limit is off
+	size_t n_lods = std::max(lod_ratios.size(), lod_errors.size());
+	if (!lod_ratios.empty() && !lod_errors.empty() && lod_ratios.size() != lod_errors.size()) {
+		puts("--lod and --lod-error must give as many levels of detail");
+		return 1;
+	}
+	if (n_lods > MESH_MAX_LODS - 1) {
+		printf("at most %d levels of detail\n", MESH_MAX_LODS - 1);
+		return 1;
+	}
+	for (size_t l = 0; l < n_lods; l++) {
+		LodTarget lod;
+		lod.ratio = lod_ratios.empty() ? 0.0f : lod_ratios[l];
+		lod.error = lod_errors.empty() ? FLT_MAX : lod_errors[l];
+		g_lods.push_back(lod);
+	}
 
-	Obj a[10];
+	if (encode && compress) {
+		puts("--encode and --compress can't be combined");
+		return 1;
+	}
+	if (encode)
+		quantize |= MESH_ENCODED;
+	if (compress)
+		quantize |= MESH_COMPRESSED;
+	if (g_meshlet_vertices > 0)
+		quantize |= MESH_MESHLETS;
+	g_vertex_format = (uint16_t) quantize;
+
+	// the clusters of --overdraw are cut from the vertex cache order
+	if (g_overdraw_threshold > 0 && g_vcache_size == 0)
+		g_vcache_size = 16;
+
+	if (names.empty()) {
+		puts("no mesh to convert");
+		return 1;
+	}
 
-	for (int i = 0; i < 10; i++) {
-		a[i].id = i;
+	if (compare) {
+		g_verbose = false;
+		g_obj_threads = n_jobs;
+		int n_different = 0;
+		for (size_t i = 0; i < names.size(); i++)
+			n_different += CompareImports(names[i]) ? 0 : 1;
+		return n_different == 0 ? 0 : 1;
 	}
 
-	//Obj& a3 = a[3];
-	//a3 = a[0];
+	// the pack is only written once every mesh is converted
+	if (batch || names.size() > 1) {
+		g_verbose = verbose;
+		int n_failed = ConvertBatch(names, n_jobs);
+		if (n_failed == 0 && !pack.empty() && !WritePack(pack, names, g_big_endian))
+			n_failed++;
+		return n_failed == 0 ? 0 : 1;
+	}
 
-	//for (int i = 0; i < 10; i++) {
-	//	printf("a[%d].id = %d\n", i, a[i].id);
-	//}
+	std::string filename = names[0];
+	//std::string filename = "box";
+	g_obj_threads = n_jobs;
 
-	//MeshInfo(filename);
-	ConvertMesh(filename);
-	WriteMaterial(filename);
-	ReadMaterial(filename);
+	Assimp::Importer importer;
+	ConvertStatus status = ConvertAsset(importer, filename);
+	if (status == CONVERT_UP_TO_DATE)
+		printf("%s is up to date\n", filename.c_str());
+	else if (status == CONVERT_OK)
+		ReadMaterial(filename);
+	if (status != CONVERT_FAILED && !pack.empty() && !WritePack(pack, names, g_big_endian))
+		status = CONVERT_FAILED;
 
 	system("pause");
 
-    return 0;
-}
\ No newline at end of file
+    return status == CONVERT_FAILED ? 1 : 0;
+}
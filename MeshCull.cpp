@@ -0,0 +1,45 @@
+#include <cmath>
+
+#include "MeshCull.h"
+
+void frustum_planes(const f32 view_proj[16], f32 planes[6][4]) {
+	// row 3 plus or minus row 0 (left, right), 1 (bottom, top), 2 (near, far)
+	const f32* w = view_proj + 12;
+	for (int p = 0; p < 6; p++) {
+		const f32* row = view_proj + 4 * (p / 2);
+		f32 sign = p % 2 ? -1.0f : 1.0f;
+		for (int k = 0; k < 4; k++)
+			planes[p][k] = w[k] + sign * row[k];
+
+		f32 length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		if (length > 0) {
+			for (int k = 0; k < 4; k++)
+				planes[p][k] /= length;
+		}
+	}
+}
+
+bool sphere_culled(const f32 center[3], f32 radius, const f32 planes[6][4]) {
+	for (int p = 0; p < 6; p++) {
+		if (planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] + planes[p][3] < -radius)
+			return true;
+	}
+	return false;
+}
+
+bool meshlet_backfacing(const Meshlet& meshlet, const f32 eye[3]) {
+	f32 d[3] = {meshlet.center[0] - eye[0], meshlet.center[1] - eye[1], meshlet.center[2] - eye[2]};
+	f32 distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	f32 along = d[0] * meshlet.cone_axis[0] + d[1] * meshlet.cone_axis[1] + d[2] * meshlet.cone_axis[2];
+	return meshlet.cone_cutoff < 1 && along >= meshlet.cone_cutoff * distance + meshlet.radius;
+}
+
+u32 mesh_cull_meshlets(const Mesh& mesh, const f32 eye[3], const f32 planes[6][4], u32* visible) {
+	u32 n_visible = 0;
+	for (u32 m = 0; m < mesh.n_meshlets; m++) {
+		const Meshlet& meshlet = mesh.meshlets[m];
+		if (!sphere_culled(meshlet.center, meshlet.radius, planes) && !meshlet_backfacing(meshlet, eye))
+			visible[n_visible++] = m;
+	}
+	return n_visible;
+}
@@ -0,0 +1,25 @@
+#ifndef _MESH_CULL_H_
+#define _MESH_CULL_H_
+
+#include "Mesh.h"
+
+// CPU culling of the submeshes and meshlets of a mesh with the bounds of the
+// .m file (Mesh::subMesh_bounds, Mesh::meshlets). a plane is a, b, c, d with
+// a x + b y + c z + d >= 0 inside, (a, b, c) of unit length
+
+// the 6 planes of the frustum of a view projection matrix (row-major,
+// multiplying column vectors, clip space z in [-w, w])
+void frustum_planes(const f32 view_proj[16], f32 planes[6][4]);
+
+// true if a sphere is out of one of the planes
+bool sphere_culled(const f32 center[3], f32 radius, const f32 planes[6][4]);
+
+// true if every triangle of a meshlet faces away from a camera at eye
+bool meshlet_backfacing(const Meshlet& meshlet, const f32 eye[3]);
+
+// the meshlets of mesh that can be visible from a camera at eye with this
+// frustum (out of it or facing away are culled): writes their indices to
+// visible (mesh.n_meshlets of room) and returns how many
+u32 mesh_cull_meshlets(const Mesh& mesh, const f32 eye[3], const f32 planes[6][4], u32* visible);
+
+#endif
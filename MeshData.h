@@ -0,0 +1,69 @@
+#ifndef _MESH_DATA_H_
+#define _MESH_DATA_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshFormat.h"
+#include "MeshOptimize.h"
+
+// the triangles of a submesh at a level of detail
+struct SubMeshIndices {
+	std::vector<uint32_t> indices;	// 3 per triangle, or strips (see primitive)
+	uint8_t primitive;				// MESH_TRIANGLES until Stripify
+	uint32_t strip_tris;			// triangles of the strips
+
+	SubMeshIndices() : primitive(MESH_TRIANGLES), strip_tris(0) {}
+
+	uint32_t n_tris() const {
+		return primitive == MESH_TRIANGLES ? (uint32_t) (indices.size() / 3) : strip_tris;
+	}
+};
+
+// a submesh being converted, with its own vertices indexed from 0 by its
+// triangles (the full detail). arrays are in host byte order
+struct SubMeshData : public SubMeshIndices {
+	std::vector<float> positions;	// x, y, z per vertex
+	std::vector<float> normals;		// x, y, z per vertex
+	std::vector<float> texcoords;	// u, v per vertex, empty without texture coordinates
+	int material;					// in MeshData::materials, -1 for the default material
+
+	// the simplified levels of detail 1 and up (--lod), on the same vertices
+	std::vector<SubMeshIndices> lods;
+
+	// the full detail in clusters (--meshlets), empty without
+	std::vector<MeshletData> meshlets;
+
+	SubMeshData() : material(-1) {}
+
+	uint32_t n_vertices() const { return (uint32_t) (positions.size() / 3); }
+
+	// the triangles of a level of detail, 0 for the full detail
+	const SubMeshIndices& lod(int level) const {
+		return level == 0 ? *this : lods[level - 1];
+	}
+};
+
+struct MaterialData {
+	std::string name;
+	std::string diffuse;	// diffuse texture, empty if none
+};
+
+// a mesh as the .m and .mat writers see it, filled from an Assimp scene or
+// straight from ObjReader (conv_obj)
+struct MeshData {
+	std::vector<SubMeshData> subMeshes;
+	std::vector<MaterialData> materials;	// without the default material
+
+	// geometric error of each level of detail, the largest of its submeshes
+	// (see SimplifyMesh in MeshOptimize.h). one entry (0) without levels of
+	// detail
+	std::vector<float> lod_errors;
+
+	MeshData() : lod_errors(1, 0.0f) {}
+
+	int n_lods() const { return (int) lod_errors.size(); }
+};
+
+#endif
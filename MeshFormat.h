@@ -0,0 +1,48 @@
+#ifndef _MESH_FORMAT_H_
+#define _MESH_FORMAT_H_
+
+// constants of the .m file layout shared by the converter and the reader,
+// see MeshFile_desc.txt
+
+#define MESH_MAGIC			"WMSH"
+#define MESH_BOM			0xFEFF		// written in the byte order of the file
+#define MESH_VERSION		10			// 2 to 9 are read as is (no strips, no
+										// quantization, no interleaving, no encoding,
+										// no compression, no levels of detail, no bounds,
+										// no meshlets)
+#define MESH_HEADER_SIZE	28			// magic, bom, version and the counts
+#define MESH_HEADER_SIZE_V1	16			// same with 16-bit counts
+#define MESH_SUBMESH_SIZE	20			// a submesh record, see SubMesh
+#define MESH_QUANT_SIZE		24			// a position quantization record, see PositionQuant
+#define MESH_LAYOUT_SIZE	8			// stride and offsets after the header (interleaved)
+#define MESH_LOD_SIZE		12			// a level of detail record after the layout
+#define MESH_MAX_LODS		8			// levels of detail of a mesh, the full one included
+#define MESH_COUNTS_SIZE	12			// the meshlet counts after the lods (with meshlets)
+#define MESH_BOUNDS_SIZE	40			// a box and sphere record after the counts, see MeshBounds
+#define MESH_MESHLET_SIZE	44			// a meshlet record, see Meshlet
+#define MESH_BLOCK_SIZE		65536		// bytes of a section per compressed block
+#define MESH_BLOCK_RAW		0x80000000	// a block stored as it is (compressed size bit)
+
+// the largest header up to the bounds of the mesh, the submesh records and
+// the bounds of each submesh excluded
+#define MESH_MAX_HEADER_SIZE	(MESH_HEADER_SIZE + MESH_LAYOUT_SIZE + 4 + MESH_LOD_SIZE * MESH_MAX_LODS + MESH_COUNTS_SIZE + MESH_BOUNDS_SIZE)
+
+// vertex_format of the header, the quantized arrays and their layout.
+// texcoords are fixed point with MESH_TEXCOORD_SHIFT fractional bits
+#define MESH_POSITION_S16			0x0001
+#define MESH_NORMAL_S8				0x0002
+#define MESH_TEXCOORD_S16			0x0004
+#define MESH_INTERLEAVED			0x0008		// a record per vertex instead of an array per attribute
+#define MESH_ENCODED				0x0010		// vertex and index data compressed (MeshCodec.h)
+#define MESH_COMPRESSED				0x0020		// sections in LZ blocks (Compress.h)
+#define MESH_MESHLETS				0x0040		// the full detail in clusters after the indices
+#define MESH_QUANTIZED				(MESH_POSITION_S16 | MESH_NORMAL_S8 | MESH_TEXCOORD_S16)
+#define MESH_TEXCOORD_SHIFT(format)	(((format) >> 8) & 0xF)
+
+// primitive of a submesh (SubMesh::primitive)
+#define MESH_TRIANGLES				0	// 3 indices per triangle
+#define MESH_TRIANGLE_STRIP			1	// strips joined by degenerate triangles
+#define MESH_TRIANGLE_STRIP_RESTART	2	// strips separated by the restart index
+										// (all bits set at the index size)
+
+#endif
@@ -0,0 +1,986 @@
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "MeshOptimize.h"
+#include "Bounds.h"
+
+using namespace std;
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t n_vertices, int cache_size) {
+	// a vertex is in the cache if fewer than cache_size vertices were
+	// transformed since its own transform
+	std::vector<uint32_t> timestamp(n_vertices, 0);
+	uint32_t time = cache_size + 1;
+	uint32_t misses = 0;
+
+	for (size_t i = 0; i < indices.size(); i++) {
+		uint32_t v = indices[i];
+		if (time - timestamp[v] > (uint32_t) cache_size) {
+			timestamp[v] = time++;
+			misses++;
+		}
+	}
+
+	uint32_t n_used = 0;
+	for (uint32_t v = 0; v < n_vertices; v++)
+		n_used += timestamp[v] != 0;
+
+	VertexCacheStats stats;
+	stats.acmr = indices.empty() ? 0 : misses / (indices.size() / 3.0f);
+	stats.atvr = n_used == 0 ? 0 : misses / (float) n_used;
+	return stats;
+}
+
+// vertex scores of Forsyth's algorithm, from its position in a LRU cache
+// (-1 if not in it) and its number of triangles left to emit
+struct ForsythScore {
+	std::vector<float> cache;
+	std::vector<float> valence;
+
+	ForsythScore(int cache_size) : cache(cache_size), valence(64) {
+		const float cache_decay_power = 1.5f;
+		const float last_tri_score = 0.75f;
+		const float valence_boost_scale = 2.0f;
+		const float valence_boost_power = 0.5f;
+
+		// the vertices of the last triangle get the same score, so it
+		// doesn't matter in which order they were added
+		for (int i = 0; i < cache_size; i++) {
+			if (i < 3)
+				cache[i] = last_tri_score;
+			else
+				cache[i] = powf(1.0f - (i - 3) / (float) (cache_size - 3), cache_decay_power);
+		}
+
+		// few triangles left gets a boost, to get rid of lone triangles
+		valence[0] = 0;
+		for (size_t i = 1; i < valence.size(); i++)
+			valence[i] = valence_boost_scale * powf((float) i, -valence_boost_power);
+	}
+
+	float operator()(int cache_pos, uint32_t n_live) const {
+		if (n_live == 0)
+			return -1.0f;
+
+		float score = cache_pos < 0 ? 0 : cache[cache_pos];
+		return score + (n_live < valence.size() ? valence[n_live] : valence.back());
+	}
+};
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t n_vertices, int cache_size) {
+	size_t n_tris = indices.size() / 3;
+	if (n_tris == 0 || cache_size < 4)
+		return;
+
+	// triangles of each vertex, the first live[v] aren't emitted yet
+	std::vector<uint32_t> offsets(n_vertices + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		offsets[indices[i] + 1]++;
+	for (uint32_t v = 0; v < n_vertices; v++)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> live(n_vertices, 0);
+	for (size_t i = 0; i < indices.size(); i++) {
+		uint32_t v = indices[i];
+		adjacency[offsets[v] + live[v]++] = (uint32_t) (i / 3);
+	}
+
+	ForsythScore score(cache_size);
+	std::vector<int> cache_pos(n_vertices, -1);
+	std::vector<float> vertex_score(n_vertices);
+	for (uint32_t v = 0; v < n_vertices; v++)
+		vertex_score[v] = score(-1, live[v]);
+
+	std::vector<float> tri_score(n_tris);
+	std::vector<uint8_t> emitted(n_tris, 0);
+	int64_t best = 0;
+	for (size_t t = 0; t < n_tris; t++) {
+		const uint32_t* tri = &indices[3 * t];
+		tri_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+		if (tri_score[t] > tri_score[best])
+			best = t;
+	}
+
+	std::vector<uint32_t> cache, new_cache;
+	cache.reserve(cache_size + 3);
+	new_cache.reserve(cache_size + 3);
+
+	std::vector<uint32_t> out;
+	out.reserve(indices.size());
+	size_t cursor = 0;
+
+	for (size_t n = 0; n < n_tris; n++) {
+		// nothing in the cache has triangles left, take the next one in order
+		if (best < 0) {
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		const uint32_t* tri = &indices[3 * best];
+		out.insert(out.end(), tri, tri + 3);
+		emitted[best] = 1;
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+			uint32_t* adj = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < live[v];) {
+				if (adj[j] == best)
+					adj[j] = adj[--live[v]];
+				else
+					j++;
+			}
+		}
+
+		// the triangle goes to the front of the cache, the rest moves back
+		new_cache.clear();
+		for (int k = 0; k < 3; k++) {
+			if (std::find(new_cache.begin(), new_cache.end(), tri[k]) == new_cache.end())
+				new_cache.push_back(tri[k]);
+		}
+		for (size_t i = 0; i < cache.size(); i++) {
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				new_cache.push_back(cache[i]);
+		}
+
+		// update the vertices still in the cache and the ones pushed out,
+		// then their triangles, the best of which is the next one
+		for (size_t i = 0; i < new_cache.size(); i++) {
+			uint32_t v = new_cache[i];
+			cache_pos[v] = i < (size_t) cache_size ? (int) i : -1;
+			vertex_score[v] = score(cache_pos[v], live[v]);
+		}
+
+		best = -1;
+		float best_score = -1.0f;
+		for (size_t i = 0; i < new_cache.size(); i++) {
+			uint32_t v = new_cache[i];
+			const uint32_t* adj = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < live[v]; j++) {
+				uint32_t t = adj[j];
+				const uint32_t* other = &indices[3 * t];
+				tri_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+				if (tri_score[t] > best_score) {
+					best_score = tri_score[t];
+					best = t;
+				}
+			}
+		}
+
+		if (new_cache.size() > (size_t) cache_size)
+			new_cache.resize(cache_size);
+		cache.swap(new_cache);
+	}
+
+	indices.swap(out);
+}
+
+// cache of the vertex arrays in AnalyzeVertexFetch, per array
+#define FETCH_LINE_SIZE		32
+#define FETCH_CACHE_LINES	64
+
+float AnalyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t n_vertices, const int strides[3]) {
+	uint64_t fetched = 0, used_bytes = 0;
+	std::vector<uint8_t> used(n_vertices, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		used[indices[i]] = 1;
+
+	for (int a = 0; a < 3; a++) {
+		int stride = strides[a];
+		if (stride == 0)
+			continue;
+
+		// FIFO of lines, as in AnalyzeVertexCache
+		size_t n_lines = ((size_t) n_vertices * stride + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE;
+		std::vector<uint32_t> timestamp(n_lines, 0);
+		uint32_t time = FETCH_CACHE_LINES + 1;
+
+		for (size_t i = 0; i < indices.size(); i++) {
+			size_t start = (size_t) indices[i] * stride;
+			size_t first = start / FETCH_LINE_SIZE;
+			size_t last = (start + stride - 1) / FETCH_LINE_SIZE;
+			for (size_t line = first; line <= last; line++) {
+				if (time - timestamp[line] > FETCH_CACHE_LINES) {
+					timestamp[line] = time++;
+					fetched += FETCH_LINE_SIZE;
+				}
+			}
+		}
+
+		for (uint32_t v = 0; v < n_vertices; v++)
+			used_bytes += used[v] ? stride : 0;
+	}
+
+	return used_bytes == 0 ? 0 : fetched / (float) used_bytes;
+}
+
+uint32_t OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t n_vertices, std::vector<uint32_t>& remap) {
+	remap.assign(n_vertices, ~0u);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		uint32_t& index = remap[indices[i]];
+		if (index == ~0u)
+			index = next++;
+		indices[i] = index;
+	}
+	return next;
+}
+
+void RemapVertices(std::vector<float>& data, int stride, const std::vector<uint32_t>& remap, uint32_t n_vertices) {
+	if (data.empty())
+		return;
+
+	std::vector<float> out(n_vertices * stride);
+	for (size_t v = 0; v < remap.size(); v++) {
+		if (remap[v] != ~0u)
+			std::copy(&data[v * stride], &data[v * stride] + stride, &out[remap[v] * stride]);
+	}
+	data.swap(out);
+}
+
+// resolution of the views of AnalyzeOverdraw
+#define OVERDRAW_VIEW_SIZE	256
+
+struct OverdrawView {
+	std::vector<float> depth;
+	uint64_t shaded;
+
+	OverdrawView() : depth(OVERDRAW_VIEW_SIZE * OVERDRAW_VIEW_SIZE, INFINITY), shaded(0) {}
+
+	// x, y in pixels, z the depth
+	void rasterize(const float* a, const float* b, const float* c) {
+		float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+		if (area <= 0)
+			return;
+
+		int x0 = std::max((int) floorf(std::min(a[0], std::min(b[0], c[0]))), 0);
+		int y0 = std::max((int) floorf(std::min(a[1], std::min(b[1], c[1]))), 0);
+		int x1 = std::min((int) ceilf(std::max(a[0], std::max(b[0], c[0]))), OVERDRAW_VIEW_SIZE - 1);
+		int y1 = std::min((int) ceilf(std::max(a[1], std::max(b[1], c[1]))), OVERDRAW_VIEW_SIZE - 1);
+
+		// sampled at the pixel centers
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				float px = x + 0.5f, py = y + 0.5f;
+				float wa = (b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px);
+				float wb = (c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px);
+				float wc = (a[0] - px) * (b[1] - py) - (a[1] - py) * (b[0] - px);
+				if (wa < 0 || wb < 0 || wc < 0)
+					continue;
+
+				float z = (wa * a[2] + wb * b[2] + wc * c[2]) / area;
+				float& d = depth[y * OVERDRAW_VIEW_SIZE + x];
+				if (z <= d) {
+					d = z;
+					shaded++;
+				}
+			}
+		}
+	}
+};
+
+float AnalyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<float>& positions) {
+	if (indices.empty())
+		return 0;
+
+	float lo[3] = {INFINITY, INFINITY, INFINITY};
+	float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+	for (size_t i = 0; i < indices.size(); i++) {
+		const float* p = &positions[3 * indices[i]];
+		for (int k = 0; k < 3; k++) {
+			lo[k] = std::min(lo[k], p[k]);
+			hi[k] = std::max(hi[k], p[k]);
+		}
+	}
+
+	float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+	float scale = extent > 0 ? (OVERDRAW_VIEW_SIZE - 1) / extent : 0;
+
+	uint64_t shaded = 0, covered = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		for (int dir = -1; dir <= 1; dir += 2) {
+			// looking along +axis or -axis, x and y are the other two axes.
+			// flipping x with the direction keeps the front faces counterclockwise
+			int ax = (axis + 1) % 3, ay = (axis + 2) % 3;
+			OverdrawView view;
+
+			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+				float v[3][3];
+				for (int k = 0; k < 3; k++) {
+					const float* p = &positions[3 * indices[i + k]];
+					float x = (p[ax] - lo[ax]) * scale;
+					v[k][0] = dir < 0 ? x : OVERDRAW_VIEW_SIZE - 1 - x;
+					v[k][1] = (p[ay] - lo[ay]) * scale;
+					v[k][2] = dir * (p[axis] - lo[axis]);
+				}
+				view.rasterize(v[0], v[1], v[2]);
+			}
+
+			shaded += view.shaded;
+			for (size_t p = 0; p < view.depth.size(); p++)
+				covered += view.depth[p] != INFINITY;
+		}
+	}
+
+	return covered == 0 ? 0 : shaded / (float) covered;
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, int cache_size, float threshold) {
+	size_t n_tris = indices.size() / 3;
+	uint32_t n_vertices = (uint32_t) (positions.size() / 3);
+	if (n_tris == 0)
+		return;
+
+	// cache misses of each triangle, with the FIFO of AnalyzeVertexCache
+	std::vector<uint32_t> timestamp(n_vertices, 0);
+	std::vector<uint8_t> misses(n_tris, 0);
+	uint32_t time = cache_size + 1;
+	for (size_t i = 0; i < indices.size(); i++) {
+		uint32_t v = indices[i];
+		if (time - timestamp[v] > (uint32_t) cache_size) {
+			timestamp[v] = time++;
+			misses[i / 3]++;
+		}
+	}
+
+	// a triangle missing all its vertices starts a new run of the vertex
+	// cache order. the runs are split in clusters where the ACMR since the
+	// start of the cluster, the cache being flushed there, is low enough
+	std::vector<uint32_t> clusters;
+	std::vector<uint32_t> local(n_vertices, 0);
+	uint32_t local_time = cache_size + 1;
+
+	for (size_t start = 0; start < n_tris;) {
+		size_t end = start + 1;
+		uint32_t run_misses = misses[start];
+		while (end < n_tris && misses[end] != 3)
+			run_misses += misses[end++];
+
+		float run_acmr = run_misses / (float) (end - start);
+		uint32_t cluster_misses = 0;
+		clusters.push_back((uint32_t) start);
+		local_time += cache_size + 1;
+
+		for (size_t t = start; t < end; t++) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = indices[3 * t + k];
+				if (local_time - local[v] > (uint32_t) cache_size) {
+					local[v] = local_time++;
+					cluster_misses++;
+				}
+			}
+
+			size_t cluster_tris = t + 1 - clusters.back();
+			if (t + 1 < end && cluster_misses <= threshold * run_acmr * cluster_tris &&
+				cluster_misses < 3 * cluster_tris) {
+				clusters.push_back((uint32_t) (t + 1));
+				cluster_misses = 0;
+				local_time += cache_size + 1;
+			}
+		}
+		start = end;
+	}
+	clusters.push_back((uint32_t) n_tris);
+
+	// area weighted centroid and normal of each cluster, the clusters whose
+	// normal points away from the centroid of the mesh come first
+	size_t n_clusters = clusters.size() - 1;
+	std::vector<float> centroids(3 * n_clusters, 0), normals(3 * n_clusters, 0);
+	float mesh_centroid[3] = {0, 0, 0};
+	float mesh_area = 0;
+
+	for (size_t c = 0; c < n_clusters; c++) {
+		float* centroid = &centroids[3 * c];
+		float* normal = &normals[3 * c];
+		float area = 0;
+
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			const float* a = &positions[3 * indices[3 * t]];
+			const float* b = &positions[3 * indices[3 * t + 1]];
+			const float* d = &positions[3 * indices[3 * t + 2]];
+			float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			float e2[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+			float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+			float tri_area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; k++) {
+				centroid[k] += (a[k] + b[k] + d[k]) / 3 * tri_area;
+				normal[k] += n[k];
+			}
+			area += tri_area;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			mesh_centroid[k] += centroid[k];
+			centroid[k] = area > 0 ? centroid[k] / area : 0;
+		}
+		mesh_area += area;
+	}
+
+	for (int k = 0; k < 3; k++)
+		mesh_centroid[k] = mesh_area > 0 ? mesh_centroid[k] / mesh_area : 0;
+
+	std::vector<float> sort_key(n_clusters);
+	std::vector<uint32_t> order(n_clusters);
+	for (size_t c = 0; c < n_clusters; c++) {
+		const float* centroid = &centroids[3 * c];
+		const float* normal = &normals[3 * c];
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float dot = 0;
+		for (int k = 0; k < 3; k++)
+			dot += (centroid[k] - mesh_centroid[k]) * normal[k];
+		sort_key[c] = length > 0 ? dot / length : 0;
+		order[c] = (uint32_t) c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+	std::vector<uint32_t> out;
+	out.reserve(indices.size());
+	for (size_t i = 0; i < n_clusters; i++) {
+		uint32_t c = order[i];
+		out.insert(out.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+	}
+	indices.swap(out);
+}
+
+uint32_t Stripify(std::vector<uint32_t>& indices, uint32_t n_vertices, bool restart) {
+	size_t n_tris = indices.size() / 3;
+
+	// triangles of each vertex
+	std::vector<uint32_t> offsets(n_vertices + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		offsets[indices[i] + 1]++;
+	for (uint32_t v = 0; v < n_vertices; v++)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[fill[indices[i]]++] = (uint32_t) (i / 3);
+
+	std::vector<uint8_t> emitted(n_tris, 0);
+	for (size_t t = 0; t < n_tris; t++) {
+		const uint32_t* tri = &indices[3 * t];
+		emitted[t] = tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0];
+	}
+
+	// first triangle in order (lowest index) not emitted yet with the edge
+	// a -> b, the third vertex in c
+	auto next = [&](uint32_t a, uint32_t b, uint32_t& c) -> int64_t {
+		for (uint32_t j = offsets[a]; j < offsets[a + 1]; j++) {
+			uint32_t t = adjacency[j];
+			if (emitted[t])
+				continue;
+			const uint32_t* tri = &indices[3 * t];
+			for (int k = 0; k < 3; k++) {
+				if (tri[k] == a && tri[(k + 1) % 3] == b) {
+					c = tri[(k + 2) % 3];
+					return t;
+				}
+			}
+		}
+		return -1;
+	};
+
+	std::vector<uint32_t> out;
+	out.reserve(indices.size());
+	uint32_t strip_tris = 0;
+	size_t cursor = 0;
+
+	for (;;) {
+		while (cursor < n_tris && emitted[cursor])
+			cursor++;
+		if (cursor == n_tris)
+			break;
+
+		// start with the rotation of the triangle that can be continued
+		const uint32_t* tri = &indices[3 * cursor];
+		int first = 0;
+		for (int k = 0; k < 3; k++) {
+			uint32_t c;
+			if (next(tri[(k + 2) % 3], tri[(k + 1) % 3], c) >= 0) {
+				first = k;
+				break;
+			}
+		}
+		uint32_t a = tri[first], b = tri[(first + 1) % 3], c = tri[(first + 2) % 3];
+		emitted[cursor] = 1;
+
+		// a strip starts on an even index so its first triangle keeps its winding
+		if (!out.empty()) {
+			if (restart)
+				out.push_back(STRIP_RESTART);
+			else {
+				out.push_back(out.back());
+				out.push_back(a);
+				if (out.size() % 2 == 1)
+					out.push_back(a);
+			}
+		}
+		size_t strip_start = out.size();
+		out.push_back(a);
+		out.push_back(b);
+		out.push_back(c);
+		strip_tris++;
+
+		// the triangles of even positions hold the edge of the last two
+		// vertices, the odd ones the reversed edge
+		for (;;) {
+			size_t n = out.size();
+			bool odd = (n - strip_start) % 2 == 1;
+			uint32_t from = odd ? out[n - 1] : out[n - 2];
+			uint32_t to = odd ? out[n - 2] : out[n - 1];
+			int64_t t = next(from, to, c);
+			if (t < 0)
+				break;
+			emitted[t] = 1;
+			out.push_back(c);
+			strip_tris++;
+		}
+	}
+
+	indices.swap(out);
+	return strip_tris;
+}
+
+// error quadric of a set of planes, each weighted by the area of its
+// triangle: the weighted sum of the squared distances of p to the planes
+struct Quadric {
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+	double w;
+
+	Quadric() : a00(0), a11(0), a22(0), a01(0), a02(0), a12(0), b0(0), b1(0), b2(0), c(0), w(0) {}
+
+	// the plane n.p + d = 0, n of unit length
+	Quadric(const double n[3], double d, double weight) {
+		a00 = weight * n[0] * n[0];	a11 = weight * n[1] * n[1];	a22 = weight * n[2] * n[2];
+		a01 = weight * n[0] * n[1];	a02 = weight * n[0] * n[2];	a12 = weight * n[1] * n[2];
+		b0 = weight * n[0] * d;		b1 = weight * n[1] * d;		b2 = weight * n[2] * d;
+		c = weight * d * d;
+		w = weight;
+	}
+
+	void operator+=(const Quadric& q) {
+		a00 += q.a00;	a11 += q.a11;	a22 += q.a22;
+		a01 += q.a01;	a02 += q.a02;	a12 += q.a12;
+		b0 += q.b0;		b1 += q.b1;		b2 += q.b2;
+		c += q.c;
+		w += q.w;
+	}
+
+	double operator()(const float* p) const {
+		double x = p[0], y = p[1], z = p[2];
+		double e = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+		return e > 0 ? e : 0;
+	}
+};
+
+// normal of a triangle scaled by twice its area
+static void triangle_normal(const float* a, const float* b, const float* c, double n[3]) {
+	double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+	double v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+	n[0] = u[1] * v[2] - u[2] * v[1];
+	n[1] = u[2] * v[0] - u[0] * v[2];
+	n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+// drop the triangles with a vertex twice
+static void remove_degenerate(std::vector<uint32_t>& indices) {
+	size_t n = 0;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (a == b || b == c || c == a)
+			continue;
+		indices[n++] = a;
+		indices[n++] = b;
+		indices[n++] = c;
+	}
+	indices.resize(n);
+}
+
+// the vertices that must stay where they are: those sharing their position
+// with another vertex (the seams of the normals and texture coordinates)
+// and those on an open edge (the border of the mesh and of the submesh)
+static std::vector<uint8_t> locked_vertices(const std::vector<uint32_t>& indices, const std::vector<float>& positions) {
+	uint32_t n_vertices = (uint32_t) (positions.size() / 3);
+
+	// the first vertex of each position
+	std::vector<uint32_t> order(n_vertices);
+	for (uint32_t v = 0; v < n_vertices; v++)
+		order[v] = v;
+	const float* p = positions.data();
+	auto less_position = [p](uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(p + 3 * a, p + 3 * a + 3, p + 3 * b, p + 3 * b + 3);
+	};
+	std::sort(order.begin(), order.end(), less_position);
+
+	std::vector<uint32_t> wedge(n_vertices);
+	std::vector<uint8_t> locked(n_vertices, 0);
+	for (uint32_t i = 0, first = 0; i < n_vertices; i++) {
+		if (i > 0 && less_position(order[i - 1], order[i]))
+			first = i;
+		wedge[order[i]] = order[first];
+		if (i != first)
+			locked[order[i]] = locked[order[first]] = 1;
+	}
+
+	// an edge of the positions that no triangle has the other way round
+	std::vector<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			uint64_t a = wedge[indices[i + k]], b = wedge[indices[i + (k + 1) % 3]];
+			edges.push_back(a << 32 | b);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<uint8_t> border(n_vertices, 0);
+	for (size_t i = 0; i < edges.size(); i++) {
+		uint64_t a = edges[i] >> 32, b = edges[i] & 0xFFFFFFFF;
+		if (!std::binary_search(edges.begin(), edges.end(), b << 32 | a))
+			border[a] = border[b] = 1;
+	}
+	for (uint32_t v = 0; v < n_vertices; v++)
+		locked[v] |= border[wedge[v]];
+	return locked;
+}
+
+float SimplifyMesh(std::vector<uint32_t>& indices, const std::vector<float>& positions, size_t target_count, float target_error) {
+	uint32_t n_vertices = (uint32_t) (positions.size() / 3);
+	const float* p = positions.data();
+	remove_degenerate(indices);
+
+	std::vector<uint8_t> locked = locked_vertices(indices, positions);
+
+	std::vector<Quadric> quadrics(n_vertices);
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		const uint32_t* tri = &indices[i];
+		double n[3];
+		triangle_normal(p + 3 * tri[0], p + 3 * tri[1], p + 3 * tri[2], n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0)
+			continue;
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+
+		const float* a = p + 3 * tri[0];
+		Quadric q(n, -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]), length / 2);
+		for (int k = 0; k < 3; k++)
+			quadrics[tri[k]] += q;
+	}
+
+	// a vertex moved onto a neighbor, with its error (see MeshOptimize.h)
+	struct Collapse {
+		uint32_t from, to;
+		float error;
+
+		bool operator<(const Collapse& c) const { return error < c.error; }
+	};
+	auto collapse_error = [&](uint32_t from, uint32_t to) {
+		Quadric q = quadrics[from];
+		q += quadrics[to];
+		return q.w > 0 ? (float) sqrt(q(p + 3 * to) / q.w) : 0.0f;
+	};
+
+	// passes of independent collapses, cheapest first: each pass collapses
+	// as many edges as it can without touching the triangles of another
+	// collapse of the pass, until the target count or error
+	float error = 0;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> offsets, adjacency, remap(n_vertices);
+	std::vector<uint8_t> touched(n_vertices);
+	while (indices.size() > target_count) {
+		collapses.clear();
+		for (size_t i = 0; i < indices.size(); i++) {
+			uint32_t a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+			if (locked[a] && locked[b])
+				continue;
+
+			Collapse c;
+			c.error = FLT_MAX;
+			if (!locked[a]) {
+				c.from = a;
+				c.to = b;
+				c.error = collapse_error(a, b);
+			}
+			if (!locked[b]) {
+				float e = collapse_error(b, a);
+				if (e < c.error) {
+					c.from = b;
+					c.to = a;
+					c.error = e;
+				}
+			}
+			if (c.error <= target_error)
+				collapses.push_back(c);
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end());
+
+		// triangles of each vertex
+		offsets.assign(n_vertices + 1, 0);
+		for (size_t i = 0; i < indices.size(); i++)
+			offsets[indices[i] + 1]++;
+		for (uint32_t v = 0; v < n_vertices; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = (uint32_t) (i / 3);
+
+		for (uint32_t v = 0; v < n_vertices; v++)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		// a collapse removes 2 triangles, the pass stops a bit above the
+		// error of the collapses it would take without the others in the way
+		// (up to target_error if those can't be taken at all)
+		size_t goal = std::min((indices.size() - target_count) / 6, collapses.size() - 1);
+		float pass_error = std::min(collapses[goal].error * 1.5f, target_error);
+
+		size_t n_indices = indices.size();
+		size_t n_collapsed = 0;
+		for (size_t i = 0; i < collapses.size() && n_indices > target_count; i++) {
+			const Collapse& c = collapses[i];
+			if (c.error > pass_error) {
+				if (n_collapsed > 0)
+					break;
+				pass_error = target_error;
+			}
+			if (touched[c.from] || touched[c.to])
+				continue;
+
+			// the triangles left around from must not flip over
+			bool flip = false;
+			size_t n_removed = 0;
+			for (uint32_t j = offsets[c.from]; j < offsets[c.from + 1] && !flip; j++) {
+				const uint32_t* tri = &indices[3 * adjacency[j]];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+					n_removed++;
+					continue;
+				}
+
+				const float* v[3];
+				double before[3], after[3];
+				for (int k = 0; k < 3; k++)
+					v[k] = p + 3 * tri[k];
+				triangle_normal(v[0], v[1], v[2], before);
+				for (int k = 0; k < 3; k++)
+					v[k] = tri[k] == c.from ? p + 3 * c.to : v[k];
+				triangle_normal(v[0], v[1], v[2], after);
+				flip = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0;
+			}
+			if (flip)
+				continue;
+
+			for (uint32_t j = offsets[c.from]; j < offsets[c.from + 1]; j++) {
+				const uint32_t* tri = &indices[3 * adjacency[j]];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			remap[c.from] = c.to;
+			quadrics[c.to] += quadrics[c.from];
+			error = std::max(error, c.error);
+			n_indices -= 3 * n_removed;
+			n_collapsed++;
+		}
+		if (n_collapsed == 0)
+			break;
+
+		for (size_t i = 0; i < indices.size(); i++)
+			indices[i] = remap[indices[i]];
+		remove_degenerate(indices);
+	}
+
+	return error;
+}
+
+// the sphere and normal cone of a meshlet, normals holds the unit normal of
+// each triangle of the submesh (0 for the degenerate ones)
+static void meshlet_bounds(MeshletData& meshlet, const std::vector<float>& positions, const std::vector<float>& normals,
+	const std::vector<uint32_t>& triangles) {
+	std::vector<float> points;
+	for (size_t v = 0; v < meshlet.vertices.size(); v++)
+		points.insert(points.end(), &positions[3 * meshlet.vertices[v]], &positions[3 * meshlet.vertices[v]] + 3);
+	Bounds bounds = ComputeBounds(points.data(), meshlet.vertices.size());
+	copy(bounds.center, bounds.center + 3, meshlet.center);
+	meshlet.radius = bounds.radius;
+
+	// the axis is the average normal, the cone the smallest one around it
+	// holding every normal. normals more than about 84 degrees off the axis
+	// leave nothing to cull
+	float axis[3] = {0, 0, 0};
+	for (size_t t = 0; t < triangles.size(); t++) {
+		for (int k = 0; k < 3; k++)
+			axis[k] += normals[3 * triangles[t] + k];
+	}
+	float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float min_dot = length > 0 ? 1.0f : -1.0f;
+	for (int k = 0; k < 3; k++)
+		meshlet.cone_axis[k] = length > 0 ? axis[k] / length : 0;
+	for (size_t t = 0; t < triangles.size() && length > 0; t++) {
+		const float* n = &normals[3 * triangles[t]];
+		if (n[0] != 0 || n[1] != 0 || n[2] != 0)
+			min_dot = min(min_dot, n[0] * meshlet.cone_axis[0] + n[1] * meshlet.cone_axis[1] + n[2] * meshlet.cone_axis[2]);
+	}
+
+	// a back face is at least 90 degrees from the view direction, so the
+	// cone of view directions culling the meshlet is the normal cone
+	// widened by 90 degrees and turned around: its cosine is sin(angle)
+	meshlet.cone_cutoff = min_dot <= 0.1f ? 1.0f : sqrtf(1 - min_dot * min_dot);
+}
+
+void BuildMeshlets(const std::vector<uint32_t>& indices, const std::vector<float>& positions,
+	size_t max_vertices, size_t max_triangles, std::vector<MeshletData>& meshlets) {
+	uint32_t n_vertices = (uint32_t) (positions.size() / 3);
+	size_t n_tris = indices.size() / 3;
+	meshlets.clear();
+
+	std::vector<float> normals(3 * n_tris, 0.0f);
+	for (size_t t = 0; t < n_tris; t++) {
+		double n[3];
+		const uint32_t* tri = &indices[3 * t];
+		triangle_normal(&positions[3 * tri[0]], &positions[3 * tri[1]], &positions[3 * tri[2]], n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for (int k = 0; k < 3 && length > 0; k++)
+			normals[3 * t + k] = (float) (n[k] / length);
+	}
+
+	// the triangles of each vertex
+	std::vector<uint32_t> offsets(n_vertices + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		offsets[indices[i] + 1]++;
+	for (uint32_t v = 0; v < n_vertices; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[fill[indices[i]]++] = (uint32_t) (i / 3);
+
+	// live[v] counts the triangles of v left to put in a meshlet
+	std::vector<uint32_t> live(n_vertices);
+	for (uint32_t v = 0; v < n_vertices; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	// compactness is measured in average edges
+	double edges = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		const float* a = &positions[3 * indices[i]];
+		const float* b = &positions[3 * indices[i - i % 3 + (i + 1) % 3]];
+		edges += sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+	}
+	float edge = indices.empty() || edges == 0 ? 1.0f : (float) (edges / indices.size());
+
+	// local[v] is the index of v in the current meshlet, ~0u if it isn't in it
+	std::vector<uint32_t> local(n_vertices, ~0u);
+	std::vector<uint8_t> emitted(n_tris, 0);
+	std::vector<uint32_t> candidates;	// triangles next to the meshlet, some of them emitted
+	std::vector<uint32_t> triangles;	// of the current meshlet
+	MeshletData meshlet;
+	float axis[3] = {0, 0, 0};
+	float sum[3] = {0, 0, 0};			// of the vertices of the meshlet
+	size_t seed = 0;
+
+	for (;;) {
+		// the neighbor adding the fewest vertices, then closest to the
+		// average normal and to the center of the meshlet, then with the
+		// fewest triangles left around it so none is left alone
+		size_t best = n_tris;
+		float best_score = FLT_MAX;
+		float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		float n_used = (float) std::max(meshlet.vertices.size(), (size_t) 1);
+		float center[3] = {sum[0] / n_used, sum[1] / n_used, sum[2] / n_used};
+		for (size_t c = 0; c < candidates.size() && triangles.size() < max_triangles; ) {
+			uint32_t t = candidates[c];
+			if (emitted[t]) {
+				candidates[c] = candidates.back();
+				candidates.pop_back();
+				continue;
+			}
+			c++;
+
+			const uint32_t* tri = &indices[3 * t];
+			size_t n_new = (local[tri[0]] == ~0u) + (local[tri[1]] == ~0u && tri[1] != tri[0]) +
+				(local[tri[2]] == ~0u && tri[2] != tri[0] && tri[2] != tri[1]);
+			if (meshlet.vertices.size() + n_new > max_vertices)
+				continue;
+
+			const float* n = &normals[3 * t];
+			float alignment = length > 0 ? (n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]) / length : 1.0f;
+			float distance = 0;
+			for (int k = 0; k < 3; k++) {
+				float d = (positions[3 * tri[0] + k] + positions[3 * tri[1] + k] + positions[3 * tri[2] + k]) / 3 - center[k];
+				distance += d * d;
+			}
+			uint32_t n_live = min(min(live[tri[0]], live[tri[1]]), live[tri[2]]);
+			float score = n_new + 0.5f * (1 - alignment) + 0.1f * sqrtf(distance) / edge + 0.01f * n_live;
+			if (score < best_score) {
+				best_score = score;
+				best = t;
+			}
+		}
+
+		// the meshlet is full or has no neighbor left. the next one starts
+		// next to it, on the triangle with the fewest triangles left around
+		// it, or on the first triangle left in the list
+		if (best == n_tris) {
+			if (!triangles.empty()) {
+				meshlet_bounds(meshlet, positions, normals, triangles);
+				for (size_t v = 0; v < meshlet.vertices.size(); v++)
+					local[meshlet.vertices[v]] = ~0u;
+				meshlets.push_back(meshlet);
+				meshlet = MeshletData();
+				triangles.clear();
+				axis[0] = axis[1] = axis[2] = 0;
+				sum[0] = sum[1] = sum[2] = 0;
+
+				uint32_t best_live = ~0u;
+				for (size_t c = 0; c < candidates.size(); c++) {
+					const uint32_t* tri = &indices[3 * candidates[c]];
+					uint32_t n_live = live[tri[0]] + live[tri[1]] + live[tri[2]];
+					if (!emitted[candidates[c]] && n_live < best_live) {
+						best_live = n_live;
+						best = candidates[c];
+					}
+				}
+				candidates.clear();
+			}
+			if (best == n_tris) {
+				while (seed < n_tris && emitted[seed])
+					seed++;
+				if (seed == n_tris)
+					break;
+				best = seed;
+			}
+		}
+
+		const uint32_t* tri = &indices[3 * best];
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+			if (local[v] == ~0u) {
+				local[v] = (uint32_t) meshlet.vertices.size();
+				meshlet.vertices.push_back(v);
+				for (int j = 0; j < 3; j++)
+					sum[j] += positions[3 * v + j];
+				for (uint32_t j = offsets[v]; j < offsets[v + 1]; j++) {
+					if (!emitted[adjacency[j]])
+						candidates.push_back(adjacency[j]);
+				}
+			}
+			meshlet.triangles.push_back((uint8_t) local[v]);
+			live[v]--;
+		}
+		for (int k = 0; k < 3; k++)
+			axis[k] += normals[3 * best + k];
+		emitted[best] = 1;
+		triangles.push_back((uint32_t) best);
+	}
+}
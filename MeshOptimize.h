@@ -0,0 +1,93 @@
+#ifndef _MESH_OPTIMIZE_H_
+#define _MESH_OPTIMIZE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// index buffer optimizations of the converter. they work on the triangle
+// list of a single submesh (indices from 0 to n_vertices - 1), so the
+// submesh ranges stay the same, only OptimizeVertexFetch can drop vertices
+
+struct VertexCacheStats {
+	float acmr;		// vertices transformed per triangle (0.5 at best, 3 at worst)
+	float atvr;		// vertices transformed per vertex used (1 at best)
+};
+
+// simulate a FIFO post-transform cache of cache_size vertices over indices
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t n_vertices, int cache_size);
+
+// reorder the triangles for a post-transform cache of cache_size vertices
+// (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t n_vertices, int cache_size);
+
+// pixels shaded over pixels covered (1 at best), rasterizing the front faces
+// in their order with a depth test, on average over the 6 views along the axes
+float AnalyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<float>& positions);
+
+// reorder clusters of triangles so the ones facing out of the mesh, which
+// hide the others from most views, are drawn first (Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw"). indices
+// should be optimized for a vertex cache of cache_size already; a cluster
+// ends where its ACMR gets below threshold times the ACMR of the run it is
+// part of, 1 keeps the vertex cache runs whole and larger values give
+// smaller clusters, less overdraw and a worse ACMR
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, int cache_size, float threshold);
+
+// bytes read from the vertex arrays over the bytes of the vertices used
+// (1 at best), each array read through a small cache of 32-byte lines.
+// strides are the sizes of the vertices of each array, 0 for no array
+float AnalyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t n_vertices, const int strides[3]);
+
+// renumber the vertices in the order the indices first use them, unused
+// vertices are dropped. remap[old] is the new index (~0u if unused),
+// returns the number of vertices left
+uint32_t OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t n_vertices, std::vector<uint32_t>& remap);
+
+// restart index of the strips of Stripify, written with all the bits of the
+// index size set
+#define STRIP_RESTART 0xFFFFFFFFu
+
+// turn a triangle list into strips, following the triangle order as much as
+// the strips allow (so after the other passes). the strips are separated by
+// STRIP_RESTART with restart, or joined by degenerate triangles. degenerate
+// input triangles are dropped, returns the number of triangles of the strips
+uint32_t Stripify(std::vector<uint32_t>& indices, uint32_t n_vertices, bool restart);
+
+// simplify a triangle list by edge collapses, cheapest first by their
+// quadric error (Garland and Heckbert, "Surface Simplification Using Quadric
+// Error Metrics"), until it has target_count indices or the error of the
+// next collapse is over target_error. a vertex is only moved onto one of its
+// neighbors, so the vertices keep their attributes; those on a seam (sharing
+// their position with another vertex) or on the border of the submesh never
+// move. the error of a collapse is the RMS distance, weighted by triangle
+// area, of the neighbor to the planes of the triangles both vertices stand
+// for. returns the largest error of the collapses, in the units of the
+// positions: the geometric error of a level of detail
+float SimplifyMesh(std::vector<uint32_t>& indices, const std::vector<float>& positions, size_t target_count, float target_error);
+
+// a cluster of triangles of a submesh (BuildMeshlets), with the bounds to
+// cull it on its own: a sphere around its vertices and the cone of its
+// triangle normals. it faces away from a camera at c (every triangle is a
+// back face) when dot(center - c, cone_axis) >= cone_cutoff * |center - c| + radius
+struct MeshletData {
+	std::vector<uint32_t> vertices;		// submesh vertices
+	std::vector<uint8_t> triangles;		// 3 indices in vertices per triangle
+	float center[3];
+	float radius;
+	float cone_axis[3];
+	float cone_cutoff;					// 1 when the normals are too spread to cull
+};
+
+// split a triangle list in meshlets of at most max_vertices vertices and
+// max_triangles triangles (both up to 255). a meshlet grows from the first
+// triangle left in the list to the neighbors adding the fewest vertices,
+// closest to its normal, so the cones stay narrow. counterclockwise triangles
+// are front faces
+void BuildMeshlets(const std::vector<uint32_t>& indices, const std::vector<float>& positions,
+	size_t max_vertices, size_t max_triangles, std::vector<MeshletData>& meshlets);
+
+// move the vertices of an array with stride floats per vertex where remap says
+void RemapVertices(std::vector<float>& data, int stride, const std::vector<uint32_t>& remap, uint32_t n_vertices);
+
+#endif
@@ -0,0 +1,177 @@
+#include <cstdio>
+#include <cstring>
+
+#include "MeshPack.h"
+#include "MeshReader.h"
+#include "ByteSwap.h"
+#include "Hash.h"
+
+using namespace std;
+
+// MeshPack::views of an entry
+enum {
+	VIEW_NONE,		// not asked for yet
+	VIEW_IN_PLACE,	// viewed, the arrays are in the host byte order
+	VIEW_READ		// mesh_view can't use it
+};
+
+// swap count 64-bit values in place
+static void swap64(uint64_t* data, size_t count) {
+	swap32(data, data, 2 * count);
+	for (size_t i = 0; i < count; i++)
+		data[i] = (data[i] << 32) | (data[i] >> 32);
+}
+
+// the table of contents in the host byte order, in place
+static void swap_toc(MeshPack& pack) {
+	swap32((u32*) pack.slots, pack.slots, pack.n_slots);
+	for (u32 e = 0; e < pack.n_entries; e++) {
+		PackEntry& entry = (PackEntry&) pack.entries[e];
+		swap64(&entry.hash, 3);
+		swap32(&entry.name_offset, &entry.name_offset, 1);
+		swap16(&entry.name_size, &entry.name_size, 2);
+	}
+}
+
+// every slot and entry inside the pack, every entry aligned (mesh_view uses
+// the arrays in place), every name terminated
+static bool check_toc(const MeshPack& pack, u32 names_size) {
+	for (u32 s = 0; s < pack.n_slots; s++) {
+		if (pack.slots[s] > pack.n_entries)
+			return false;
+	}
+	for (u32 e = 0; e < pack.n_entries; e++) {
+		const PackEntry& entry = pack.entries[e];
+		if (entry.offset > pack.size || entry.size > pack.size - entry.offset || entry.offset % PACK_ALIGNMENT != 0)
+			return false;
+		if ((uint64_t) entry.name_offset + entry.name_size >= names_size || pack.names[entry.name_offset + entry.name_size] != 0)
+			return false;
+	}
+	return true;
+}
+
+bool pack_open(const char* filename, MeshPack& out) {
+	pack_close(out);
+
+	size_t size = 0;
+	u8* data = (u8*) map_file(filename, size);
+	if (!data) {
+		printf("pack_open: can't map '%s'\n", filename);
+		return false;
+	}
+
+	u16 bom = 0, version = 0;
+	u32 counts[4] = {0, 0, 0, 0};	// n_entries, n_slots, names_size, reserved
+	uint64_t file_size = 0;
+	bool swap = false;
+	if (size >= PACK_HEADER_SIZE && memcmp(data, PACK_MAGIC, 4) == 0) {
+		memcpy(&bom, data + 4, sizeof(u16));
+		memcpy(&version, data + 6, sizeof(u16));
+		memcpy(counts, data + 8, sizeof(counts));
+		memcpy(&file_size, data + 24, sizeof(file_size));
+		swap = bom == swap_u16(PACK_BOM);
+		if (swap) {
+			swap16(&version, &version, 1);
+			swap32(counts, counts, 4);
+			swap64(&file_size, 1);
+		}
+	}
+	if (bom != PACK_BOM && !swap) {
+		printf("pack_open: '%s' is not a .pak file\n", filename);
+		unmap_file(data, size);
+		return false;
+	}
+	if (version == 0 || version > PACK_VERSION) {
+		printf("pack_open: unsupported .pak version %d\n", version);
+		unmap_file(data, size);
+		return false;
+	}
+
+	// at least 2 slots keep the entries 8-byte aligned, with one free at least
+	u32 n_entries = counts[0], n_slots = counts[1], names_size = counts[2];
+	uint64_t toc_size = PACK_HEADER_SIZE + 4 * (uint64_t) n_slots + PACK_ENTRY_SIZE * (uint64_t) n_entries + names_size;
+	if (n_slots < 2 || (n_slots & (n_slots - 1)) != 0 || n_slots <= n_entries || file_size != size || toc_size > size) {
+		printf("pack_open: '%s' has an invalid table of contents\n", filename);
+		unmap_file(data, size);
+		return false;
+	}
+
+	out.mapping		= data;
+	out.size		= size;
+	out.n_entries	= n_entries;
+	out.n_slots		= n_slots;
+	out.slots		= (const u32*) (data + PACK_HEADER_SIZE);
+	out.entries		= (const PackEntry*) (out.slots + n_slots);
+	out.names		= (const char*) (out.entries + n_entries);
+	if (swap)
+		swap_toc(out);
+
+	if (!check_toc(out, names_size)) {
+		printf("pack_open: '%s' has an invalid table of contents\n", filename);
+		pack_close(out);
+		return false;
+	}
+
+	out.views.assign(n_entries, VIEW_NONE);
+	return true;
+}
+
+void pack_close(MeshPack& pack) {
+	if (pack.mapping)
+		unmap_file(pack.mapping, pack.size);
+
+	pack.mapping	= 0;
+	pack.size		= 0;
+	pack.n_entries	= 0;
+	pack.n_slots	= 0;
+	pack.slots		= 0;
+	pack.entries	= 0;
+	pack.names		= 0;
+	pack.views.clear();
+}
+
+const PackEntry* pack_find(const MeshPack& pack, const char* name) {
+	size_t length = strlen(name);
+	uint64_t hash = hash64(name, length);
+
+	// linear probing from the slot of the hash to an empty one
+	u32 mask = pack.n_slots - 1;
+	u32 slot = (u32) hash & mask;
+	for (u32 probe = 0; probe < pack.n_slots; probe++, slot = (slot + 1) & mask) {
+		u32 index = pack.slots[slot];
+		if (index == PACK_NO_ENTRY)
+			return 0;
+
+		const PackEntry& entry = pack.entries[index - 1];
+		if (entry.hash == hash && entry.name_size == length && memcmp(pack.names + entry.name_offset, name, length) == 0)
+			return &entry;
+	}
+	return 0;
+}
+
+bool pack_mesh(MeshPack& pack, const char* name, Mesh& out, MeshAllocator* allocator) {
+	mesh_release(out);
+
+	const PackEntry* entry = pack_find(pack, name);
+	if (!entry) {
+		printf("pack_mesh: no '%s' in the pack\n", name);
+		return false;
+	}
+	u8* data = pack.mapping + entry->offset;
+	size_t size = (size_t) entry->size;
+
+	// the first view swaps the arrays in place, the next ones use them as
+	// they are. the meshes read are never touched
+	{
+		std::lock_guard<std::mutex> guard(pack.lock);
+		u8& view = pack.views[entry - pack.entries];
+		if (view != VIEW_READ) {
+			if (mesh_view(data, size, name, out, view == VIEW_IN_PLACE)) {
+				view = VIEW_IN_PLACE;
+				return true;
+			}
+			view = VIEW_READ;
+		}
+	}
+	return mesh_read_memory(data, size, name, out, allocator);
+}
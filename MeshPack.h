@@ -0,0 +1,79 @@
+#ifndef _MESH_PACK_H_
+#define _MESH_PACK_H_
+
+#include <vector>
+#include <mutex>
+
+#include "Mesh.h"
+#include "PackFormat.h"
+
+// an entry of the table of contents of a pack (PACK_ENTRY_SIZE bytes), in
+// the host byte order once the pack is open
+struct PackEntry {
+	uint64_t hash;		// hash64 of the name
+	uint64_t offset;	// of the data in the pack, aligned to PACK_ALIGNMENT
+	uint64_t size;
+	u32 name_offset;	// in the names
+	u16 name_size;		// without the null terminator
+	u16 kind;			// PACK_MESH...
+};
+
+struct MeshPack;
+
+void pack_close(MeshPack& pack);
+
+// a .pak file mapped by pack_open (see PackFile_desc.txt), the .m, .mat and
+// textures of many meshes in a single file. the table of contents is used in
+// place (swapped once if the pack byte order isn't the host's), a lookup by
+// name is a hash and a probe or two. the data of the entries and the meshes
+// of pack_mesh point into the mapping, which lives until pack_close
+struct MeshPack {
+	u8* mapping;
+	size_t size;
+
+	u32 n_entries;
+	u32 n_slots;				// of the hash table, a power of 2
+	const u32* slots;			// index of an entry + 1, PACK_NO_ENTRY for none
+	const PackEntry* entries;
+	const char* names;			// null terminated
+
+	// what pack_mesh did with each entry: the meshes viewed in place (and
+	// swapped) already and those it reads
+	std::vector<u8> views;
+	std::mutex lock;
+
+	MeshPack() : mapping(0), size(0), n_entries(0), n_slots(0), slots(0), entries(0), names(0) {}
+
+	~MeshPack() {
+		pack_close(*this);
+	}
+
+private:
+	MeshPack(const MeshPack&);
+	MeshPack& operator=(const MeshPack&);
+};
+
+// map a pack, false if it can't be mapped or its table of contents is invalid
+bool pack_open(const char* filename, MeshPack& out);
+
+// the entry named name (with '/' separators), 0 if the pack has none
+const PackEntry* pack_find(const MeshPack& pack, const char* name);
+
+// the data of an entry in the mapping, ie. a .mat or a texture as is
+inline const void* pack_data(const MeshPack& pack, const PackEntry& entry) {
+	return pack.mapping + entry.offset;
+}
+
+inline const char* pack_name(const MeshPack& pack, const PackEntry& entry) {
+	return pack.names + entry.name_offset;
+}
+
+// the mesh of the entry named name, without a copy when mesh_view can use it
+// in place: the arrays point into the mapping, swapped the first time if the
+// mesh byte order isn't the host's, quantized arrays stay quantized. the
+// encoded or compressed meshes and those of older converters are read with
+// mesh_read_memory into a block from allocator instead. pack_mesh can be
+// called from several threads
+bool pack_mesh(MeshPack& pack, const char* name, Mesh& out, MeshAllocator* allocator = 0);
+
+#endif
@@ -1,9 +1,30 @@
 #include <fstream>
 #include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 //#include <cstdint>
 //#include <gctypes.h>
 
-#include "Mesh.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "MeshReader.h"
+#include "ByteSwap.h"
+#include "MeshFormat.h"
+#include "MeshCodec.h"
+#include "Compress.h"
 
 using namespace std;
 
@@ -18,101 +39,1405 @@ using namespace std;
 #define PRINT_I(msg, i) {printf(msg); printf("%d\n", i);}
 
 struct header_t {
-	u16 n_vertices;
-	u16 n_faces;
-	u16 n_subMeshes;
+	u32 n_vertices;
+	u32 n_faces;
+	u32 n_subMeshes;
+	u32 indices_size;	// bytes of index data (version 2 and later)
+	u16 material_size;
+	u16 vertex_format;	// quantized arrays (version 4), MESH_POSITION_S16...
+	u16 vertex_stride;	// with MESH_INTERLEAVED (version 5)
+	u16 vertex_offsets[3];
+
+	// the triangles, index data size and error of each level of detail
+	// (version 8), the first one is the full detail of the counts above
+	u32 n_lods;
+	u32 lod_faces[MESH_MAX_LODS];
+	u32 lod_indices_size[MESH_MAX_LODS];
+	f32 lod_errors[MESH_MAX_LODS];
+
+	// the bounds of the mesh, and the offset of the ones of the submeshes in
+	// the file (version 9), 0 before
+	MeshBounds bounds;
+	size_t subMesh_bounds;
+
+	// the meshlets, their vertices and their triangles (version 10, with
+	// MESH_MESHLETS), 0 without
+	u32 n_meshlets;
+	u32 n_meshlet_vertices;
+	u32 n_meshlet_triangles;
+
+	u16 version;	// 0 for files without magic (older converters)
+	bool swap;		// the file byte order differs from the host
+	size_t size;	// size of the header in the file
 };
 
-void readVec3f(ifstream& inFile, int n_elements, Vec3* out, const char* dataName) {
-	float* data_src = new float[n_elements];
+static_assert(sizeof(SubMesh) == MESH_SUBMESH_SIZE, "SubMesh must match the .m submesh records");
+static_assert(sizeof(PositionQuant) == MESH_QUANT_SIZE, "PositionQuant must match the .m quantization records");
+static_assert(sizeof(MeshBounds) == MESH_BOUNDS_SIZE, "MeshBounds must match the .m bounds records");
+static_assert(sizeof(Meshlet) == MESH_MESHLET_SIZE, "Meshlet must match the .m meshlet records");
 
-	inFile.read((char*) data_src, n_elements*sizeof(f32));
+// the vertex_format bits this reader knows
+#define VERTEX_FORMAT_MASK (MESH_QUANTIZED | MESH_INTERLEAVED | MESH_ENCODED | MESH_COMPRESSED | MESH_MESHLETS | 0x0F00)
 
-	for (int i = 0, k = 0; i < n_elements; i+=3, k++) {
-		float x = data_src[i];
-		float y = data_src[i+1];
-		float z = data_src[i+2];
-		out[k].set(x, y, z);
+// the quantized bit of each attribute in vertex_format
+static const u16 quantized_bits[3] = {MESH_POSITION_S16, MESH_NORMAL_S8, MESH_TEXCOORD_S16};
 
-		//printf(dataName);
-		//printf("[%d] = (%.3f, %.3f, %.3f)\n", k, x, y, z);
+// bytes of an attribute of a vertex in format
+static u32 attribute_size(u16 format, int attribute) {
+	switch (attribute) {
+		case VERTEX_POSITION:	return format & MESH_POSITION_S16 ? sizeof(Vec3s16) : sizeof(Vec3);
+		case VERTEX_NORMAL:		return format & MESH_NORMAL_S8 ? sizeof(Vec3s8) : sizeof(Vec3);
+		default:				return format & MESH_TEXCOORD_S16 ? sizeof(Vec2s16) : sizeof(Vec2);
 	}
+}
 
-	delete[] data_src;
+// bytes of an element (a coordinate) of an attribute in format
+static u32 element_size(u16 format, int attribute) {
+	return attribute_size(format, attribute) / (attribute == VERTEX_TEXCOORD ? 2 : 3);
 }
 
-void readVec2f(ifstream& inFile, int n_elements, Vec2* out, const char* dataName) {
-	float* data_src = new float[n_elements];
+// default allocator, aligned blocks from the heap
+struct HeapAllocator : public MeshAllocator {
+	void* alloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+#else
+		void* ptr = 0;
+		if (posix_memalign(&ptr, alignment, size) != 0)
+			return 0;
+		return ptr;
+#endif
+	}
+
+	void release(void* ptr) {
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+};
+
+static HeapAllocator g_heap_allocator;
 
-	inFile.read((char*) data_src, n_elements*sizeof(f32));
+// the full detail only (before version 8)
+static void single_lod(header_t& header) {
+	header.n_lods = 1;
+	header.lod_faces[0] = header.n_faces;
+	header.lod_indices_size[0] = header.indices_size;
+	header.lod_errors[0] = 0;
+}
 
-	for (int i = 0, k = 0; i < n_elements; i+=2, k++) {
-		float x = data_src[i];
-		float y = data_src[i+1];
-		out[k].set(x, y);
+// the level of detail table after the layout (version 8)
+static bool parse_lods(const uint8_t* data, size_t size, header_t& header) {
+	if (size < header.size + sizeof(u32))
+		return false;
+	memcpy(&header.n_lods, data + header.size, sizeof(u32));
+	if (header.swap)
+		swap32(&header.n_lods, &header.n_lods, 1);
+	if (header.n_lods == 0 || header.n_lods > MESH_MAX_LODS)
+		return false;
 
-		//printf(dataName);
-		//printf("[%d] = (%.3f, %.3f)\n", k, x, y);
+	header.size += sizeof(u32) + header.n_lods * MESH_LOD_SIZE;
+	if (size < header.size)
+		return false;
+
+	for (u32 l = 0; l < header.n_lods; l++) {
+		u32 record[3];
+		memcpy(record, data + header.size - (header.n_lods - l) * MESH_LOD_SIZE, sizeof(record));
+		if (header.swap)
+			swap32(record, record, 3);
+		header.lod_faces[l] = record[0];
+		header.lod_indices_size[l] = record[1];
+		memcpy(&header.lod_errors[l], &record[2], sizeof(f32));
 	}
 
-	delete[] data_src;
+	// the first level is the full detail of the header
+	return header.lod_faces[0] == header.n_faces && header.lod_indices_size[0] == header.indices_size;
 }
 
-void mesh_read(const char* filename, Mesh& out) {
-	// read file contents
-	ifstream inFile(filename, ios::in | ios::binary);
-	
+// the meshlet counts after the level of detail table (version 10)
+static bool parse_meshlets(const uint8_t* data, size_t size, header_t& header) {
+	if (size < header.size + MESH_COUNTS_SIZE)
+		return false;
+	u32 counts[3];
+	memcpy(counts, data + header.size, sizeof(counts));
+	if (header.swap)
+		swap32(counts, counts, 3);
+	header.n_meshlets			= counts[0];
+	header.n_meshlet_vertices	= counts[1];
+	header.n_meshlet_triangles	= counts[2];
+	header.size += sizeof(counts);
+	return true;
+}
+
+// the bounds of the mesh after the level of detail table (version 9), those
+// of the submeshes follow and end the header
+static bool parse_bounds(const uint8_t* data, size_t size, header_t& header) {
+	if (size < header.size + MESH_BOUNDS_SIZE)
+		return false;
+	memcpy(&header.bounds, data + header.size, sizeof(MeshBounds));
+	if (header.swap)
+		swap32(&header.bounds, &header.bounds, sizeof(MeshBounds) / sizeof(u32));
+
+	header.subMesh_bounds = header.size + MESH_BOUNDS_SIZE;
+	header.size = header.subMesh_bounds + (size_t) header.n_subMeshes * MESH_BOUNDS_SIZE;
+	return true;
+}
+
+// parse the header at the start of data. files without magic come from older
+// converters, they are always big-endian
+static bool parse_header(const uint8_t* data, size_t size, header_t& header) {
+	header.vertex_format = 0;
+	header.bounds = MeshBounds();
+	header.subMesh_bounds = 0;
+	header.n_meshlets = 0;
+	header.n_meshlet_vertices = 0;
+	header.n_meshlet_triangles = 0;
+	if (size >= MESH_HEADER_SIZE_V1 && memcmp(data, MESH_MAGIC, 4) == 0) {
+		u16 bom, version;
+		memcpy(&bom, data + 4, sizeof(u16));
+		memcpy(&version, data + 6, sizeof(u16));
+
+		if (bom == MESH_BOM)
+			header.swap = false;
+		else if (bom == swap_u16(MESH_BOM))
+			header.swap = true;
+		else
+			return false;
+
+		header.version = header.swap ? swap_u16(version) : version;
+		if (header.version == 0 || header.version > MESH_VERSION) {
+			printf("unsupported .m version %d\n", header.version);
+			return false;
+		}
+	}
+	else {
+		header.version = 0;
+		header.swap = !host_big_endian();
+	}
+
+	if (header.version >= 2) {
+		if (size < MESH_HEADER_SIZE)
+			return false;
+
+		u32 counts[4];
+		u16 material[2];	// material_size, vertex_format (0 before version 4)
+		memcpy(counts, data + 8, sizeof(counts));
+		memcpy(material, data + 24, sizeof(material));
+		if (header.swap) {
+			swap32(counts, counts, 4);
+			swap16(material, material, 2);
+		}
+
+		header.n_vertices		= counts[0];
+		header.n_faces			= counts[1];
+		header.n_subMeshes		= counts[2];
+		header.indices_size		= counts[3];
+		header.material_size	= material[0];
+		header.vertex_format	= material[1];
+		header.size				= MESH_HEADER_SIZE;
+
+		if (header.vertex_format & ~VERTEX_FORMAT_MASK ||
+			(header.vertex_format & MESH_ENCODED && header.vertex_format & MESH_COMPRESSED)) {
+			printf("unsupported .m vertex format 0x%x\n", header.vertex_format);
+			return false;
+		}
+
+		// the stride and offsets of the interleaved vertices follow, each
+		// attribute aligned to its elements inside a 4-byte aligned record
+		if (header.vertex_format & MESH_INTERLEAVED) {
+			header.size += MESH_LAYOUT_SIZE;
+			if (size < header.size)
+				return false;
+
+			u16 layout[4];
+			memcpy(layout, data + MESH_HEADER_SIZE, sizeof(layout));
+			if (header.swap)
+				swap16(layout, layout, 4);
+
+			header.vertex_stride = layout[0];
+			if (header.vertex_stride == 0 || header.vertex_stride % 4 != 0)
+				return false;
+			for (int a = 0; a < 3; a++) {
+				u32 size = attribute_size(header.vertex_format, a);
+				header.vertex_offsets[a] = layout[1 + a];
+				if (layout[1 + a] % element_size(header.vertex_format, a) != 0 || layout[1 + a] + size > header.vertex_stride)
+					return false;
+			}
+		}
+
+		if (header.version < 8)
+			single_lod(header);
+		else if (!parse_lods(data, size, header))
+			return false;
+		if (header.vertex_format & MESH_MESHLETS && (header.version < 10 || !parse_meshlets(data, size, header)))
+			return false;
+		return header.version < 9 || parse_bounds(data, size, header);
+	}
+
+	// versions 0 and 1: 16-bit counts and indices
+	const uint8_t* data_counts = header.version ? data + 8 : data;
+	header.size = header.version ? MESH_HEADER_SIZE_V1 : 4 * sizeof(u16);
+	if (size < header.size)
+		return false;
+
+	u16 counts[4];
+	memcpy(counts, data_counts, sizeof(counts));
+	if (header.swap)
+		swap16(counts, counts, 4);
+
+	header.n_vertices		= counts[0];
+	header.n_faces			= counts[1];
+	header.n_subMeshes		= counts[2];
+	header.indices_size		= 3 * counts[1] * sizeof(u16);
+	header.material_size	= counts[3];
+	single_lod(header);
+	return true;
+}
+
+// the u32 fields of the submesh records
+static void swap_submeshes(Mesh& mesh) {
+	for (u32 i = 0; i < mesh.n_subMeshes; i++)
+		swap32(&mesh.subMeshes[i], &mesh.subMeshes[i], 4);
+}
+
+// the indices of each submesh, by their size. the records must be valid
+static void swap_indices(Mesh& mesh) {
+	for (u32 i = 0; i < mesh.n_subMeshes; i++) {
+		const SubMesh& subMesh = mesh.subMeshes[i];
+		void* indices = (u8*) mesh.indices + subMesh.index_offset;
+		if (subMesh.index_size == 2)
+			swap16(indices, indices, subMesh.index_count());
+		else if (subMesh.index_size == 4)
+			swap32(indices, indices, subMesh.index_count());
+	}
+}
+
+// the vertices of an attribute of a mesh, whatever its layout and format
+struct stream_t {
+	u8* data;
+	u32 stride;
+};
+
+static stream_t vertex_stream(const Mesh& mesh, int attribute) {
+	stream_t stream;
+	VertexView<u8> view = mesh.view<u8>((VertexAttribute) attribute);
+	stream.data = view.data;
+	stream.stride = mesh.vertex_format & MESH_INTERLEAVED ? mesh.vertex_stride : attribute_size(mesh.vertex_format, attribute);
+	return stream;
+}
+
+// the vertices, f32 or quantized as vertex_format says
+static void swap_arrays(Mesh& mesh) {
+	for (int a = 0; a < 3; a++) {
+		stream_t stream = vertex_stream(mesh, a);
+		u32 size = attribute_size(mesh.vertex_format, a);
+		u32 element = element_size(mesh.vertex_format, a);
+		if (element == 1)
+			continue;	// s8
+
+		// whole arrays at once, records one by one
+		u32 n = mesh.vertex_format & MESH_INTERLEAVED ? mesh.n_vertices : 1;
+		u32 count = mesh.vertex_format & MESH_INTERLEAVED ? size : size * mesh.n_vertices;
+		for (u32 v = 0; v < n; v++) {
+			u8* data = stream.data + (size_t) v * stream.stride;
+			if (element == 4)
+				swap32(data, data, count / 4);
+			else
+				swap16(data, data, count / 2);
+		}
+	}
+
+	if (mesh.quant)
+		swap32(mesh.quant, mesh.quant, 6 * mesh.n_subMeshes);
+}
+
+// the submesh records must describe index data inside the mesh, and with
+// quantized positions consecutive vertex ranges (up to the next base vertex)
+static bool check_submeshes(const Mesh& mesh) {
+	for (u32 i = 0; i < mesh.n_subMeshes; i++) {
+		const SubMesh& subMesh = mesh.subMeshes[i];
+		if (mesh.vertex_format & MESH_POSITION_S16) {
+			u32 end = i + 1 < mesh.n_subMeshes ? mesh.subMeshes[i + 1].base_vertex : mesh.n_vertices;
+			if (subMesh.base_vertex > end || end > mesh.n_vertices)
+				return false;
+		}
+		if (subMesh.index_size != 1 && subMesh.index_size != 2 && subMesh.index_size != 4)
+			return false;
+		if (subMesh.index_offset % subMesh.index_size != 0)
+			return false;
+		if (subMesh.primitive > MESH_TRIANGLE_STRIP_RESTART)
+			return false;
+
+		uint64_t end = subMesh.index_offset + (uint64_t) subMesh.index_count() * subMesh.index_size;
+		if (end > mesh.indices_size)
+			return false;
+	}
+	return true;
+}
+
+// the bytes of the meshlet records, vertices and triangles in the file
+static void meshlet_sizes(const header_t& header, size_t sizes[3]) {
+	sizes[0] = (size_t) header.n_meshlets * sizeof(Meshlet);
+	sizes[1] = (size_t) header.n_meshlet_vertices * sizeof(u32);
+	sizes[2] = ((size_t) header.n_meshlet_triangles * 3 + 3) & ~(size_t) 3;
+}
+
+static void swap_meshlets(Mesh& mesh, const header_t& header) {
+	for (u32 m = 0; m < mesh.n_meshlets; m++) {
+		Meshlet& meshlet = mesh.meshlets[m];
+		swap32(&meshlet.vertex_offset, &meshlet.vertex_offset, 2);
+		meshlet.subMesh = swap_u16(meshlet.subMesh);
+		swap32(meshlet.center, meshlet.center, 8);
+	}
+	swap32(mesh.meshlet_vertices, mesh.meshlet_vertices, header.n_meshlet_vertices);
+}
+
+// the meshlets only use their own vertices and triangles
+static bool check_meshlets(const Mesh& mesh, const header_t& header) {
+	for (u32 m = 0; m < mesh.n_meshlets; m++) {
+		const Meshlet& meshlet = mesh.meshlets[m];
+		if (meshlet.subMesh >= mesh.n_subMeshes ||
+			(uint64_t) meshlet.vertex_offset + meshlet.vertex_count > header.n_meshlet_vertices ||
+			(uint64_t) meshlet.triangle_offset + 3 * meshlet.triangle_count > 3 * (uint64_t) header.n_meshlet_triangles)
+			return false;
+		for (u32 v = 0; v < meshlet.vertex_count; v++) {
+			if (mesh.meshlet_vertices[meshlet.vertex_offset + v] >= mesh.n_vertices)
+				return false;
+		}
+		for (u32 i = 0; i < 3u * meshlet.triangle_count; i++) {
+			if (mesh.meshlet_triangles[meshlet.triangle_offset + i] >= meshlet.vertex_count)
+				return false;
+		}
+	}
+	return true;
+}
+
+static size_t align_size(size_t size) {
+	return (size + MESH_ALIGNMENT - 1) & ~(size_t)(MESH_ALIGNMENT - 1);
+}
+
+// bytes of the vertex arrays in the file, the quantized ones are padded to
+// 4. the interleaved vertices count as positions
+struct arrays_t {
+	size_t positions;
+	size_t normals;
+	size_t texcoord;
+	size_t quant;	// the PositionQuant records, after the submeshes
+};
+
+static arrays_t file_arrays(const header_t& header) {
+	size_t n = header.n_vertices;
+	u16 format = header.vertex_format;
+
+	arrays_t arrays;
+	if (format & MESH_INTERLEAVED) {
+		arrays.positions	= n * header.vertex_stride;
+		arrays.normals		= 0;
+		arrays.texcoord		= 0;
+	}
+	else {
+		arrays.positions	= (n * attribute_size(format, VERTEX_POSITION) + 3) & ~3;
+		arrays.normals		= (n * attribute_size(format, VERTEX_NORMAL) + 3) & ~3;
+		arrays.texcoord		= (n * attribute_size(format, VERTEX_TEXCOORD) + 3) & ~3;
+	}
+	arrays.quant = format & MESH_POSITION_S16 ? header.n_subMeshes * sizeof(PositionQuant) : 0;
+	return arrays;
+}
+
+// fill the f32 vertices of mesh from src, in format: the quantized
+// attributes are dequantized, the others copied unless they are in place
+// already. the submeshes must be valid
+static void dequantize(Mesh& mesh, u16 format, const stream_t src[3], const PositionQuant* quant) {
+	for (int a = 0; a < 3; a++) {
+		stream_t dst = vertex_stream(mesh, a);
+		if (!(format & quantized_bits[a]) && dst.data != src[a].data) {
+			u32 size = attribute_size(0, a);
+			for (u32 v = 0; v < mesh.n_vertices; v++)
+				memcpy(dst.data + (size_t) v * dst.stride, src[a].data + (size_t) v * src[a].stride, size);
+		}
+	}
+
+	if (format & MESH_POSITION_S16) {
+		VertexView<Vec3s16> q(src[VERTEX_POSITION].data, src[VERTEX_POSITION].stride);
+		VertexView<Vec3> positions = mesh.view<Vec3>(VERTEX_POSITION);
+		for (u32 i = 0; i < mesh.n_subMeshes; i++) {
+			const PositionQuant& pq = quant[i];
+			u32 end = i + 1 < mesh.n_subMeshes ? mesh.subMeshes[i + 1].base_vertex : mesh.n_vertices;
+			for (u32 v = mesh.subMeshes[i].base_vertex; v < end; v++) {
+				positions[v].set(pq.offset[0] + q[v].x * pq.scale[0],
+					pq.offset[1] + q[v].y * pq.scale[1],
+					pq.offset[2] + q[v].z * pq.scale[2]);
+			}
+		}
+	}
+
+	if (format & MESH_NORMAL_S8) {
+		VertexView<Vec3s8> q(src[VERTEX_NORMAL].data, src[VERTEX_NORMAL].stride);
+		VertexView<Vec3> normals = mesh.view<Vec3>(VERTEX_NORMAL);
+		for (u32 v = 0; v < mesh.n_normals; v++)
+			normals[v].set(q[v].x / 127.0f, q[v].y / 127.0f, q[v].z / 127.0f);
+	}
+
+	if (format & MESH_TEXCOORD_S16) {
+		VertexView<Vec2s16> q(src[VERTEX_TEXCOORD].data, src[VERTEX_TEXCOORD].stride);
+		VertexView<Vec2> texcoord = mesh.view<Vec2>(VERTEX_TEXCOORD);
+		f32 scale = 1.0f / (1 << MESH_TEXCOORD_SHIFT(format));
+		for (u32 v = 0; v < mesh.n_texcoord; v++)
+			texcoord[v].set(q[v].x * scale, q[v].y * scale);
+	}
+}
+
+// read the 16-bit indices and submeshes of versions 0 and 1 into the
+// current layout: the indices stay as they are, with a base vertex of 0
+static bool read_legacy_indices(istream& inFile, const header_t& header, Mesh& out) {
+	inFile.read((char*) out.indices, header.indices_size);
+
+	std::vector<u16> subMeshes(2 * header.n_subMeshes);
+	std::vector<u8> materials(header.n_subMeshes);
+	if (header.n_subMeshes) {
+		inFile.read((char*) &subMeshes[0], subMeshes.size() * sizeof(u16));
+		inFile.read((char*) &materials[0], materials.size());
+	}
+	if (!inFile)
+		return false;
+
+	if (header.swap) {
+		swap16(out.indices, out.indices, 3 * header.n_faces);
+		if (header.n_subMeshes)
+			swap16(&subMeshes[0], &subMeshes[0], subMeshes.size());
+	}
+
+	for (u32 i = 0; i < header.n_subMeshes; i++) {
+		SubMesh& subMesh = out.subMeshes[i];
+		subMesh.start			= subMeshes[2 * i];
+		subMesh.size			= subMeshes[2 * i + 1];
+		subMesh.base_vertex		= 0;
+		subMesh.index_offset	= 3 * subMesh.start * sizeof(u16);
+		subMesh.index_size		= sizeof(u16);
+		subMesh.material		= materials[i];
+		subMesh.primitive		= MESH_TRIANGLES;
+		subMesh.reserved		= 0;
+	}
+	return true;
+}
+
+// an encoded section of the file (MESH_ENCODED): its size, then its data
+// padded to 4 bytes
+static bool read_encoded(istream& inFile, const header_t& header, std::vector<u8>& data) {
+	u32 size = 0;
+	inFile.read((char*) &size, sizeof(size));
+	if (header.swap)
+		swap32(&size, &size, 1);
+
+	// no larger than the rest of the file
+	streampos position = inFile.tellg();
+	inFile.seekg(0, ios::end);
+	streampos end = inFile.tellg();
+	inFile.seekg(position);
+	if (!inFile || (uint64_t) size > (uint64_t) (end - position))
+		return false;
+
+	data.resize((size + 3) & ~3);
+	inFile.read((char*) data.data(), data.size());
+	data.resize(size);
+	return !!inFile;
+}
+
+// decode the vertex streams of data to the arrays as the file would have
+// them (positions has all the records when interleaved)
+static bool decode_vertex_streams(const std::vector<u8>& data, const header_t& header, u8* positions, u8* normals, u8* texcoord) {
+	size_t n = header.n_vertices;
+	size_t offset = 0, used = 0;
+
+	if (header.vertex_format & MESH_INTERLEAVED) {
+		if (!decode_vertices(positions, n, header.vertex_stride, data.data(), data.size(), used))
+			return false;
+		return used == data.size();
+	}
+
+	arrays_t file = file_arrays(header);
+	u8* arrays[3] = {positions, normals, texcoord};
+	size_t sizes[3] = {file.positions, file.normals, file.texcoord};
+	for (int a = 0; a < 3; a++) {
+		size_t stride = attribute_size(header.vertex_format, a);
+		if (!decode_vertices(arrays[a], n, stride, data.data() + offset, data.size() - offset, used))
+			return false;
+		memset(arrays[a] + n * stride, 0, sizes[a] - n * stride);
+		offset += used;
+	}
+	return offset == data.size();
+}
+
+// decode the index streams of data, one per submesh, to the indices of mesh
+// (host byte order). the submeshes must be valid
+static bool decode_index_streams(const std::vector<u8>& data, Mesh& mesh) {
+	// the padding between the submeshes isn't in the streams
+	memset(mesh.indices, 0, mesh.indices_size);
+
+	size_t offset = 0, used = 0;
+	for (u32 i = 0; i < mesh.n_subMeshes; i++) {
+		const SubMesh& subMesh = mesh.subMeshes[i];
+		u8* indices = (u8*) mesh.indices + subMesh.index_offset;
+		if (!decode_indices(indices, subMesh.index_count(), subMesh.index_size, subMesh.primitive == MESH_TRIANGLES,
+			data.data() + offset, data.size() - offset, used))
+			return false;
+		offset += used;
+	}
+	return offset == data.size();
+}
+
+// a section of the file and where it goes once read
+struct section_t {
+	u8* data;
+	size_t size;
+};
+
+// the compressed sections of the file (MESH_COMPRESSED): the block count and
+// the compressed size of each block, then the blocks. the calling thread
+// reads them one by one while workers decompress those already read
+// straight into the sections, so decompression overlaps with reading. the
+// sections without data are skipped. without threads (the file is in memory
+// already) the blocks are decompressed on the calling thread
+static bool read_compressed(istream& inFile, const header_t& header, const section_t* sections, int n_sections, bool threads) {
+	// the blocks of each section, in order
+	struct block_t {
+		u8* dst;
+		size_t size;
+		size_t offset;		// in data
+		u32 compressed;
+	};
+	std::vector<block_t> blocks;
+	for (int s = 0; s < n_sections; s++) {
+		for (size_t offset = 0; offset < sections[s].size; offset += MESH_BLOCK_SIZE) {
+			block_t block;
+			block.dst = sections[s].data ? sections[s].data + offset : 0;
+			block.size = min(sections[s].size - offset, (size_t) MESH_BLOCK_SIZE);
+			blocks.push_back(block);
+		}
+	}
+
+	u32 n_blocks = 0;
+	inFile.read((char*) &n_blocks, sizeof(n_blocks));
+	if (header.swap)
+		swap32(&n_blocks, &n_blocks, 1);
+	if (!inFile || n_blocks != blocks.size())
+		return false;
+
+	std::vector<u32> sizes(n_blocks);
+	if (n_blocks)
+		inFile.read((char*) sizes.data(), n_blocks * sizeof(u32));
+	if (header.swap && n_blocks)
+		swap32(sizes.data(), sizes.data(), n_blocks);
+
+	// no block larger than it can be compressed to, and no larger than the
+	// rest of the file together. only the blocks up to the last one wanted
+	// are read
+	uint64_t total = 0;
+	size_t size_data = 0;
+	u32 n_read_blocks = 0, n_wanted = 0;
+	for (u32 b = 0; b < n_blocks; b++) {
+		block_t& block = blocks[b];
+		block.compressed = sizes[b];
+		size_t size = sizes[b] & ~MESH_BLOCK_RAW;
+		if (sizes[b] & MESH_BLOCK_RAW ? size != block.size : size > lz_compress_bound(block.size))
+			return false;
+		total += size;
+		if (block.dst) {
+			block.offset = size_data;
+			size_data += size;
+			n_read_blocks = b + 1;
+			n_wanted++;
+		}
+	}
+
+	streampos position = inFile.tellg();
+	inFile.seekg(0, ios::end);
+	streampos end = inFile.tellg();
+	inFile.seekg(position);
+	if (!inFile || total > (uint64_t) (end - position))
+		return false;
+
+	std::vector<u8> data(size_data);
+	auto read_block = [&](const block_t& block) {
+		size_t size = block.compressed & ~MESH_BLOCK_RAW;
+		if (block.dst)
+			inFile.read((char*) data.data() + block.offset, size);
+		else
+			inFile.seekg(size, ios::cur);
+		return !!inFile;
+	};
+	auto decompress = [&](const block_t& block) {
+		size_t size = block.compressed & ~MESH_BLOCK_RAW;
+		if (!block.dst)
+			return true;
+		if (block.compressed & MESH_BLOCK_RAW) {
+			memcpy(block.dst, data.data() + block.offset, size);
+			return true;
+		}
+		return lz_decompress(block.dst, block.size, data.data() + block.offset, size);
+	};
+
+	// a single block is read and decompressed in turn
+	if (n_wanted <= 1 || !threads) {
+		for (u32 b = 0; b < n_read_blocks; b++) {
+			if (!read_block(blocks[b]))
+				return false;
+		}
+		for (u32 b = 0; b < n_read_blocks; b++) {
+			if (!decompress(blocks[b]))
+				return false;
+		}
+		return true;
+	}
+
+	std::mutex mutex;
+	std::condition_variable ready;
+	u32 n_read = 0;			// blocks read so far
+	bool read_failed = false;
+	std::atomic<u32> next(0);
+	std::atomic<bool> failed(false);
+
+	auto worker = [&]() {
+		for (u32 b = next++; b < n_read_blocks && !failed; b = next++) {
+			if (!blocks[b].dst)
+				continue;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				ready.wait(lock, [&]() { return n_read > b || read_failed; });
+				if (n_read <= b)
+					return;
+			}
+			if (!decompress(blocks[b]))
+				failed = true;
+		}
+	};
+
+	u32 n_workers = min(max(std::thread::hardware_concurrency(), 1u), n_wanted);
+	std::vector<std::thread> workers;
+	for (u32 i = 0; i < n_workers; i++)
+		workers.push_back(std::thread(worker));
+
+	for (u32 b = 0; b < n_read_blocks && !failed; b++) {
+		bool ok = read_block(blocks[b]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!ok) {
+			read_failed = true;
+			ready.notify_all();
+			break;
+		}
+		n_read = b + 1;
+		ready.notify_all();
+	}
+	{
+		// stop the workers waiting for blocks that won't be read
+		std::lock_guard<std::mutex> lock(mutex);
+		if (n_read < n_read_blocks)
+			read_failed = true;
+		ready.notify_all();
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	return !failed && n_read == n_read_blocks;
+}
+
+// the levels of detail of header in mesh
+static void set_lods(Mesh& mesh, const header_t& header, u32 lod) {
+	mesh.lod = lod;
+	mesh.n_lods = header.n_lods;
+	memcpy(mesh.lod_errors, header.lod_errors, header.n_lods * sizeof(f32));
+}
+
+// the bounds of header in mesh, with the ones of the submeshes read to
+// subMesh_bounds (in the file byte order, 0 before version 9)
+static void set_bounds(Mesh& mesh, const header_t& header, MeshBounds* subMesh_bounds) {
+	mesh.bounds = header.bounds;
+	mesh.subMesh_bounds = subMesh_bounds;
+	if (subMesh_bounds && header.swap)
+		swap32(subMesh_bounds, subMesh_bounds, header.n_subMeshes * sizeof(MeshBounds) / sizeof(u32));
+}
+
+// skip an encoded section
+static void skip_encoded(istream& inFile, const header_t& header) {
+	u32 size = 0;
+	inFile.read((char*) &size, sizeof(size));
+	if (header.swap)
+		swap32(&size, &size, 1);
+	inFile.seekg(((streamoff) size + 3) & ~3, ios::cur);
+}
+
+// a read-only stream over a file already in memory, seeking within it
+class memory_buf : public streambuf {
+public:
+	memory_buf(const void* data, size_t size) {
+		char* begin = (char*) data;
+		setg(begin, begin, begin + size);
+	}
+
+protected:
+	pos_type seekoff(off_type offset, ios::seekdir dir, ios::openmode) {
+		char* from = dir == ios::beg ? eback() : dir == ios::cur ? gptr() : egptr();
+		if (offset < eback() - from || offset > egptr() - from)
+			return pos_type(off_type(-1));
+		setg(eback(), from + offset, egptr());
+		return pos_type(off_type(gptr() - eback()));
+	}
+
+	pos_type seekpos(pos_type position, ios::openmode which) {
+		return seekoff(off_type(position), ios::beg, which);
+	}
+};
+
+// mesh_read from the stream of filename, decompressing on worker threads
+// with threads
+static bool read_mesh(istream& inFile, const char* filename, Mesh& out, MeshAllocator* allocator, bool keep_quantized, u32 lod, bool threads) {
 	// read header
+	uint8_t header_data[MESH_MAX_HEADER_SIZE];
+	inFile.read((char*) header_data, sizeof(header_data));
+
 	header_t header;
-	inFile.read((char*) &header, sizeof(header));
+	if (!parse_header(header_data, (size_t) inFile.gcount(), header)) {
+		printf("mesh_read: '%s' is not a .m file\n", filename);
+		return false;
+	}
+
+	// the triangles of the level of detail asked for (or the coarsest one)
+	// replace the full detail
+	lod = min(lod, header.n_lods - 1);
+	header.n_faces = header.lod_faces[lod];
+	header.indices_size = header.lod_indices_size[lod];
+
+	// the quantized arrays are kept as they are in the file, or read into
+	// staging and dequantized into f32 arrays once swapped. interleaved
+	// vertices are staged whole and become f32 records. encoded data is
+	// decoded to the arrays the file would have otherwise, compressed data
+	// decompressed to them
+	u16 format = header.vertex_format & ~(MESH_ENCODED | MESH_COMPRESSED | MESH_MESHLETS);
+	bool encoded = (header.vertex_format & MESH_ENCODED) != 0;
+	bool compressed = (header.vertex_format & MESH_COMPRESSED) != 0;
+	u16 staged = keep_quantized ? 0 : format & MESH_QUANTIZED;
+	bool interleaved = (format & MESH_INTERLEAVED) != 0;
+	arrays_t file = file_arrays(header);
+	size_t n_vertices = header.n_vertices;
+
+	// the layout of the vertices once read
+	u16 out_format = staged ? format & ~(MESH_QUANTIZED | 0x0F00) : format;
+	arrays_t arrays = file;
+	if (staged && interleaved) {
+		arrays.positions	= n_vertices * (sizeof(Vec3) + sizeof(Vec3) + sizeof(Vec2));
+		arrays.quant		= 0;
+	}
+	else if (staged) {
+		for (int a = 0; a < 3; a++) {
+			size_t size = n_vertices * attribute_size(out_format, a);
+			if (a == VERTEX_POSITION)	arrays.positions = size;
+			if (a == VERTEX_NORMAL)		arrays.normals = size;
+			if (a == VERTEX_TEXCOORD)	arrays.texcoord = size;
+		}
+		if (staged & MESH_POSITION_S16)
+			arrays.quant = 0;
+	}
+
+	// a single block holds all the arrays, each one aligned to MESH_ALIGNMENT
+	size_t size_indices		= header.indices_size;
+	size_t size_subMeshes	= header.n_subMeshes * sizeof(SubMesh);
+	size_t size_bounds		= header.subMesh_bounds ? header.n_subMeshes * sizeof(MeshBounds) : 0;
+
+	// the meshlets are those of the full detail
+	size_t size_meshlets[3] = {0, 0, 0};
+	if (lod == 0)
+		meshlet_sizes(header, size_meshlets);
+
+	size_t offset_positions	= 0;
+	size_t offset_normals	= offset_positions + align_size(arrays.positions);
+	size_t offset_texcoord	= offset_normals + align_size(arrays.normals);
+	size_t offset_indices	= offset_texcoord + align_size(arrays.texcoord);
+	size_t offset_subMeshes	= offset_indices + align_size(size_indices);
+	size_t offset_quant		= offset_subMeshes + align_size(size_subMeshes);
+	size_t offset_bounds	= offset_quant + align_size(arrays.quant);
+	size_t offset_meshlets	= offset_bounds + align_size(size_bounds);
+	size_t offset_meshlet_vertices	= offset_meshlets + align_size(size_meshlets[0]);
+	size_t offset_meshlet_triangles	= offset_meshlet_vertices + align_size(size_meshlets[1]);
+	size_t size_block		= offset_meshlet_triangles + align_size(size_meshlets[2]);
+
+	size_t size_staging = 0;
+	if (staged && interleaved)
+		size_staging = file.positions + file.quant;
+	else {
+		if (staged & MESH_POSITION_S16)
+			size_staging += file.positions + file.quant;
+		if (staged & MESH_NORMAL_S8)
+			size_staging += file.normals;
+		if (staged & MESH_TEXCOORD_S16)
+			size_staging += file.texcoord;
+	}
+	std::vector<u32> staging((size_staging + 3) / 4);
+	uint8_t* stage = (uint8_t*) staging.data();
+
+	if (!allocator)
+		allocator = &g_heap_allocator;
+
+	uint8_t* block = (uint8_t*) allocator->alloc(size_block, MESH_ALIGNMENT);
+	if (!block) {
+		printf("mesh_read: can't allocate %u bytes for '%s'\n", (unsigned) size_block, filename);
+		return false;
+	}
+
+	out.block		= block;
+	out.allocator	= allocator;
+	out.generation	= allocator->generation();
+	set_lods(out, header, lod);
+
+	// the bounds of the submeshes end the header, then skip the material name
+	inFile.clear();
+	if (size_bounds) {
+		inFile.seekg(header.subMesh_bounds, ios::beg);
+		inFile.read((char*) block + offset_bounds, size_bounds);
+		set_bounds(out, header, (MeshBounds*) (block + offset_bounds));
+	}
+	else
+		set_bounds(out, header, 0);
+	inFile.seekg(header.size + header.material_size, ios::beg);
 
 	// fill sizes info
-	out.n_vertices	= header.n_vertices;
-	out.n_texcoord	= header.n_vertices;
-	out.n_normals	= header.n_vertices;
-	out.n_subMeshes = header.n_subMeshes;
-
-	printf("n_vertex = %d\n",	 header.n_vertices);
-	printf("n_tris = %d\n",		 header.n_faces);
-	printf("n_subMeshes = %d\n", header.n_subMeshes);
-
-	// read vertices
-	int n_elements = 3*out.n_vertices;
-	out.vertices = new Vec3[out.n_vertices];
-	readVec3f(inFile, n_elements, out.vertices, "vertices");
-
-	// read normals
-	n_elements = 3*out.n_normals;
-	out.normals = new Vec3[out.n_normals];
-	readVec3f(inFile, n_elements, out.normals, "normals");
-
-	// read texture coordinates
-	n_elements = 2*out.n_texcoord;
-	out.texcoord = new Vec2[out.n_texcoord];
-	readVec2f(inFile, n_elements, out.texcoord, "texcoords");
-
-	// read indices
-	n_elements = 3*header.n_faces;
-	out.indices = new u16[n_elements];
-	inFile.read((char*) out.indices, n_elements*sizeof(u16));
-
-	//for (int i = 0; i < n_elements; i++) {
-	//	printf("indices[%d]= %d\n", i, out.indices[i]);
-	//}
-
-	// read sub meshes
-	n_elements = 2*out.n_subMeshes;
-	u16* subMeshes_src = new u16[n_elements];
-	out.subMeshes = new SubMesh[out.n_subMeshes];
-
-	inFile.read((char*) subMeshes_src, n_elements*sizeof(u16));
-
-	for (int i = 0,k=0; i < n_elements; i+=2,k++) {
-		int start	= subMeshes_src[i];
-		int n		= subMeshes_src[i+1];
-		out.subMeshes[k].set(start, n);
-		//printf("subMesh[%d] = (%d, %d)\n", k, start, n);
-	}
-
-	delete[] subMeshes_src;
+	out.n_vertices		= header.n_vertices;
+	out.n_tris			= header.n_faces;
+	out.n_texcoord		= header.n_vertices;
+	out.n_normals		= header.n_vertices;
+	out.n_subMeshes		= header.n_subMeshes;
+	out.indices_size	= header.indices_size;
+
+	out.indices		= block + offset_indices;
+	out.subMeshes	= (SubMesh*) (block + offset_subMeshes);
+	if (size_meshlets[0]) {
+		out.n_meshlets			= header.n_meshlets;
+		out.meshlets			= (Meshlet*) (block + offset_meshlets);
+		out.meshlet_vertices	= (u32*) (block + offset_meshlet_vertices);
+		out.meshlet_triangles	= block + offset_meshlet_triangles;
+	}
+
+	// out describes the vertices as they are in the file until they are
+	// dequantized, in the block or in staging. the file stores the arrays
+	// back to back, read them in place
+	uint8_t* positions	= block + offset_positions;
+	uint8_t* normals	= block + offset_normals;
+	uint8_t* texcoord	= block + offset_texcoord;
+	uint8_t* quant		= block + offset_quant;
+
+	if (staged & MESH_POSITION_S16 || (staged && interleaved)) {
+		positions = stage;		stage += file.positions;
+		quant = stage;			stage += file.quant;
+	}
+	if (staged & MESH_NORMAL_S8 && !interleaved) {
+		normals = stage;		stage += file.normals;
+	}
+	if (staged & MESH_TEXCOORD_S16 && !interleaved) {
+		texcoord = stage;		stage += file.texcoord;
+	}
+
+	out.vertex_format = format;
+	if (interleaved) {
+		out.vertex_data		= positions;
+		out.vertex_stride	= header.vertex_stride;
+		memcpy(out.vertex_offsets, header.vertex_offsets, sizeof(out.vertex_offsets));
+	}
+	else {
+		if (format & MESH_POSITION_S16)
+			out.q_vertices = (s16*) positions;
+		else
+			out.vertices = (Vec3*) positions;
+
+		if (format & MESH_NORMAL_S8)
+			out.q_normals = (s8*) normals;
+		else
+			out.normals = (Vec3*) normals;
+
+		if (format & MESH_TEXCOORD_S16)
+			out.q_texcoord = (s16*) texcoord;
+		else
+			out.texcoord = (Vec2*) texcoord;
+	}
+	if (format & MESH_POSITION_S16)
+		out.quant = (PositionQuant*) quant;
+
+	bool ok = true;
+	std::vector<u8> encoded_data;
+	if (compressed) {
+		// the submeshes and indices of the other levels of detail are skipped
+		section_t sections[6 + 2 * (MESH_MAX_LODS - 1) + 3] = {
+			{positions, file.positions},
+			{normals, file.normals},
+			{texcoord, file.texcoord},
+			{lod == 0 ? (u8*) out.subMeshes : 0, size_subMeshes},
+			{quant, file.quant},
+			{lod == 0 ? (u8*) out.indices : 0, header.lod_indices_size[0]}
+		};
+		int n_sections = 6;
+		for (u32 l = 1; l < header.n_lods; l++) {
+			sections[n_sections].data = l == lod ? (u8*) out.subMeshes : 0;
+			sections[n_sections++].size = size_subMeshes;
+			sections[n_sections].data = l == lod ? (u8*) out.indices : 0;
+			sections[n_sections++].size = header.lod_indices_size[l];
+		}
+		if (header.vertex_format & MESH_MESHLETS) {
+			size_t sizes[3];
+			meshlet_sizes(header, sizes);
+			u8* data[3] = {(u8*) out.meshlets, (u8*) out.meshlet_vertices, out.meshlet_triangles};
+			for (int k = 0; k < 3; k++) {
+				sections[n_sections].data = data[k];
+				sections[n_sections++].size = sizes[k];
+			}
+		}
+		if (!read_compressed(inFile, header, sections, n_sections, threads)) {
+			printf("mesh_read: '%s' has invalid compressed data\n", filename);
+			mesh_release(out);
+			return false;
+		}
+	}
+	else if (encoded) {
+		if (!read_encoded(inFile, header, encoded_data)) {
+			printf("mesh_read: '%s' is truncated\n", filename);
+			mesh_release(out);
+			return false;
+		}
+		if (!decode_vertex_streams(encoded_data, header, positions, normals, texcoord)) {
+			printf("mesh_read: '%s' has invalid vertex data\n", filename);
+			mesh_release(out);
+			return false;
+		}
+	}
+	else {
+		inFile.read((char*) positions, file.positions);
+		inFile.read((char*) normals, file.normals);
+		inFile.read((char*) texcoord, file.texcoord);
+	}
+
+	if (compressed) {
+		if (header.swap)
+			swap_submeshes(out);
+	}
+	else if (header.version >= 2) {
+		// the submesh records (and the quantization of their positions)
+		// come before the indices they describe. the records and indices of
+		// each other level of detail follow, up to the one read
+		inFile.read((char*) out.subMeshes, size_subMeshes);
+		inFile.read((char*) quant, file.quant);
+		for (u32 l = 0; l < lod; l++) {
+			if (encoded)
+				skip_encoded(inFile, header);
+			else
+				inFile.seekg(header.lod_indices_size[l], ios::cur);
+			if (l + 1 < lod)
+				inFile.seekg(size_subMeshes, ios::cur);
+			else
+				inFile.read((char*) out.subMeshes, size_subMeshes);
+		}
+		if (encoded)
+			ok = read_encoded(inFile, header, encoded_data);
+		else
+			inFile.read((char*) out.indices, size_indices);
+
+		// the meshlets follow the last level of detail
+		if (out.n_meshlets) {
+			for (u32 l = 1; l < header.n_lods; l++) {
+				inFile.seekg(size_subMeshes, ios::cur);
+				if (encoded)
+					skip_encoded(inFile, header);
+				else
+					inFile.seekg(header.lod_indices_size[l], ios::cur);
+			}
+			inFile.read((char*) out.meshlets, size_meshlets[0]);
+			inFile.read((char*) out.meshlet_vertices, size_meshlets[1]);
+			inFile.read((char*) out.meshlet_triangles, size_meshlets[2]);
+		}
+		ok = ok && !!inFile;
+		if (ok && header.swap)
+			swap_submeshes(out);
+	}
+	else {
+		ok = read_legacy_indices(inFile, header, out);
+	}
+
+	if (!ok || !inFile) {
+		printf("mesh_read: '%s' is truncated\n", filename);
+		mesh_release(out);
+		return false;
+	}
+
+	if (!check_submeshes(out)) {
+		printf("mesh_read: '%s' has invalid submeshes\n", filename);
+		mesh_release(out);
+		return false;
+	}
+
+	if (out.n_meshlets && header.swap)
+		swap_meshlets(out, header);
+	if (!check_meshlets(out, header)) {
+		printf("mesh_read: '%s' has invalid meshlets\n", filename);
+		mesh_release(out);
+		return false;
+	}
+
+	// decoded in the host byte order
+	if (encoded && !decode_index_streams(encoded_data, out)) {
+		printf("mesh_read: '%s' has invalid index data\n", filename);
+		mesh_release(out);
+		return false;
+	}
+
+	if (header.swap) {
+		swap_arrays(out);
+		if (header.version >= 2 && !encoded)
+			swap_indices(out);
+	}
+
+	// the f32 layout of the block replaces the one of the file
+	if (staged) {
+		stream_t src[3];
+		for (int a = 0; a < 3; a++)
+			src[a] = vertex_stream(out, a);
+		const PositionQuant* src_quant = out.quant;
+
+		out.vertex_format = out_format;
+		out.q_vertices	= 0;
+		out.q_normals	= 0;
+		out.q_texcoord	= 0;
+		out.quant		= 0;
+		if (interleaved) {
+			out.vertex_data			= block + offset_positions;
+			out.vertex_stride		= sizeof(Vec3) + sizeof(Vec3) + sizeof(Vec2);
+			out.vertex_offsets[0]	= 0;
+			out.vertex_offsets[1]	= sizeof(Vec3);
+			out.vertex_offsets[2]	= 2 * sizeof(Vec3);
+		}
+		else {
+			out.vertices	= (Vec3*) (block + offset_positions);
+			out.normals		= (Vec3*) (block + offset_normals);
+			out.texcoord	= (Vec2*) (block + offset_texcoord);
+		}
+		dequantize(out, staged | (format & 0x0F00), src, src_quant);
+	}
+
+	return true;
+}
+
+bool mesh_read(const char* filename, Mesh& out, MeshAllocator* allocator, bool keep_quantized, u32 lod) {
+	mesh_release(out);
+
+	// read file contents
+	ifstream inFile(filename, ios::in | ios::binary);
+	if (!inFile) {
+		printf("mesh_read: can't open '%s'\n", filename);
+		return false;
+	}
+	return read_mesh(inFile, filename, out, allocator, keep_quantized, lod, true);
+}
+
+bool mesh_read_memory(const void* data, size_t size, const char* name, Mesh& out, MeshAllocator* allocator, bool keep_quantized, u32 lod) {
+	mesh_release(out);
+
+	memory_buf buffer(data, size);
+	istream inFile(&buffer);
+	return read_mesh(inFile, name, out, allocator, keep_quantized, lod, false);
+}
+
+// map the whole file copy-on-write, so the arrays can be patched in place
+// without touching the file on disk
+void* map_file(const char* filename, size_t& size) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return 0;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return 0;
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);	// the view keeps the mapping alive
+
+	size = (size_t) fileSize.QuadPart;
+	return data;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	void* data = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);	// the mapping keeps the file alive
+	if (data == MAP_FAILED)
+		return 0;
+
+	size = (size_t) st.st_size;
+	return data;
+#endif
+}
+
+void unmap_file(void* data, size_t size) {
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
+// the arrays of out in the .m file of size bytes at data (see mesh_view),
+// arrays already swapped by an earlier view with swapped. the files
+// mesh_read has to read are only reported with verbose
+static bool view_mesh(uint8_t* data, size_t size, const char* filename, Mesh& out, bool swapped, bool verbose) {
+	header_t header;
+	if (!parse_header(data, size, header)) {
+		printf("mesh_map: '%s' is not a .m file\n", filename);
+		return false;
+	}
+	if (swapped)
+		header.swap = false;
+
+	if (header.vertex_format & (MESH_ENCODED | MESH_COMPRESSED)) {
+		if (verbose)
+			printf("mesh_map: '%s' is %s, use mesh_read\n", filename, header.vertex_format & MESH_ENCODED ? "encoded" : "compressed");
+		return false;
+	}
+
+	// the arrays can only be used in place in the current layout, older
+	// files have 16-bit submeshes and don't pad the material name
+	size_t offset = header.size + header.material_size;
+	if (header.version < 2 || offset % sizeof(f32) != 0) {
+		if (verbose)
+			printf("mesh_map: '%s' was written by an older converter, use mesh_read\n", filename);
+		return false;
+	}
+
+	// the quantized arrays stay quantized
+	arrays_t file = file_arrays(header);
+	size_t size_subMeshes	= header.n_subMeshes * sizeof(SubMesh);
+	size_t size_indices		= header.indices_size;
+
+	size_t required = offset + file.positions + file.normals + file.texcoord + size_subMeshes + file.quant + size_indices;
+	if (size < required) {
+		printf("mesh_map: '%s' is truncated (%u < %u bytes)\n", filename, (unsigned) size, (unsigned) required);
+		return false;
+	}
+
+	out.n_vertices		= header.n_vertices;
+	out.n_tris			= header.n_faces;
+	out.n_texcoord		= header.n_vertices;
+	out.n_normals		= header.n_vertices;
+	out.n_subMeshes		= header.n_subMeshes;
+	out.indices_size	= header.indices_size;
+	out.vertex_format	= header.vertex_format & ~MESH_MESHLETS;
+	set_lods(out, header, 0);
+	set_bounds(out, header, header.subMesh_bounds ? (MeshBounds*) (data + header.subMesh_bounds) : 0);
+
+	u16 format = out.vertex_format;
+	if (format & MESH_INTERLEAVED) {
+		out.vertex_data		= data + offset;
+		out.vertex_stride	= header.vertex_stride;
+		memcpy(out.vertex_offsets, header.vertex_offsets, sizeof(out.vertex_offsets));
+		offset += file.positions;
+	}
+	else {
+		if (format & MESH_POSITION_S16)
+			out.q_vertices	= (s16*) (data + offset);
+		else
+			out.vertices	= (Vec3*) (data + offset);
+		offset += file.positions;
+
+		if (format & MESH_NORMAL_S8)
+			out.q_normals	= (s8*) (data + offset);
+		else
+			out.normals		= (Vec3*) (data + offset);
+		offset += file.normals;
+
+		if (format & MESH_TEXCOORD_S16)
+			out.q_texcoord	= (s16*) (data + offset);
+		else
+			out.texcoord	= (Vec2*) (data + offset);
+		offset += file.texcoord;
+	}
+
+	out.subMeshes	= (SubMesh*) (data + offset);	offset += size_subMeshes;
+	if (format & MESH_POSITION_S16)
+		out.quant	= (PositionQuant*) (data + offset);
+	offset += file.quant;
+	out.indices		= data + offset;
+
+	// the meshlets follow the last level of detail
+	if (header.n_meshlets) {
+		size_t sizes[3];
+		meshlet_sizes(header, sizes);
+		offset += size_indices;
+		for (u32 l = 1; l < header.n_lods; l++)
+			offset += size_subMeshes + header.lod_indices_size[l];
+		if (size < offset + sizes[0] + sizes[1] + sizes[2]) {
+			printf("mesh_map: '%s' is truncated\n", filename);
+			mesh_release(out);
+			return false;
+		}
+		out.n_meshlets			= header.n_meshlets;
+		out.meshlets			= (Meshlet*) (data + offset);
+		out.meshlet_vertices	= (u32*) (data + offset + sizes[0]);
+		out.meshlet_triangles	= data + offset + sizes[0] + sizes[1];
+	}
+
+	if (header.swap)
+		swap_submeshes(out);
+
+	if (!check_submeshes(out)) {
+		printf("mesh_map: '%s' has invalid submeshes\n", filename);
+		mesh_release(out);
+		return false;
+	}
+
+	if (out.n_meshlets && header.swap)
+		swap_meshlets(out, header);
+	if (!check_meshlets(out, header)) {
+		printf("mesh_map: '%s' has invalid meshlets\n", filename);
+		mesh_release(out);
+		return false;
+	}
+
+	// on little-endian hosts this touches (and copies) every page of the mapping
+	if (header.swap) {
+		swap_arrays(out);
+		swap_indices(out);
+	}
+
+	return true;
+}
+
+bool mesh_map(const char* filename, Mesh& out) {
+	mesh_release(out);
+
+	size_t size = 0;
+	uint8_t* data = (uint8_t*) map_file(filename, size);
+	if (!data) {
+		printf("mesh_map: can't map '%s'\n", filename);
+		return false;
+	}
+
+	if (!view_mesh(data, size, filename, out, false, true)) {
+		unmap_file(data, size);
+		return false;
+	}
+	out.mapping		= data;
+	out.mappingSize = size;
+	return true;
+}
+
+bool mesh_view(void* data, size_t size, const char* name, Mesh& out, bool swapped) {
+	mesh_release(out);
+	return view_mesh((uint8_t*) data, size, name, out, swapped, false);
+}
+
+void mesh_release(Mesh& mesh) {
+	// a block dropped by a reset of its allocator may belong to another mesh
+	if (mesh.block && mesh.allocator->generation() == mesh.generation)
+		mesh.allocator->release(mesh.block);
+
+	if (mesh.mapping)
+		unmap_file(mesh.mapping, mesh.mappingSize);
+
+	mesh.n_vertices		= 0;
+	mesh.n_tris			= 0;
+	mesh.n_texcoord		= 0;
+	mesh.n_normals		= 0;
+	mesh.n_subMeshes	= 0;
+
+	mesh.vertices	= 0;
+	mesh.indices	= 0;
+	mesh.indices_size	= 0;
+	mesh.texcoord	= 0;
+	mesh.normals	= 0;
+	mesh.subMeshes	= 0;
+
+	mesh.vertex_format	= 0;
+	mesh.q_vertices		= 0;
+	mesh.q_normals		= 0;
+	mesh.q_texcoord		= 0;
+	mesh.quant			= 0;
+
+	mesh.vertex_data	= 0;
+	mesh.vertex_stride	= 0;
+	memset(mesh.vertex_offsets, 0, sizeof(mesh.vertex_offsets));
+
+	mesh.lod		= 0;
+	mesh.n_lods		= 0;
+	memset(mesh.lod_errors, 0, sizeof(mesh.lod_errors));
+
+	mesh.bounds			= MeshBounds();
+	mesh.subMesh_bounds	= 0;
+
+	mesh.n_meshlets			= 0;
+	mesh.meshlets			= 0;
+	mesh.meshlet_vertices	= 0;
+	mesh.meshlet_triangles	= 0;
+
+	mesh.block			= 0;
+	mesh.allocator		= 0;
+	mesh.generation		= 0;
+	mesh.mapping		= 0;
+	mesh.mappingSize	= 0;
+}
+
+MeshPool::MeshPool(size_t capacity) {
+	base = (uint8_t*) g_heap_allocator.alloc(capacity, MESH_ALIGNMENT);
+	this->capacity = base ? capacity : 0;
+	top = 0;
+	last = 0;
+	n_live = 0;
+	n_resets = 0;
+}
+
+MeshPool::~MeshPool() {
+	if (n_live)
+		printf("MeshPool: destroyed with %d live blocks\n", n_live);
+	g_heap_allocator.release(base);
+}
+
+void* MeshPool::alloc(size_t size, size_t alignment) {
+	size_t start = (top + alignment - 1) & ~(alignment - 1);
+	if (start + size > capacity)
+		return 0;
+
+	last = start;
+	top = start + size;
+	n_live++;
+	return base + start;
+}
+
+void MeshPool::release(void* ptr) {
+	if (!ptr)
+		return;
+
+	// the most recent block can be given back right away,
+	// the rest is reclaimed once every block is released
+	if (base + last == ptr)
+		top = last;
+
+	if (--n_live == 0)
+		reset();
+}
+
+void MeshPool::reset() {
+	top = 0;
+	last = 0;
+	n_live = 0;
+	n_resets++;
 }
@@ -0,0 +1,75 @@
+#ifndef _MESH_READER_H_
+#define _MESH_READER_H_
+
+#include "Mesh.h"
+
+// copy the contents of a .m file into a single block from allocator (aligned
+// heap memory by default), each array aligned to MESH_ALIGNMENT. the arrays
+// are swapped if the file byte order isn't the host's. files of every version
+// are read, the 16-bit indices of versions 0 and 1 as 2-byte submeshes. the
+// primitive of each submesh (list or strips) is in SubMesh::primitive.
+// quantized arrays are dequantized to f32, or kept as they are in the file
+// with keep_quantized (see Mesh::vertex_format). interleaved vertices stay
+// interleaved, as f32 records once dequantized (see Mesh::view). encoded
+// vertex and index data (MESH_ENCODED) is decoded while reading, compressed
+// sections (MESH_COMPRESSED) decompressed on worker threads as they are read.
+// only the triangles of level of detail lod are read (the coarsest one if
+// the file has fewer), see Mesh::lod. the meshlets come with level 0 only
+bool mesh_read(const char* filename, Mesh& out, MeshAllocator* allocator = 0, bool keep_quantized = false, u32 lod = 0);
+
+// mesh_read from the size bytes of a .m file already in memory (name is for
+// the messages), on the calling thread only. data can be released after
+bool mesh_read_memory(const void* data, size_t size, const char* name, Mesh& out, MeshAllocator* allocator = 0, bool keep_quantized = false, u32 lod = 0);
+
+// map a .m file in memory, the arrays of out point straight into the mapping
+// (swapped in place if the file byte order isn't the host's), quantized
+// arrays stay quantized and interleaved ones interleaved. returns false if
+// the file can't be mapped (ie. a version 0 or 1 file written by an older
+// converter, or an encoded or compressed file), in that case use mesh_read.
+bool mesh_map(const char* filename, Mesh& out);
+
+// mesh_map on the size bytes of a .m file already in writable memory (ie. an
+// entry of a pack, see MeshPack.h), which must outlive out. the arrays are
+// swapped in place unless swapped says an earlier view of the same bytes did.
+// returns false without a message for the files mesh_read_memory has to read
+bool mesh_view(void* data, size_t size, const char* name, Mesh& out, bool swapped = false);
+
+// map a whole file copy-on-write, 0 if it can't be mapped or is empty
+void* map_file(const char* filename, size_t& size);
+void unmap_file(void* data, size_t size);
+
+// release a mesh loaded with mesh_read or mesh_map (also done by ~Mesh)
+void mesh_release(Mesh& mesh);
+
+// linear pool for meshes sharing a lifetime (ie. the meshes of a level).
+// released blocks are reclaimed when all of them are released (or reset)
+class MeshPool : public MeshAllocator {
+public:
+	MeshPool(size_t capacity);
+	~MeshPool();
+
+	void* alloc(size_t size, size_t alignment);
+	void release(void* ptr);
+
+	// drop every block at once, the meshes using them must not be used
+	// anymore. releasing them later (ie. in ~Mesh) does nothing
+	void reset();
+
+	// the number of resets, the blocks released must come from the last one
+	u32 generation() const { return n_resets; }
+
+	size_t used() const { return top; }
+
+private:
+	uint8_t* base;
+	size_t capacity;
+	size_t top;		// end of the last block
+	size_t last;	// start of the last block
+	int n_live;
+	u32 n_resets;
+
+	MeshPool(const MeshPool&);
+	MeshPool& operator=(const MeshPool&);
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _PACK_FORMAT_H_
+#define _PACK_FORMAT_H_
+
+// constants of the .pak layout shared by the converter and the reader,
+// see PackFile_desc.txt
+
+#define PACK_MAGIC			"WPAK"
+#define PACK_BOM			0xFEFF		// written in the byte order of the file
+#define PACK_VERSION		1
+#define PACK_HEADER_SIZE	32			// magic, bom, version, counts and file size
+#define PACK_ENTRY_SIZE		32			// an entry of the table of contents, see PackEntry
+#define PACK_ALIGNMENT		32			// of the data of each entry (MESH_ALIGNMENT)
+#define PACK_NO_ENTRY		0			// an empty slot of the hash table
+
+// kind of an entry, from the extension of its name
+#define PACK_OTHER			0
+#define PACK_MESH			1			// .m
+#define PACK_MATERIAL		2			// .mat
+#define PACK_TEXTURE		3			// the textures of the .mat files
+
+#endif
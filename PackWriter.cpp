@@ -0,0 +1,242 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <unordered_set>
+
+#include "PackWriter.h"
+#include "PackFormat.h"
+#include "Hash.h"
+
+using namespace std;
+
+// a file going in the pack
+struct PackInput {
+	std::string name;	// in the table of contents
+	std::string path;
+	uint16_t kind;
+	uint64_t size;
+	uint64_t offset;
+	uint32_t name_offset;
+};
+
+// the name of an entry, with '/' separators
+static std::string PackName(const std::string& path) {
+	std::string name = path;
+	for (size_t i = 0; i < name.size(); i++) {
+		if (name[i] == '\\')
+			name[i] = '/';
+	}
+	return name;
+}
+
+static uint16_t PackKind(const std::string& name, bool texture) {
+	size_t n = name.size();
+	if (n > 2 && name.compare(n - 2, 2, ".m") == 0)
+		return PACK_MESH;
+	if (n > 4 && name.compare(n - 4, 4, ".mat") == 0)
+		return PACK_MATERIAL;
+	return texture ? PACK_TEXTURE : PACK_OTHER;
+}
+
+static bool FileSize(const std::string& path, uint64_t& size) {
+	ifstream input(path.c_str(), ios::in | ios::binary);
+	if (!input)
+		return false;
+
+	input.seekg(0, ios::end);
+	streamoff end = input.tellg();
+	if (!input || end < 0)
+		return false;
+	size = (uint64_t) end;
+	return true;
+}
+
+static bool ReadFile(const std::string& path, std::vector<uint8_t>& data) {
+	ifstream input(path.c_str(), ios::in | ios::binary);
+	if (!input)
+		return false;
+
+	input.seekg(0, ios::end);
+	streamoff size = input.tellg();
+	input.seekg(0, ios::beg);
+	if (!input || size < 0)
+		return false;
+
+	data.resize((size_t) size);
+	if (size > 0)
+		input.read((char*) data.data(), data.size());
+	return !!input;
+}
+
+// the diffuse textures of a .mat file (see MatFile_desc.txt). the materials
+// without one have no record, so there are at most n_subMat of them
+static void MaterialTextures(const std::vector<uint8_t>& mat, std::vector<std::string>& textures) {
+	if (mat.size() < 2)
+		return;
+
+	size_t offset = 2 + mat[0];
+	for (int i = 0; i < mat[1] && offset < mat.size(); i++) {
+		size_t size = mat[offset++];
+		if (size == 0 || offset + size > mat.size())
+			return;
+		textures.push_back(std::string((const char*) &mat[offset], strnlen((const char*) &mat[offset], size)));
+		offset += size;
+	}
+}
+
+// size bytes of value in the byte order of the pack
+static void Put(std::vector<uint8_t>& out, uint64_t value, int size, bool big_endian) {
+	for (int i = 0; i < size; i++) {
+		int shift = 8 * (big_endian ? size - 1 - i : i);
+		out.push_back((uint8_t) (value >> shift));
+	}
+}
+
+static uint64_t Align(uint64_t offset) {
+	return (offset + PACK_ALIGNMENT - 1) & ~(uint64_t) (PACK_ALIGNMENT - 1);
+}
+
+bool WritePack(const std::string& filename, const std::vector<std::string>& meshes, bool big_endian) {
+	std::vector<PackInput> inputs;
+	std::unordered_set<std::string> names;
+	int n_kinds[4] = {0, 0, 0, 0};
+
+	// each mesh, its material and its textures together, so the pack reads
+	// in the order of the meshes. shared textures are stored once, and a
+	// missing one is reported once. the files are only read to write them
+	auto add = [&](const std::string& path, const std::string& name, bool texture) {
+		PackInput input;
+		input.name = PackName(name);
+		if (names.count(input.name))
+			return true;
+		input.path = path;
+		input.kind = PackKind(input.name, texture);
+		names.insert(input.name);
+		if (!FileSize(path, input.size)) {
+			if (texture) {
+				printf("warning: texture '%s' not found, left out of the pack\n", path.c_str());
+				return true;
+			}
+			printf("Error reading '%s' for the pack\n", path.c_str());
+			return false;
+		}
+		n_kinds[input.kind]++;
+		inputs.push_back(input);
+		return true;
+	};
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const std::string& mesh = meshes[i];
+		if (!add(mesh + ".m", mesh + ".m", false) || !add(mesh + ".mat", mesh + ".mat", false))
+			return false;
+
+		std::vector<uint8_t> mat;
+		std::vector<std::string> textures;
+		if (ReadFile(mesh + ".mat", mat))
+			MaterialTextures(mat, textures);
+
+		size_t slash = mesh.find_last_of("/\\");
+		std::string dir = slash == std::string::npos ? "" : mesh.substr(0, slash + 1);
+		for (size_t t = 0; t < textures.size(); t++) {
+			const std::string& texture = textures[t];
+			bool absolute = !texture.empty() && (texture[0] == '/' || texture[0] == '\\' || texture.find(':') != std::string::npos);
+			std::string path = absolute ? texture : dir + texture;
+			if (!add(path, path, true))
+				return false;
+		}
+	}
+
+	// the hash table of the names, at most half full. each slot has the
+	// index of its entry + 1, the names that collide go to the next slots.
+	// 2 slots at least keep the entries 8-byte aligned
+	uint32_t n_entries = (uint32_t) inputs.size();
+	uint32_t n_slots = 2;
+	while (n_slots < 2 * n_entries)
+		n_slots *= 2;
+	std::vector<uint32_t> slots(n_slots, PACK_NO_ENTRY);
+	std::vector<uint64_t> hashes(n_entries);
+	for (uint32_t e = 0; e < n_entries; e++) {
+		hashes[e] = hash64(inputs[e].name.data(), inputs[e].name.size());
+		uint32_t slot = (uint32_t) hashes[e] & (n_slots - 1);
+		while (slots[slot] != PACK_NO_ENTRY)
+			slot = (slot + 1) & (n_slots - 1);
+		slots[slot] = e + 1;
+	}
+
+	uint32_t names_size = 0;
+	for (uint32_t e = 0; e < n_entries; e++) {
+		inputs[e].name_offset = names_size;
+		names_size += (uint32_t) inputs[e].name.size() + 1;
+	}
+
+	// the data of each entry aligned after the names
+	uint64_t offset = PACK_HEADER_SIZE + 4 * (uint64_t) n_slots + PACK_ENTRY_SIZE * (uint64_t) n_entries + names_size;
+	for (uint32_t e = 0; e < n_entries; e++) {
+		offset = Align(offset);
+		inputs[e].offset = offset;
+		offset += inputs[e].size;
+	}
+	uint64_t file_size = offset;
+
+	std::vector<uint8_t> toc;
+	toc.insert(toc.end(), PACK_MAGIC, PACK_MAGIC + 4);
+	Put(toc, PACK_BOM, 2, big_endian);
+	Put(toc, PACK_VERSION, 2, big_endian);
+	Put(toc, n_entries, 4, big_endian);
+	Put(toc, n_slots, 4, big_endian);
+	Put(toc, names_size, 4, big_endian);
+	Put(toc, 0, 4, big_endian);
+	Put(toc, file_size, 8, big_endian);
+
+	for (uint32_t s = 0; s < n_slots; s++)
+		Put(toc, slots[s], 4, big_endian);
+
+	for (uint32_t e = 0; e < n_entries; e++) {
+		const PackInput& input = inputs[e];
+		Put(toc, hashes[e], 8, big_endian);
+		Put(toc, input.offset, 8, big_endian);
+		Put(toc, input.size, 8, big_endian);
+		Put(toc, input.name_offset, 4, big_endian);
+		Put(toc, input.name.size(), 2, big_endian);
+		Put(toc, input.kind, 2, big_endian);
+	}
+
+	for (uint32_t e = 0; e < n_entries; e++)
+		toc.insert(toc.end(), inputs[e].name.c_str(), inputs[e].name.c_str() + inputs[e].name.size() + 1);
+
+	ofstream output(filename.c_str(), ios::out | ios::binary);
+	if (!output) {
+		printf("Error writing '%s'\n", filename.c_str());
+		return false;
+	}
+
+	static const char padding[PACK_ALIGNMENT] = {0};
+	output.write((const char*) toc.data(), toc.size());
+	uint64_t position = toc.size();
+	std::vector<uint8_t> data;
+	bool ok = true;
+	for (uint32_t e = 0; e < n_entries; e++) {
+		const PackInput& input = inputs[e];
+		if (!ReadFile(input.path, data) || data.size() != input.size) {
+			printf("Error reading '%s' for the pack\n", input.path.c_str());
+			ok = false;
+			break;
+		}
+		output.write(padding, (streamsize) (input.offset - position));
+		output.write((const char*) data.data(), data.size());
+		position = input.offset + input.size;
+	}
+
+	ok = ok && output.good();
+	output.close();
+	if (!ok) {
+		printf("Error writing '%s'\n", filename.c_str());
+		return false;
+	}
+
+	printf("%s: %d meshes, %d materials, %d textures, %.2f MB\n", filename.c_str(),
+		n_kinds[PACK_MESH], n_kinds[PACK_MATERIAL], n_kinds[PACK_TEXTURE], file_size / (1024.0 * 1024.0));
+	return true;
+}
@@ -0,0 +1,15 @@
+#ifndef _PACK_WRITER_H_
+#define _PACK_WRITER_H_
+
+#include <string>
+#include <vector>
+
+// bundle the .m and .mat files of the meshes (names without extension, as the
+// converter takes them) and the textures of their materials in the .pak file
+// filename (see PackFile_desc.txt), in the byte order given by big_endian.
+// the entries are named as the meshes with their extension, the textures by
+// their path next to the mesh, with '/' separators. a missing .m or .mat
+// fails, a missing texture is left out with a warning
+bool WritePack(const std::string& filename, const std::vector<std::string>& meshes, bool big_endian);
+
+#endif
@@ -0,0 +1,107 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+int ThreadPool::hardware_threads() {
+	int n = (int) thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+ThreadPool::ThreadPool(int n_workers) {
+	if (n_workers <= 0)
+		n_workers = hardware_threads();
+
+	next = 0;
+	pending = 0;
+	stop = false;
+
+	for (int i = 0; i < n_workers; i++)
+		queues.push_back(new Queue);
+
+	for (int i = 0; i < n_workers; i++)
+		workers.push_back(thread(&ThreadPool::run, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		unique_lock<mutex> guard(lock);
+		stop = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	for (size_t i = 0; i < queues.size(); i++)
+		delete queues[i];
+}
+
+void ThreadPool::push(const Task& task) {
+	{
+		unique_lock<mutex> guard(lock);
+		pending++;
+
+		Queue* queue = queues[next];
+		next = (next + 1) % queues.size();
+
+		unique_lock<mutex> queue_guard(queue->lock);
+		queue->tasks.push_back(task);
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::wait() {
+	unique_lock<mutex> guard(lock);
+	while (pending > 0)
+		done.wait(guard);
+}
+
+// take a task from the front of our queue, or steal one from the back of another
+bool ThreadPool::pop(int worker, Task& task) {
+	int n = (int) queues.size();
+	for (int i = 0; i < n; i++) {
+		Queue* queue = queues[(worker + i) % n];
+		unique_lock<mutex> guard(queue->lock);
+		if (queue->tasks.empty())
+			continue;
+
+		if (i == 0) {
+			task = queue->tasks.front();
+			queue->tasks.pop_front();
+		}
+		else {
+			task = queue->tasks.back();
+			queue->tasks.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::run(int worker) {
+	for (;;) {
+		Task task;
+		if (pop(worker, task)) {
+			task(worker);
+
+			unique_lock<mutex> guard(lock);
+			if (--pending == 0)
+				done.notify_all();
+			continue;
+		}
+
+		unique_lock<mutex> guard(lock);
+		if (stop)
+			return;
+
+		// pending counts the tasks still queued or running, sleep only
+		// if they're all being run by other workers
+		int queued = 0;
+		for (size_t i = 0; i < queues.size(); i++) {
+			unique_lock<mutex> queue_guard(queues[i]->lock);
+			queued += (int) queues[i]->tasks.size();
+		}
+		if (queued == 0)
+			wake.wait(guard);
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// fixed set of worker threads, each one with its own task queue. tasks are
+// spread round robin and an idle worker steals from the back of the others.
+// a task gets the index of the worker running it, to use per worker state
+class ThreadPool {
+public:
+	typedef std::function<void(int worker)> Task;
+
+	// n_workers = 0 uses one worker per hardware thread
+	ThreadPool(int n_workers = 0);
+	~ThreadPool();
+
+	void push(const Task& task);
+
+	// block until every pushed task is done
+	void wait();
+
+	int size() const { return (int) workers.size(); }
+
+	static int hardware_threads();
+
+private:
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	bool pop(int worker, Task& task);
+	void run(int worker);
+
+	std::vector<std::thread> workers;
+	std::vector<Queue*> queues;
+	int next;
+
+	std::mutex lock;
+	std::condition_variable wake;	// new tasks or stop
+	std::condition_variable done;	// pending dropped to 0
+	int pending;
+	bool stop;
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
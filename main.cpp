@@ -1,12 +1,363 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
 
-#include "Mesh.h"
+#include "MeshReader.h"
+#include "MeshAsync.h"
+#include "MeshPack.h"
+#include "MeshCull.h"
 
-void mesh_read(const char* filename, Mesh& out);
+// time to read each file with mesh_read, best of a few runs, to compare the
+// same mesh converted with and without --compress
+static int bench_read(int argc, char **argv) {
+	for (int i = 2; i < argc; i++) {
+		const int n_runs = 5;
+		double best = 1e30;
+		bool ok = true;
+		for (int r = 0; r < n_runs && ok; r++) {
+			Mesh mesh;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			ok = mesh_read(argv[i], mesh);
+			double t = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			if (t < best)
+				best = t;
+			mesh_release(mesh);
+		}
+
+		if (ok)
+			printf("%s: read in %.2f ms\n", argv[i], best * 1e3);
+		else
+			printf("%s: can't read\n", argv[i]);
+	}
+	return 0;
+}
+
+// view projection matrix of a camera at eye looking at target (y up, 60
+// degrees vertical field of view, square viewport), row-major for column vectors
+static void look_at(const f32 eye[3], const f32 target[3], f32 z_near, f32 z_far, f32 view_proj[16]) {
+	f32 f[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+	f32 length = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+	for (int k = 0; k < 3; k++)
+		f[k] /= length;
+	f32 up[3] = {0, 1, 0};
+	if (fabsf(f[1]) > 0.99f) {
+		up[1] = 0;
+		up[2] = 1;
+	}
+	f32 r[3] = {f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0]};
+	length = sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+	for (int k = 0; k < 3; k++)
+		r[k] /= length;
+	f32 u[3] = {r[1] * f[2] - r[2] * f[1], r[2] * f[0] - r[0] * f[2], r[0] * f[1] - r[1] * f[0]};
+
+	f32 view[4][4] = {
+		{r[0], r[1], r[2], -(r[0] * eye[0] + r[1] * eye[1] + r[2] * eye[2])},
+		{u[0], u[1], u[2], -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2])},
+		{-f[0], -f[1], -f[2], f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2]},
+		{0, 0, 0, 1}
+	};
+	f32 s = 1.0f / tanf(0.5f * 60.0f * 3.14159265f / 180.0f);
+	f32 proj[4][4] = {
+		{s, 0, 0, 0},
+		{0, s, 0, 0},
+		{0, 0, (z_far + z_near) / (z_near - z_far), 2 * z_far * z_near / (z_near - z_far)},
+		{0, 0, -1, 0}
+	};
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			view_proj[4 * i + j] = 0;
+			for (int k = 0; k < 4; k++)
+				view_proj[4 * i + j] += proj[i][k] * view[k][j];
+		}
+	}
+}
+
+// triangles rejected by culling the submeshes (their bounds), the meshlets
+// out of the frustum, and the meshlets out of it or facing away, for two
+// camera paths around the bounds of each mesh: an orbit looking at the
+// mesh from outside, and a walk inside it looking ahead (an environment)
+static int bench_cull(int argc, char **argv) {
+	for (int i = 2; i < argc; i++) {
+		Mesh mesh;
+		if (!mesh_read(argv[i], mesh))
+			continue;
+		if (!mesh.subMesh_bounds || !mesh.n_meshlets) {
+			printf("%s: no bounds or meshlets, convert it with --meshlets\n", argv[i]);
+			continue;
+		}
+
+		std::vector<u32> visible(mesh.n_meshlets);
+
+		// the triangles of each submesh, as the meshlets count them whatever
+		// the primitive of the submesh
+		std::vector<double> subMesh_tris(mesh.n_subMeshes, 0.0);
+		double n_tris = 0;
+		for (u32 m = 0; m < mesh.n_meshlets; m++) {
+			subMesh_tris[mesh.meshlets[m].subMesh] += mesh.meshlets[m].triangle_count;
+			n_tris += mesh.meshlets[m].triangle_count;
+		}
+
+		const f32* center = mesh.bounds.center;
+		f32 radius = mesh.bounds.radius;
+		const char* paths[2] = {"orbit", "walk"};
+		for (int path = 0; path < 2; path++) {
+			const int n_frames = 360;
+			double subMeshes = 0, frustum = 0, cone = 0, seconds = 0;
+			for (int frame = 0; frame < n_frames; frame++) {
+				f32 angle = 2 * 3.14159265f * frame / n_frames;
+				f32 eye[3], target[3];
+				if (path == 0) {
+					f32 distance = 1.5f * radius;
+					eye[0] = center[0] + distance * cosf(angle);
+					eye[1] = center[1] + 0.3f * distance;
+					eye[2] = center[2] + distance * sinf(angle);
+					target[0] = center[0];
+					target[1] = center[1];
+					target[2] = center[2];
+				}
+				else {
+					f32 distance = 0.5f * radius;
+					eye[0] = center[0] + distance * cosf(angle);
+					eye[1] = center[1];
+					eye[2] = center[2] + distance * sinf(angle);
+					target[0] = eye[0] - sinf(angle);
+					target[1] = eye[1];
+					target[2] = eye[2] + cosf(angle);
+				}
+
+				f32 view_proj[16], planes[6][4];
+				look_at(eye, target, 0.01f * radius, 4 * radius, view_proj);
+				frustum_planes(view_proj, planes);
+
+				for (u32 s = 0; s < mesh.n_subMeshes; s++) {
+					const MeshBounds& b = mesh.subMesh_bounds[s];
+					if (sphere_culled(b.center, b.radius, planes))
+						subMeshes += subMesh_tris[s];
+				}
+				for (u32 m = 0; m < mesh.n_meshlets; m++) {
+					const Meshlet& meshlet = mesh.meshlets[m];
+					if (sphere_culled(meshlet.center, meshlet.radius, planes))
+						frustum += meshlet.triangle_count;
+				}
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				u32 n_visible = mesh_cull_meshlets(mesh, eye, planes, visible.data());
+				seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+				cone += n_tris;
+				for (u32 v = 0; v < n_visible; v++)
+					cone -= mesh.meshlets[visible[v]].triangle_count;
+			}
+
+			double frame_tris = n_tris * n_frames;
+			printf("%s, %s: %u meshlets, triangles culled: submeshes %.1f%%, meshlet frustum %.1f%%, meshlet frustum and cone %.1f%% (%.1f us per frame)\n",
+				argv[i], paths[path], mesh.n_meshlets, 100 * subMeshes / frame_tris, 100 * frustum / frame_tris, 100 * cone / frame_tris,
+				seconds * 1e6 / n_frames);
+		}
+	}
+	return 0;
+}
+
+// the p-th fraction of times (sorted in place), 0 if none
+static double percentile(std::vector<double>& times, double p) {
+	if (times.empty())
+		return 0;
+	std::sort(times.begin(), times.end());
+	return times[std::min(times.size() - 1, (size_t) (p * (times.size() - 1) + 0.5))];
+}
+
+// load copies of the files (at least 256 meshes) with mesh_read one after
+// the other, then all at once with mesh_prefetch, a quarter of them urgent
+// and the last few made more urgent still after the prefetch (a turn of the
+// camera). reports the throughput of both and the latency of the requests
+// from the prefetch to mesh_wait_any, urgent ones and the others
+static int bench_async(int argc, char **argv) {
+	typedef std::chrono::high_resolution_clock clock;
+	int n_files = argc - 2;
+	if (n_files <= 0) {
+		printf("--bench-async file.m...\n");
+		return 1;
+	}
+	int n_meshes = (255 / n_files + 1) * n_files;
+
+	double file_bytes = 0;
+	for (int i = 0; i < n_meshes; i++) {
+		FILE* file = fopen(argv[2 + i % n_files], "rb");
+		if (!file)
+			continue;
+		fseek(file, 0, SEEK_END);
+		file_bytes += ftell(file);
+		fclose(file);
+	}
+
+	clock::time_point start = clock::now();
+	{
+		std::vector<Mesh> meshes(n_meshes);
+		for (int i = 0; i < n_meshes; i++)
+			mesh_read(argv[2 + i % n_files], meshes[i]);
+	}
+	double serial = std::chrono::duration<double>(clock::now() - start).count();
+
+	std::vector<Mesh> meshes(n_meshes);
+	std::vector<MeshPrefetch> prefetch(n_meshes);
+	for (int i = 0; i < n_meshes; i++) {
+		MeshPrefetch mesh = {argv[2 + i % n_files], &meshes[i], i % 4 == 0 ? 1 : 0, false, 0};
+		prefetch[i] = mesh;
+	}
+	std::vector<MeshRequest> requests(n_meshes);
+	std::vector<double> urgent, others;
+	int n_failed = 0;
+	double submit, total;
+	int n_decoders;
+	{
+		MeshLoader loader;
+		n_decoders = loader.decoders();
+
+		start = clock::now();
+		mesh_prefetch(loader, prefetch.data(), n_meshes, requests.data());
+		for (int i = n_meshes - n_meshes / 16; i < n_meshes; i++) {
+			if (mesh_reprioritize(loader, requests[i], 2))
+				prefetch[i].priority = 2;
+		}
+		submit = std::chrono::duration<double>(clock::now() - start).count();
+
+		std::unordered_map<MeshRequest, int> index;
+		for (int i = 0; i < n_meshes; i++)
+			index[requests[i]] = i;
+
+		MeshRequest request;
+		MeshStatus status;
+		while ((request = mesh_wait_any(loader, &status)) != 0) {
+			double t = std::chrono::duration<double>(clock::now() - start).count();
+			if (status != MESH_LOADED) {
+				n_failed++;
+				continue;
+			}
+			if (prefetch[index[request]].priority > 0)
+				urgent.push_back(t);
+			else
+				others.push_back(t);
+		}
+		total = std::chrono::duration<double>(clock::now() - start).count();
+	}
+
+	printf("%d meshes of %d files, %.1f MB, %d decoders, %d failed\n", n_meshes, n_files, file_bytes / (1 << 20), n_decoders, n_failed);
+	printf("mesh_read:       %.1f ms, %.0f meshes/s, %.1f MB/s\n", serial * 1e3, n_meshes / serial, file_bytes / (1 << 20) / serial);
+	printf("mesh_read_async: %.1f ms, %.0f meshes/s, %.1f MB/s (%.2f ms to queue them)\n", total * 1e3, n_meshes / total,
+		file_bytes / (1 << 20) / total, submit * 1e3);
+	printf("latency of %d urgent: p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", (int) urgent.size(),
+		percentile(urgent, 0.5) * 1e3, percentile(urgent, 0.99) * 1e3, percentile(urgent, 1) * 1e3);
+	printf("latency of %d others: p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", (int) others.size(),
+		percentile(others, 0.5) * 1e3, percentile(others, 0.99) * 1e3, percentile(others, 1) * 1e3);
+	return 0;
+}
+
+// every mesh of each pack with pack_mesh, the pack opened again each run,
+// against mesh_map (or mesh_read when it can't) of the same meshes as the
+// loose files the converter left next to it, best of a few runs
+static int bench_pack(int argc, char **argv) {
+	typedef std::chrono::high_resolution_clock clock;
+	for (int i = 2; i < argc; i++) {
+		std::vector<std::string> names;
+		{
+			MeshPack pack;
+			if (!pack_open(argv[i], pack))
+				continue;
+			for (u32 e = 0; e < pack.n_entries; e++) {
+				if (pack.entries[e].kind == PACK_MESH)
+					names.push_back(pack_name(pack, pack.entries[e]));
+			}
+		}
+
+		const int n_runs = 5;
+		double best_pack = 1e30, best_loose = 1e30;
+		int n_failed = 0;
+		for (int r = 0; r < n_runs; r++) {
+			clock::time_point start = clock::now();
+			{
+				MeshPack pack;
+				pack_open(argv[i], pack);
+				for (size_t m = 0; m < names.size(); m++) {
+					Mesh mesh;
+					pack_mesh(pack, names[m].c_str(), mesh);
+				}
+			}
+			best_pack = std::min(best_pack, std::chrono::duration<double>(clock::now() - start).count());
+
+			start = clock::now();
+			n_failed = 0;
+			for (size_t m = 0; m < names.size(); m++) {
+				Mesh mesh;
+				if (!mesh_map(names[m].c_str(), mesh) && !mesh_read(names[m].c_str(), mesh))
+					n_failed++;
+			}
+			best_loose = std::min(best_loose, std::chrono::duration<double>(clock::now() - start).count());
+		}
+
+		printf("%s: %d meshes, pack_mesh %.2f ms, loose files %.2f ms", argv[i], (int) names.size(), best_pack * 1e3, best_loose * 1e3);
+		if (n_failed)
+			printf(" (%d loose files missing)", n_failed);
+		printf("\n");
+	}
+	return 0;
+}
+
+// meshes read from a MeshPool after a reset never share memory, even with
+// the meshes of before the reset released in between
+static int test_pool(int argc, char **argv) {
+	const char* filename = argc > 2 ? argv[2] : "box.m";
+	MeshPool pool(64 * 1024 * 1024);
+	Mesh* a = new Mesh;
+	Mesh* b = new Mesh;
+	Mesh c, d, e;
+	bool ok = mesh_read(filename, *a, &pool) && mesh_read(filename, *b, &pool);
+	pool.reset();
+	ok = ok && mesh_read(filename, c, &pool);
+	delete a;
+	ok = ok && mesh_read(filename, d, &pool);
+	delete b;
+	ok = ok && mesh_read(filename, e, &pool);
+	if (!ok) {
+		printf("%s: can't read into the pool\n", filename);
+		return 1;
+	}
+
+	// the blocks of the same file have the same size, one after the other
+	// in the pool they don't overlap
+	ok = c.block < d.block && d.block < e.block;
+	printf("MeshPool: %s, %u bytes used\n", ok ? "ok" : "meshes share a block after a reset", (unsigned) pool.used());
+
+	mesh_release(c);
+	mesh_release(d);
+	mesh_release(e);
+	return ok ? 0 : 1;
+}
 
 int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench-read") == 0)
+		return bench_read(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "--bench-cull") == 0)
+		return bench_cull(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "--bench-async") == 0)
+		return bench_async(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "--bench-pack") == 0)
+		return bench_pack(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "--test-pool") == 0)
+		return test_pool(argc, argv);
+
 	Mesh mesh;
-	mesh_read("box.m", mesh);
+	if (mesh_map("box.m", mesh) || mesh_read("box.m", mesh)) {
+		printf("n_vertex = %d\n",	 mesh.n_vertices);
+		printf("n_tris = %d\n",		 mesh.n_tris);
+		printf("n_subMeshes = %d\n", mesh.n_subMeshes);
+	}
+
+	mesh_release(mesh);
 
 	system("pause");
 
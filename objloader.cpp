@@ -22,148 +22,137 @@
     Compile with: clang++/c++ -o objloader objloader.cpp -O3 -Wall -std=c++0x
  */
 
-#ifdef _ENTER_
-
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
 #include <cstdio>
-#include <sstream>
+#include <cstring>
 #include <map>
 #include <cstdint>
+#include <cmath>
+#include <algorithm>
 
-#if defined(__APPLE__)
-#include <pthread.h>
-#include <tr1/memory>
-
-namespace std {
-    using std::tr1::shared_ptr;
-}
-#endif
-
-#if defined(__linux__)
-#include <pthread.h>
-#include <memory>
-#endif
+#include "objloader.h"
+#include "MeshData.h"
+#include "ThreadPool.h"
 
 #define MAX_LINE_LENGTH 10000
 
-template<typename T>
-class Vec2
-{
-public:
-    T x, y;
-    Vec2() : x(0), y(0) {}
-    Vec2(T xx, T yy) : x(xx), y(yy) {}
-};
-
-template<typename T>
-class Vec3
-{
-public:
-    T x, y, z;
-    Vec3() : x(0), y(0), z(0) {}
-    Vec3(T xx, T yy, T zz) : x(xx), y(yy), z(zz) {}
-    friend std::ostream & operator << (std::ostream &os, const Vec3<T> &v)
-    { os << v.x << ", " << v.y << ", " << v.z; return os; }
-};
+/*! size of the blocks the OBJ file is read in, a line can't be longer */
+#define BLOCK_SIZE (8 << 20)
 
-typedef Vec3<float> Vec3f;
-typedef Vec3<int> Vec3i;
-typedef Vec2<float> Vec2f;
+/*! size of the chunks parsed by each task of a parallel parse */
+#define CHUNK_SIZE (4 << 20)
 
 Vec3f getVec3(std::ifstream &ifs) { float x, y, z; ifs >> x >> y >> z; return Vec3f(x, y, z); }
 
-/*! returns the path of a file */
-std::string getFilePath(const std::string &filename)
+/*! size of an open file, which can be larger than a long */
+static uint64_t getFileSize(FILE *file)
 {
-    size_t pos = filename.find_last_of('/');
-    if (pos == std::string::npos) return filename;
-    return filename.substr(0, pos);
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    uint64_t size = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_SET);
+#else
+    fseeko(file, 0, SEEK_END);
+    uint64_t size = ftello(file);
+    fseeko(file, 0, SEEK_SET);
+#endif
+    return size;
 }
 
-/*! \struct Material
- *  \brief a simple structure to store material's properties
- */
-struct Material
+/*! returns the directory of a file, "." if the name has none */
+std::string getFilePath(const std::string &filename)
 {
-    Vec3f Ka, Kd, Ks;   /*! ambient, diffuse and specular rgb coefficients */
-    float d;            /*! transparency */
-    float Ns, Ni;       /*! specular exponent and index of refraction */
-	std::string name;
-
-	Material(std::string _name) : name(_name){};
-};
+    size_t pos = filename.find_last_of("/\\");
+    if (pos == std::string::npos) return ".";
+    return filename.substr(0, pos);
+}
 
-/*! \class TriangleMesh
- *  \brief a basic class to store a triangle mesh data
- */
-class TriangleMesh
-{
-public:
-    Vec3f *positions;   /*! position/vertex array */
-    Vec3f *normals;     /*! normal array (can be null) */
-    Vec2f *texcoords;   /*! texture coordinates (can be null) */
-    int numTriangles;   /*! number of triangles */
-    int *triangles;     /*! triangle index list */
-    int nPositions;   /*! number of vertices */
-    int nNormals;   /*! number of normals*/
-    int nTexCoord;   /*! number of texcoords*/
-    TriangleMesh() : positions(nullptr), normals(nullptr), texcoords(nullptr), triangles(nullptr) {}
-    ~TriangleMesh()
-    {
-        if (positions) delete [] positions;
-        if (normals) delete [] normals;
-        if (texcoords) delete [] texcoords;
-        if (triangles) delete [] triangles;
-    }
-};
+/*! Determine if character is a separator. */
+static inline bool isSep(const char c) {
+    return (c == ' ') || (c == '\t');
+}
 
-/*! \class Primitive
- *  \brief a basic class to store a primitive (defined by a mesh and a material)
- */
-struct Primitive
-{
-    Primitive(const std::shared_ptr<TriangleMesh> &m, const std::shared_ptr<Material> &mat) : 
-        mesh(m), material(mat) {}
-    const std::shared_ptr<TriangleMesh> mesh;   /*! the object's geometry */
-    const std::shared_ptr<Material> material;   /*! the object's material */
-};
+/*! Determine if character is a decimal digit. */
+static inline bool isDigit(const char c) {
+    return (unsigned)(c - '0') < 10;
+}
 
-/*! Three-index vertex, indexing start at 0, -1 means invalid vertex. */
-struct Vertex {
-    int v, vt, vn;
-    Vertex() {};
-    Vertex(int v) : v(v), vt(v), vn(v) {};
-    Vertex(int v, int vt, int vn) : v(v), vt(vt), vn(vn) {};
-};
+/*! Parse separator. */
+static inline const char* parseSep(const char*& token) {
+    const char* start = token;
+    while (isSep(token[0])) token++;
+    if (token == start) throw std::runtime_error("separator expected");
+    return token;
+}
 
-typedef std::tr1::shared_ptr<Primitive> PrimitiveSharedPtr;
-typedef std::tr1::shared_ptr<TriangleMesh> MeshSharedPtr;
+/*! Parse optional separator. */
+static inline const char* parseSepOpt(const char*& token) {
+    while (isSep(token[0])) token++;
+    return token;
+}
 
-// need to declare this operator if we want to use Vertex in a map
-static inline bool operator < ( const Vertex& a, const Vertex& b ) {
-    if (a.v  != b.v)  return a.v  < b.v;
-    if (a.vn != b.vn) return a.vn < b.vn;
-    if (a.vt != b.vt) return a.vt < b.vt;
-    return false;
+/*! Skip the rest of a token. */
+static inline void skipToken(const char*& token) {
+    while (token[0] && !isSep(token[0]) && token[0] != '/') token++;
 }
 
-/*! Parse separator. */
-static inline const char* parseSep(const char*& token) {
-    size_t sep = strspn(token, " \t");
-    if (!sep) throw std::runtime_error("separator expected");
-    return token+=sep;
+/*! exact powers of ten representable by a double */
+static const double exactPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*! Read int from a string (like atoi, without locale or errno). */
+static inline int getInt(const char*& token) {
+    bool negative = false;
+    if (token[0] == '-') { negative = true; token++; }
+    else if (token[0] == '+') token++;
+    int n = 0;
+    while (isDigit(token[0])) n = n * 10 + (*token++ - '0');
+    return negative ? -n : n;
 }
 
-/*! Read float from a string. */
+/*! Read float from a string. the digits are gathered in an integer and scaled
+    by an exact power of ten, which is exact for the few significant digits of
+    OBJ files. anything else (nan, inf, huge exponents) falls back to atof */
 static inline float getFloat(const char*& token) {
-    token += strspn(token, " \t");
-    float n = (float)atof(token);
-    token += strcspn(token, " \t\r");
-    return n;
+    parseSepOpt(token);
+    const char* start = token;
+
+    bool negative = false;
+    if (token[0] == '-') { negative = true; token++; }
+    else if (token[0] == '+') token++;
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool digits = false;
+    for (; isDigit(token[0]); token++, digits = true) {
+        if (mantissa < 100000000000000000ULL) mantissa = mantissa * 10 + (token[0] - '0');
+        else exponent++;
+    }
+    if (token[0] == '.') {
+        for (token++; isDigit(token[0]); token++, digits = true) {
+            if (mantissa < 100000000000000000ULL) { mantissa = mantissa * 10 + (token[0] - '0'); exponent--; }
+        }
+    }
+    if (digits && (token[0] == 'e' || token[0] == 'E')) {
+        const char* e = token + 1;
+        if (isDigit(e[0]) || ((e[0] == '-' || e[0] == '+') && isDigit(e[1]))) {
+            token = e;
+            exponent += getInt(token);
+        }
+    }
+
+    while (token[0] && !isSep(token[0])) token++;
+    if (!digits || mantissa > (1ULL << 53) || exponent < -22 || exponent > 22)
+        return (float)atof(start);
+
+    double value = exponent < 0 ? mantissa / exactPow10[-exponent] : mantissa * exactPow10[exponent];
+    return (float)(negative ? -value : value);
 }
 
 /*! Read Vec2f from a string. */
@@ -181,63 +170,56 @@ static inline Vec3f getVec3f(const char*& token) {
     return Vec3f(x, y, z);
 }
 
-/*! Parse optional separator. */
-static inline const char* parseSepOpt(const char*& token) {
-    return token+=strspn(token, " \t");
-}
-
-/*! Determine if character is a separator. */
-static inline bool isSep(const char c) {
-    return (c == ' ') || (c == '\t');
-}
-
-class ObjReader
+/*! Throw if the OBJ index i (from 1, negative from the end), fixed to index, isn't one
+    of the size elements so far. The indices of a chunk are checked once merged. */
+static inline void checkIndex(int i, int index, size_t size, bool deferred, const char* what)
 {
-public:
-    ObjReader(const char *filename);
-    Vertex getInt3(const char*& token);
-    int fix_v(int index) { return(index > 0 ? index - 1 : (index == 0 ? 0 : (int)v .size() + index)); }
-    int fix_vt(int index) { return(index > 0 ? index - 1 : (index == 0 ? 0 : (int)vt.size() + index)); }
-    int fix_vn(int index) { return(index > 0 ? index - 1 : (index == 0 ? 0 : (int)vn.size() + index)); }
-    std::vector<Vec3f> v, vn;
-    std::vector<Vec2f> vt;
-    std::vector<std::vector<Vertex> > curGroup;
-    std::map<std::string, std::shared_ptr<Material> > materials;
-    std::shared_ptr<Material> curMaterial;
-    void loadMTL(const std::string &mtlFilename);
-    void flushFaceGroup();
-    uint32_t getVertex(std::map<Vertex, uint32_t>&, std::vector<Vec3f>&, std::vector<Vec3f>&, std::vector<Vec2f>&, const Vertex&);
-    std::vector<std::shared_ptr<Primitive> > model;
-};
-
+    if (i == 0 || (!deferred && (index < 0 || (size_t)index >= size)))
+        throw std::runtime_error(std::string("OBJ: ") + what + " index out of range");
+}
 
 /*! Parse differently formated triplets like: n0, n0/n1/n2, n0//n2, n0/n1.          */
 /*! All indices are converted to C-style (from 0). Missing entries are assigned -1. */
+/*! Negative indices of a chunk are relative to its own vertices, they are recorded */
+/*! to be fixed once the vertices of the previous chunks are known.                 */
 Vertex ObjReader::getInt3(const char*& token)
 {
+    uint32_t pos = (uint32_t)curFaces.size() << 2;
     Vertex v(-1);
-    v.v = fix_v(atoi(token));
-    token += strcspn(token, "/ \t\r");
+    int i = getInt(token);
+    v.v = fix_v(i);
+    checkIndex(i, v.v, this->v.size(), deferred, "vertex");
+    if (i < 0 && deferred) relative.push_back(pos | 0);
+    skipToken(token);
     if (token[0] != '/') return(v);
     token++;
     
     // it is i//n
     if (token[0] == '/') {
         token++;
-        v.vn = fix_vn(atoi(token));
-        token += strcspn(token, " \t\r");
+        i = getInt(token);
+        v.vn = fix_vn(i);
+        checkIndex(i, v.vn, vn.size(), deferred, "vertex normal");
+        if (i < 0 && deferred) relative.push_back(pos | 2);
+        skipToken(token);
         return(v);
     }
     
     // it is i/t/n or i/t
-    v.vt = fix_vt(atoi(token));
-    token += strcspn(token, "/ \t\r");
+    i = getInt(token);
+    v.vt = fix_vt(i);
+    checkIndex(i, v.vt, vt.size(), deferred, "texture coordinate");
+    if (i < 0 && deferred) relative.push_back(pos | 1);
+    skipToken(token);
     if (token[0] != '/') return(v);
     token++;
     
     // it is i/t/n
-    v.vn = fix_vn(atoi(token));
-    token += strcspn(token, " \t\r");
+    i = getInt(token);
+    v.vn = fix_vn(i);
+    checkIndex(i, v.vn, vn.size(), deferred, "vertex normal");
+    if (i < 0 && deferred) relative.push_back(pos | 2);
+    skipToken(token);
     return(v);
 }
 
@@ -249,161 +231,501 @@ void ObjReader::loadMTL(const std::string &mtlFilename)
     std::ifstream ifs;
     ifs.open(mtlFilename.c_str());
     if (!ifs.is_open()) {
-        std::cerr << "can't open " << mtlFilename << std::endl;
+        warnings.push_back("OBJ: Unable to locate material file " + mtlFilename);
         return;
     }
     std::shared_ptr<Material> mat;
     while (ifs.peek() != EOF) {
         char line[MAX_LINE_LENGTH];
         ifs.getline(line, sizeof(line), '\n');
+        // trim the line end (\r of dos files)
+        char* end = line + strlen(line);
+        while (end > line && (isSep(end[-1]) || end[-1] == '\r')) *--end = 0;
         const char* token = line + strspn(line, " \t"); // ignore spaces and tabs
         if (token[0] == 0) continue; // ignore empty lines
         if (token[0] == '#') continue; // ignore comments
 
         if (!strncmp(token, "newmtl", 6)) {
             parseSep(token += 6);
-            std::string name(token); printf("Name of the material %s\n", name.c_str());
-            materials[name] = mat = std::shared_ptr<Material>(new Material (name));
+            std::string name(token);
+            mat = std::shared_ptr<Material>(new Material (name));
+            mat->index = nMaterials++;
+            materials[name] = mat;
             continue;
         }
 
         if (!mat) throw std::runtime_error("invalid material file: newmtl expected first");
         
-        if (!strncmp(token, "d", 1)) { parseSep(token += 1); mat->d = getFloat(token); continue; }
-        if (!strncmp(token, "Ns", 1)) { parseSep(token += 2); mat->Ns = getFloat(token); continue; }
-        if (!strncmp(token, "Ns", 1)) { parseSep(token += 2); mat->Ni = getFloat(token); continue; }
+        if (!strncmp(token, "d", 1) && isSep(token[1])) { parseSep(token += 1); mat->d = getFloat(token); continue; }
+        if (!strncmp(token, "Ns", 2)) { parseSep(token += 2); mat->Ns = getFloat(token); continue; }
+        if (!strncmp(token, "Ni", 2)) { parseSep(token += 2); mat->Ni = getFloat(token); continue; }
         if (!strncmp(token, "Ka", 2)) { parseSep(token += 2); mat->Ka = getVec3f(token); continue; }
         if (!strncmp(token, "Kd", 2)) { parseSep(token += 2); mat->Kd = getVec3f(token); continue; }
         if (!strncmp(token, "Ks", 2)) { parseSep(token += 2); mat->Ks = getVec3f(token); continue; }
+        // the texture is the last token, after the options (-s, -o, ...)
+        if (!strncmp(token, "map_Kd", 6)) {
+            parseSep(token += 6);
+            const char* name = strrchr(token, ' ');
+            const char* tab = strrchr(token, '\t');
+            if (tab > name) name = tab;
+            mat->map_Kd = name ? name + 1 : token;
+            continue;
+        }
     }
     ifs.close();
 }
 
 /*! \brief load the geometry defined in an OBJ/Wavefront file
  *  \param filename is the path to the OJB file
+ *  \param nThreads is the number of threads parsing the file
+ *
+ *  the file is read in large blocks and parsed in place, one line at a time
  */
-ObjReader::ObjReader(const char *filename)
+ObjReader::ObjReader(const char *filename, int nThreads) : nMaterials(0), deferred(false)
 {
-    std::ifstream ifs;
     // extract the path from the filename (used to read the material file)
-    std::string path = getFilePath(filename);
+    path = getFilePath(filename);
+    curFaceOffsets.push_back(0);
+
+    // create a default material
+    defaultMaterial = std::shared_ptr<Material>(new Material("Default"));
+    curMaterial = defaultMaterial;
+
+    FILE* file = fopen(filename, "rb");
     try {
-        ifs.open(filename);
-        if (ifs.fail()) throw std::runtime_error("can't open file " + std::string(filename));
+        if (!file) throw std::runtime_error("can't open file " + std::string(filename));
+
+        // a file of a single chunk isn't worth the threads
+        uint64_t fileSize = getFileSize(file);
+        if (nThreads != 1 && fileSize > CHUNK_SIZE) {
+            parseParallel(file, nThreads);
+            fclose(file);
+            return;
+        }
 
-        // create a default material
-        std::shared_ptr<Material> defaultMaterial(new Material("Default"));
-        curMaterial = defaultMaterial;
+        // a block larger than the file always holds a whole line
+        size_t blockSize = (size_t) std::min<uint64_t>(BLOCK_SIZE, fileSize + 1);
+        std::vector<char> block(blockSize + 1); // room for a terminating 0
+        size_t carry = 0; // bytes of an unfinished line at the start of the block
+        for (;;) {
+            size_t n = fread(&block[carry], 1, blockSize - carry, file);
+            char* line = &block[0];
+            char* end = line + carry + n;
+
+            // parse every complete line of the block
+            while (char* eol = (char*) memchr(line, '\n', end - line)) {
+                parseLine(line, eol);
+                line = eol + 1;
+            }
 
-        char line[MAX_LINE_LENGTH]; // line buffer
-        
-        while (ifs.peek() != EOF) // read each line until EOF is found
-        {
-            ifs.getline(line, sizeof(line), '\n');
-            const char* token = line + strspn(line, " \t"); // ignore space and tabs
-
-			//printf("strncmp(token, vt,  2) --> %d\n", strncmp(token, "vt",  2));
-            if (token[0] == 0) continue; // line is empty, ignore
-            // read a vertex
-            if (token[0] == 'v' && isSep(token[1])) { v.push_back(getVec3f(token += 2)); continue; }
-            // read a normal
-            if (!strncmp(token, "vn",  2) && isSep(token[2])) { vn.push_back(getVec3f(token += 3)); continue; }
-            // read a texture coordinates
-            if (!strncmp(token, "vt",  2) && isSep(token[2])) { vt.push_back(getVec2f(token += 3)); continue; }
-            //if (!strncmp(token, "vt",  2) && isSep(token[2])) { printf("vt: %.3f\n", getVec2f(token += 3).x); continue; }
-            // read a face
-            if (token[0] == 'f' && isSep(token[1])) {
-                parseSep(token += 1);
-                std::vector<Vertex> face;
-                while (token[0]) {
-                    face.push_back(getInt3(token));
-                    parseSepOpt(token);
+            carry = end - line;
+            if (n == 0) {
+                if (carry) parseLine(line, end); // last line without \n
+                break;
+            }
+            if (carry == blockSize) throw std::runtime_error("line too long");
+            memmove(&block[0], line, carry);
+        }
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        error = e.what();
+    }
+    flushFaceGroup(); // flush the last loaded object
+    if (file) fclose(file);
+}
+
+/*! \brief parse the lines of a chunk, stops at the first error
+ *  \param begin is the start of a line, end is past the last line of the chunk
+ *  (one more byte must be writable at end if the last line has no \n)
+ */
+void ObjReader::parseChunk(char *begin, char *end)
+{
+    curFaceOffsets.push_back(0);
+    try {
+        char* line = begin;
+        while (char* eol = (char*) memchr(line, '\n', end - line)) {
+            parseLine(line, eol);
+            line = eol + 1;
+        }
+        if (line < end) parseLine(line, end);
+    }
+    catch (const std::exception &e) {
+        error = e.what();
+    }
+}
+
+/*! \brief parse the file in blocks split in line aligned chunks, one task per chunk.
+ *  the next block is read while the chunks of the current one are parsed, the
+ *  chunks are merged in file order and the face groups are triangulated in
+ *  parallel once the whole file is merged
+ */
+void ObjReader::parseParallel(FILE *file, int nThreads)
+{
+    ThreadPool pool(nThreads);
+    const size_t nChunks = 2 * pool.size();
+    const size_t blockSize = nChunks * CHUNK_SIZE;
+    std::vector<char> blocks[2];
+    blocks[0].resize(blockSize + 1); // room for a terminating 0
+    blocks[1].resize(blockSize + 1);
+
+    std::vector<FaceGroup> groups(1);
+    groups[0].first = 0;
+    groups[0].material = curMaterial;
+
+    try {
+        size_t size = fread(&blocks[0][0], 1, blockSize, file);
+        bool eof = size < blockSize;
+        for (int cur = 0; size > 0; cur ^= 1) {
+            char* begin = &blocks[cur][0];
+            char* end = begin + size;
+
+            // the last line is completed by the next block, unless at the end of the file
+            char* linesEnd = end;
+            if (!eof) {
+                while (linesEnd > begin && linesEnd[-1] != '\n') linesEnd--;
+                if (linesEnd == begin) throw std::runtime_error("line too long");
+            }
+
+            std::vector<std::unique_ptr<ObjReader> > chunks;
+            char* start = begin;
+            for (size_t c = 0; c < nChunks && start < linesEnd; c++) {
+                char* stop = begin + (linesEnd - begin) * (c + 1) / nChunks;
+                if (stop < start) stop = start;
+                if (stop < linesEnd) {
+                    char* eol = (char*) memchr(stop, '\n', linesEnd - stop);
+                    stop = eol ? eol + 1 : linesEnd;
                 }
-                curGroup.push_back(face);
-                continue;
+                ObjReader* chunk = new ObjReader;
+                chunk->path = path;
+                chunks.push_back(std::unique_ptr<ObjReader>(chunk));
+                pool.push([chunk, start, stop](int) { chunk->parseChunk(start, stop); });
+                start = stop;
+            }
+
+            // read the next block behind the unfinished line
+            size_t carry = end - linesEnd;
+            size = 0;
+            if (!eof) {
+                char* next = &blocks[cur ^ 1][0];
+                memcpy(next, linesEnd, carry);
+                size_t n = fread(next + carry, 1, blockSize - carry, file);
+                eof = n < blockSize - carry;
+                size = carry + n;
             }
-            
-            /*! use material */
-            if (!strncmp(token, "usemtl", 6) && isSep(token[6]))
-            {
-                flushFaceGroup();
-                std::string name(parseSep(token += 6));
-                if (materials.find(name) == materials.end()) curMaterial = defaultMaterial;
-                else curMaterial = materials[name];
-                continue;
+            pool.wait();
+
+            for (size_t c = 0; c < chunks.size(); c++) {
+                if (!mergeChunk(*chunks[c], groups)) {
+                    size = 0;
+                    break;
+                }
             }
-            
-            /* load material library */
-            if (!strncmp(token, "mtllib", 6) && isSep(token[6])) {
-                loadMTL(path + "/" + std::string(parseSep(token += 6)));
-                continue;
+        }
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        error = e.what();
+    }
+    groups.back().end = (uint32_t)curFaceOffsets.size() - 1;
+
+    std::vector<PrimitiveSharedPtr> primitives(groups.size());
+    for (size_t g = 0; g < groups.size(); g++) {
+        if (groups[g].end == groups[g].first) continue;
+        pool.push([this, &groups, &primitives, g](int) {
+            const FaceGroup& group = groups[g];
+            primitives[g] = buildPrimitive(&curFaceOffsets[group.first], group.end - group.first, group.material);
+        });
+    }
+    pool.wait();
+    for (size_t g = 0; g < primitives.size(); g++)
+        if (primitives[g]) model.push_back(primitives[g]);
+
+    curFaces.clear();
+    curFaceOffsets.resize(1);
+}
+
+/*! \brief append the faces [first, end) of a chunk, fixing its relative indices,
+ *  throws if an index is out of the vertices merged so far
+ *  \param vBase, vtBase, vnBase are the sizes of v, vt and vn before the chunk
+ *  \param nextRelative is the first entry of chunk.relative not fixed yet
+ */
+void ObjReader::appendFaces(const ObjReader &chunk, uint32_t first, uint32_t end,
+    size_t vBase, size_t vtBase, size_t vnBase, size_t &nextRelative)
+{
+    if (first == end) return;
+    uint32_t from = chunk.curFaceOffsets[first];
+    uint32_t to = chunk.curFaceOffsets[end];
+    size_t faceBase = curFaces.size();
+    size_t offsetBase = curFaceOffsets.size();
+    curFaces.insert(curFaces.end(), chunk.curFaces.begin() + from, chunk.curFaces.begin() + to);
+    for (uint32_t j = first + 1; j <= end; j++)
+        curFaceOffsets.push_back((uint32_t)(faceBase + chunk.curFaceOffsets[j] - from));
+
+    // the faces are dropped if an index is out of range, so none is ever built
+    static const char* names[3] = { "vertex", "texture coordinate", "vertex normal" };
+    const char* what = 0;
+    for (; nextRelative < chunk.relative.size(); nextRelative++) {
+        uint32_t r = chunk.relative[nextRelative];
+        if ((r >> 2) >= to) break;
+        Vertex& vertex = curFaces[faceBase + (r >> 2) - from];
+        int& index = (r & 3) == 0 ? vertex.v : (r & 3) == 1 ? vertex.vt : vertex.vn;
+        index += (int)((r & 3) == 0 ? vBase : (r & 3) == 1 ? vtBase : vnBase);
+        if (index < 0 && !what) what = names[r & 3]; // before the start of the file
+    }
+    for (size_t j = faceBase; j < curFaces.size() && !what; j++) {
+        const Vertex& vertex = curFaces[j];
+        if (vertex.v < 0 || (size_t)vertex.v >= v.size()) what = names[0];
+        else if (vertex.vt >= 0 && (size_t)vertex.vt >= vt.size()) what = names[1];
+        else if (vertex.vn >= 0 && (size_t)vertex.vn >= vn.size()) what = names[2];
+    }
+    if (what) {
+        curFaces.resize(faceBase);
+        curFaceOffsets.resize(offsetBase);
+        throw std::runtime_error(std::string("OBJ: ") + what + " index out of range");
+    }
+}
+
+/*! \brief append the vertices and faces of a parsed chunk, applying its
+ *  usemtl and mtllib commands in order
+ *  \return false if the parse stops in this chunk, as it would when serial
+ */
+bool ObjReader::mergeChunk(const ObjReader &chunk, std::vector<FaceGroup> &groups)
+{
+    size_t vBase = v.size(), vtBase = vt.size(), vnBase = vn.size();
+    v.insert(v.end(), chunk.v.begin(), chunk.v.end());
+    vt.insert(vt.end(), chunk.vt.begin(), chunk.vt.end());
+    vn.insert(vn.end(), chunk.vn.begin(), chunk.vn.end());
+
+    uint32_t face = 0;
+    size_t nextRelative = 0;
+    try {
+        for (size_t i = 0; i < chunk.commands.size(); i++) {
+            const Command& command = chunk.commands[i];
+            appendFaces(chunk, face, command.face, vBase, vtBase, vnBase, nextRelative);
+            face = command.face;
+            if (command.usemtl) {
+                useMaterial(command.name);
+                FaceGroup group;
+                group.first = groups.back().end = (uint32_t)curFaceOffsets.size() - 1;
+                group.material = curMaterial;
+                groups.push_back(group);
             }
+            else loadMTL(command.name);
         }
+        appendFaces(chunk, face, (uint32_t)chunk.curFaceOffsets.size() - 1, vBase, vtBase, vnBase, nextRelative);
     }
     catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
+        error = e.what();
+        return false;
     }
-    flushFaceGroup(); // flush the last loaded object
-    ifs.close();
+
+    if (!chunk.error.empty()) {
+        std::cerr << chunk.error << std::endl;
+        error = chunk.error;
+        return false;
+    }
+    return true;
+}
+
+/*! \brief parse one line of the OBJ file
+ *  \param line is the start of the line, end points past its last character
+ *  (on the \n), the line is 0-terminated in place
+ */
+void ObjReader::parseLine(char *line, char *end)
+{
+    // trim the line end (\r of dos files) and terminate it
+    while (end > line && (isSep(end[-1]) || end[-1] == '\r')) end--;
+    *end = 0;
+
+    const char* token = line;
+    parseSepOpt(token); // ignore space and tabs
+
+    if (token[0] == 0) return; // line is empty, ignore
+    // read a vertex
+    if (token[0] == 'v' && isSep(token[1])) { v.push_back(getVec3f(token += 2)); return; }
+    // read a normal
+    if (token[0] == 'v' && token[1] == 'n' && isSep(token[2])) { vn.push_back(getVec3f(token += 3)); return; }
+    // read a texture coordinates
+    if (token[0] == 'v' && token[1] == 't' && isSep(token[2])) { vt.push_back(getVec2f(token += 3)); return; }
+    // read a face
+    if (token[0] == 'f' && isSep(token[1])) {
+        parseSep(token += 1);
+        while (token[0]) {
+            curFaces.push_back(getInt3(token));
+            parseSepOpt(token);
+        }
+        curFaceOffsets.push_back((uint32_t) curFaces.size());
+        return;
+    }
+
+    /*! use material */
+    if (!strncmp(token, "usemtl", 6) && isSep(token[6]))
+    {
+        std::string name(parseSep(token += 6));
+        if (deferred) {
+            Command command = { (uint32_t)curFaceOffsets.size() - 1, true, name };
+            commands.push_back(command);
+            return;
+        }
+        flushFaceGroup();
+        useMaterial(name);
+        return;
+    }
+
+    /* load material library */
+    if (!strncmp(token, "mtllib", 6) && isSep(token[6])) {
+        std::string filename(path + "/" + std::string(parseSep(token += 6)));
+        if (deferred) {
+            Command command = { (uint32_t)curFaceOffsets.size() - 1, false, filename };
+            commands.push_back(command);
+            return;
+        }
+        loadMTL(filename);
+        return;
+    }
+}
+
+/*! \brief make a material of the loaded libraries current, the default material if not found
+ */
+void ObjReader::useMaterial(const std::string &name)
+{
+    std::map<std::string, std::shared_ptr<Material> >::iterator it = materials.find(name);
+    if (it == materials.end()) curMaterial = defaultMaterial;
+    else curMaterial = it->second;
+}
+
+
+#define EMPTY_SLOT 0xffffffffu
+
+VertexHashTable::VertexHashTable(size_t expected)
+{
+    // keep the load factor under 1/2
+    size_t n = 16;
+    while (n < 2 * expected) n *= 2;
+    Slot empty = { 0, EMPTY_SLOT };
+    slots.assign(n, empty);
+    mask = (uint32_t)(n - 1);
+    keys.reserve(expected);
 }
 
+uint32_t VertexHashTable::hash(const Vertex &v)
+{
+    uint64_t h = (uint64_t)(uint32_t)v.v * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)(uint32_t)v.vt * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (uint64_t)(uint32_t)v.vn * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+uint32_t VertexHashTable::insert(const Vertex &v, bool &inserted)
+{
+    uint32_t h = hash(v);
+    for (uint32_t i = h & mask;; i = (i + 1) & mask) {
+        Slot &slot = slots[i];
+        if (slot.index == EMPTY_SLOT) {
+            slot.hash = h;
+            slot.index = (uint32_t)keys.size();
+            keys.push_back(v);
+            inserted = true;
+            if (2 * keys.size() > slots.size()) grow();
+            return (uint32_t)keys.size() - 1;
+        }
+        if (slot.hash == h) {
+            const Vertex &key = keys[slot.index];
+            if (key.v == v.v && key.vt == v.vt && key.vn == v.vn) {
+                inserted = false;
+                return slot.index;
+            }
+        }
+    }
+}
+
+/*! double the slots, when more vertices than expected are inserted */
+void VertexHashTable::grow()
+{
+    std::vector<Slot> old;
+    old.swap(slots);
+    Slot empty = { 0, EMPTY_SLOT };
+    slots.assign(old.size() * 2, empty);
+    mask = (uint32_t)(slots.size() - 1);
+    for (size_t j = 0; j < old.size(); j++) {
+        if (old[j].index == EMPTY_SLOT) continue;
+        uint32_t i = old[j].hash & mask;
+        while (slots[i].index != EMPTY_SLOT) i = (i + 1) & mask;
+        slots[i] = old[j];
+    }
+}
 
 /*! \brief utility function to keep track of the vertex already used while creating a new mesh
- *  \param vertexMap is a map used to keep track of the vertices already inserted in the position list
+ *  \param vertexTable keeps track of the vertices already inserted in the position list
  *  \param position is a position list for the newly created mesh
  *  \param normals is a normal list for the newly created mesh
  *  \param texcoords is a texture coordinate list for the newly created mesh
- *  \param i is the Vertex looked for or inserted in vertexMap
+ *  \param i is the Vertex looked for or inserted in vertexTable
  *  \return the index of this Vertex in the position vector list.
  */
 uint32_t ObjReader::getVertex(
-    std::map<Vertex, uint32_t> &vertexMap, 
+    VertexHashTable &vertexTable, 
     std::vector<Vec3f> &positions, 
     std::vector<Vec3f> &normals,
     std::vector<Vec2f> &texcoords,
-    const Vertex &i)
+    const Vertex &i) const
 {
-    const std::map<Vertex, uint32_t>::iterator& entry = vertexMap.find(i);
-    if (entry != vertexMap.end()) return(entry->second);
+    bool inserted;
+    uint32_t index = vertexTable.insert(i, inserted);
+    if (!inserted) return(index);
     
     positions.push_back(v[i.v]);
-	//printf("added vertex: (%.3f, %.3f, %.3f)\n", v[i.v].x, v[i.v].y, v[i.v].z);
     if (i.vn >= 0) normals.push_back(vn[i.vn]);
-	//printf("i.vt=%d\n", i.vt);
     if (i.vt >= 0) texcoords.push_back(vt[i.vt]);
-    return (vertexMap[i] = int(positions.size()) - 1);
+    return index;
 }
 
 /*! \brief flush the current content of currGroup and create new mesh 
  */
 void ObjReader::flushFaceGroup()
 {
-    if (curGroup.empty()) return;
-    
+    if (curFaceOffsets.size() < 2) return;
+    model.push_back(buildPrimitive(&curFaceOffsets[0], curFaceOffsets.size() - 1, curMaterial));
+    curFaces.clear();
+    curFaceOffsets.resize(1);
+}
+
+/*! \brief triangulate faces of curFaces into a new mesh
+ *  \param offsets are the offsets in curFaces of the faces, nFaces + 1 of them
+ *  \param material is the material of the new primitive
+ */
+PrimitiveSharedPtr ObjReader::buildPrimitive(const uint32_t *offsets, size_t nFaces, const std::shared_ptr<Material> &material) const
+{
     // temporary data arrays
     std::vector<Vec3f> positions;
     std::vector<Vec3f> normals;
     std::vector<Vec2f> texcoords;
     std::vector<Vec3i> triangles;
-    std::map<Vertex, uint32_t> vertexMap;
+    // a closed triangle mesh has about half as many vertices as faces, so
+    // the face count covers most groups without growing
+    VertexHashTable vertexTable(nFaces);
     
     // merge three indices into one
-    for (size_t j = 0; j < curGroup.size(); j++)
+    for (size_t j = 0; j < nFaces; j++)
     {
         /* iterate over all faces */
-        const std::vector<Vertex>& face = curGroup[j];
+        const Vertex* face = &curFaces[offsets[j]];
+        size_t faceSize = offsets[j + 1] - offsets[j];
+        if (faceSize < 3) continue;
         Vertex i0 = face[0], i1 = Vertex(-1), i2 = face[1];
         
         /* triangulate the face with a triangle fan */
-        for (size_t k = 2; k < face.size(); k++) {
+        for (size_t k = 2; k < faceSize; k++) {
             i1 = i2; i2 = face[k];
-            uint32_t v0 = getVertex(vertexMap, positions, normals, texcoords, i0);
-            uint32_t v1 = getVertex(vertexMap, positions, normals, texcoords, i1);
-            uint32_t v2 = getVertex(vertexMap, positions, normals, texcoords, i2);
+            uint32_t v0 = getVertex(vertexTable, positions, normals, texcoords, i0);
+            uint32_t v1 = getVertex(vertexTable, positions, normals, texcoords, i1);
+            uint32_t v2 = getVertex(vertexTable, positions, normals, texcoords, i2);
             triangles.push_back(Vec3i(v0, v1, v2));
         }
     }
-    curGroup.clear();
 
     // create new triangle mesh, allocate memory and copy data
     std::shared_ptr<TriangleMesh> mesh = std::shared_ptr<TriangleMesh>(new TriangleMesh);
@@ -419,14 +741,148 @@ void ObjReader::flushFaceGroup()
         mesh->normals = new Vec3f[normals.size()];
         memcpy(mesh->normals, &normals[0], sizeof(Vec3f) * normals.size());
     }
-	//printf("texcoords.size()= %d\n", texcoords.size());
     if (texcoords.size()) {
         mesh->texcoords = new Vec2f[texcoords.size()];
         memcpy(mesh->texcoords, &texcoords[0], sizeof(Vec2f) * texcoords.size());
     }
-    model.push_back(std::shared_ptr<Primitive>(new Primitive(mesh, curMaterial)));
+    return PrimitiveSharedPtr(new Primitive(mesh, material));
 }
 
-void conv_obj(const std::vector<std::shared_ptr<Primitive> >& model, const char* filename);
+/*! bits of a float, with -0 as 0 */
+static inline int floatBits(float f)
+{
+    f += 0.0f;
+    int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
 
-#endif
\ No newline at end of file
+/*! \brief smooth normals of a submesh without normals: the normals of the
+ *  faces around a position are summed, vertices at the same position share it
+ */
+static void generateNormals(SubMeshData &subMesh)
+{
+    uint32_t n = subMesh.n_vertices();
+    const float *p = subMesh.positions.data();
+
+    // the positions as Vertex keys, to find the vertices at the same place
+    VertexHashTable positions(n);
+    std::vector<uint32_t> shared(n);
+    for (uint32_t i = 0; i < n; i++) {
+        bool inserted;
+        shared[i] = positions.insert(Vertex(floatBits(p[3 * i]), floatBits(p[3 * i + 1]), floatBits(p[3 * i + 2])), inserted);
+    }
+
+    std::vector<float> sums(3 * positions.size(), 0.0f);
+    for (size_t t = 0; t < subMesh.indices.size(); t += 3) {
+        const float *a = p + 3 * subMesh.indices[t];
+        const float *b = p + 3 * subMesh.indices[t + 1];
+        const float *c = p + 3 * subMesh.indices[t + 2];
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float nx = e1[1] * e2[2] - e1[2] * e2[1];
+        float ny = e1[2] * e2[0] - e1[0] * e2[2];
+        float nz = e1[0] * e2[1] - e1[1] * e2[0];
+        float len = sqrtf(nx * nx + ny * ny + nz * nz);
+        if (len == 0) continue; // degenerate triangle
+        for (int k = 0; k < 3; k++) {
+            float *sum = &sums[3 * shared[subMesh.indices[t + k]]];
+            sum[0] += nx / len; sum[1] += ny / len; sum[2] += nz / len;
+        }
+    }
+
+    subMesh.normals.resize(3 * n);
+    for (uint32_t i = 0; i < n; i++) {
+        const float *sum = &sums[3 * shared[i]];
+        float len = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+        float scale = len > 0 ? 1.0f / len : 0.0f;
+        for (int k = 0; k < 3; k++) subMesh.normals[3 * i + k] = sum[k] * scale;
+    }
+}
+
+bool conv_obj(const std::vector<std::shared_ptr<Primitive> >& model, MeshData& out)
+{
+    out.subMeshes.clear();
+    out.materials.clear();
+
+    // the materials used, in their order of definition, the default one excluded
+    std::vector<std::shared_ptr<Material> > used;
+    for (size_t i = 0; i < model.size(); i++) {
+        const std::shared_ptr<Material> &material = model[i]->material;
+        if (material->index < 0) continue;
+        bool found = false;
+        for (size_t j = 0; j < used.size() && !found; j++) found = used[j] == material;
+        if (!found) used.push_back(material);
+    }
+    std::stable_sort(used.begin(), used.end(),
+        [](const std::shared_ptr<Material> &a, const std::shared_ptr<Material> &b) { return a->index < b->index; });
+    for (size_t j = 0; j < used.size(); j++) {
+        MaterialData material;
+        material.name = used[j]->name;
+        material.diffuse = used[j]->map_Kd;
+        out.materials.push_back(material);
+    }
+
+    // one submesh per material, in order of first use
+    std::vector<const Material*> subMeshMaterials;
+    std::vector<std::vector<const TriangleMesh*> > subMeshPrimitives;
+    for (size_t i = 0; i < model.size(); i++) {
+        const Material *material = model[i]->material.get();
+        size_t s = 0;
+        while (s < subMeshMaterials.size() && subMeshMaterials[s] != material) s++;
+        if (s == subMeshMaterials.size()) {
+            subMeshMaterials.push_back(material);
+            subMeshPrimitives.push_back(std::vector<const TriangleMesh*>());
+        }
+        subMeshPrimitives[s].push_back(model[i]->mesh.get());
+    }
+
+    for (size_t s = 0; s < subMeshMaterials.size(); s++) {
+        const std::vector<const TriangleMesh*> &meshes = subMeshPrimitives[s];
+        SubMeshData subMesh;
+        for (size_t j = 0; j < used.size(); j++)
+            if (used[j].get() == subMeshMaterials[s]) subMesh.material = (int)j;
+
+        // normals are kept only if every vertex has one, texture coordinates
+        // if any primitive has them (0 for the others)
+        bool normals = true, texcoords = false;
+        uint32_t nVertices = 0, nTriangles = 0;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            normals = normals && meshes[i]->nNormals == meshes[i]->nPositions;
+            texcoords = texcoords || meshes[i]->nTexCoord == meshes[i]->nPositions;
+            nVertices += meshes[i]->nPositions;
+            nTriangles += meshes[i]->numTriangles;
+        }
+        if (nTriangles == 0) continue;
+
+        subMesh.positions.reserve(3 * nVertices);
+        subMesh.indices.reserve(3 * nTriangles);
+        if (normals) subMesh.normals.reserve(3 * nVertices);
+        if (texcoords) subMesh.texcoords.reserve(2 * nVertices);
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const TriangleMesh &mesh = *meshes[i];
+            uint32_t base = subMesh.n_vertices();
+            const float *positions = (const float*)mesh.positions;
+            subMesh.positions.insert(subMesh.positions.end(), positions, positions + 3 * mesh.nPositions);
+            if (normals) {
+                const float *n = (const float*)mesh.normals;
+                subMesh.normals.insert(subMesh.normals.end(), n, n + 3 * mesh.nPositions);
+            }
+            if (texcoords) {
+                // flipped, as aiProcess_FlipUVs does
+                bool has = mesh.nTexCoord == mesh.nPositions;
+                for (int v = 0; v < mesh.nPositions; v++) {
+                    subMesh.texcoords.push_back(has ? mesh.texcoords[v].x : 0.0f);
+                    subMesh.texcoords.push_back(has ? 1.0f - mesh.texcoords[v].y : 0.0f);
+                }
+            }
+            for (int t = 0; t < 3 * mesh.numTriangles; t++)
+                subMesh.indices.push_back(base + mesh.triangles[t]);
+        }
+
+        if (!normals) generateNormals(subMesh);
+        out.subMeshes.push_back(subMesh);
+    }
+
+    return !out.subMeshes.empty();
+}
@@ -0,0 +1,194 @@
+/*!
+    \file objloader.h
+    \brief load an OBJ file and store its geometry/material in memory
+
+    This code was adapted from the project Embree from Intel.
+    Copyright 2009-2012 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (see objloader.cpp)
+
+    Copyright 2013 Scratchapixel
+ */
+
+#ifndef _OBJLOADER_H_
+#define _OBJLOADER_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+#include <cstdio>
+
+template<typename T>
+class Vec2
+{
+public:
+    T x, y;
+    Vec2() : x(0), y(0) {}
+    Vec2(T xx, T yy) : x(xx), y(yy) {}
+};
+
+template<typename T>
+class Vec3
+{
+public:
+    T x, y, z;
+    Vec3() : x(0), y(0), z(0) {}
+    Vec3(T xx, T yy, T zz) : x(xx), y(yy), z(zz) {}
+    friend std::ostream & operator << (std::ostream &os, const Vec3<T> &v)
+    { os << v.x << ", " << v.y << ", " << v.z; return os; }
+};
+
+typedef Vec3<float> Vec3f;
+typedef Vec3<int> Vec3i;
+typedef Vec2<float> Vec2f;
+
+/*! \struct Material
+ *  \brief a simple structure to store material's properties
+ */
+struct Material
+{
+    Vec3f Ka, Kd, Ks;   /*! ambient, diffuse and specular rgb coefficients */
+    float d;            /*! transparency */
+    float Ns, Ni;       /*! specular exponent and index of refraction */
+    std::string map_Kd; /*! diffuse texture, empty if none */
+	std::string name;
+    int index;          /*! order of definition in the material libraries, -1 for the default material */
+
+	Material(std::string _name) : name(_name), index(-1) {};
+};
+
+/*! \class TriangleMesh
+ *  \brief a basic class to store a triangle mesh data
+ */
+class TriangleMesh
+{
+public:
+    Vec3f *positions;   /*! position/vertex array */
+    Vec3f *normals;     /*! normal array (can be null) */
+    Vec2f *texcoords;   /*! texture coordinates (can be null) */
+    int numTriangles;   /*! number of triangles */
+    int *triangles;     /*! triangle index list */
+    int nPositions;   /*! number of vertices */
+    int nNormals;   /*! number of normals*/
+    int nTexCoord;   /*! number of texcoords*/
+    TriangleMesh() : positions(nullptr), normals(nullptr), texcoords(nullptr), triangles(nullptr) {}
+    ~TriangleMesh()
+    {
+        if (positions) delete [] positions;
+        if (normals) delete [] normals;
+        if (texcoords) delete [] texcoords;
+        if (triangles) delete [] triangles;
+    }
+};
+
+/*! \class Primitive
+ *  \brief a basic class to store a primitive (defined by a mesh and a material)
+ */
+struct Primitive
+{
+    Primitive(const std::shared_ptr<TriangleMesh> &m, const std::shared_ptr<Material> &mat) :
+        mesh(m), material(mat) {}
+    const std::shared_ptr<TriangleMesh> mesh;   /*! the object's geometry */
+    const std::shared_ptr<Material> material;   /*! the object's material */
+};
+
+/*! Three-index vertex, indexing start at 0, -1 means invalid vertex. */
+struct Vertex {
+    int v, vt, vn;
+    Vertex() {};
+    Vertex(int v) : v(v), vt(v), vn(v) {};
+    Vertex(int v, int vt, int vn) : v(v), vt(vt), vn(vn) {};
+};
+
+// need to declare this operator if we want to use Vertex in a map
+inline bool operator < ( const Vertex& a, const Vertex& b ) {
+    if (a.v  != b.v)  return a.v  < b.v;
+    if (a.vn != b.vn) return a.vn < b.vn;
+    if (a.vt != b.vt) return a.vt < b.vt;
+    return false;
+}
+
+/*! \class VertexHashTable
+ *  \brief open addressing hash table giving each distinct Vertex an index,
+ *  in order of first insertion. slots only hold the hash and the index, the
+ *  vertices themselves are kept in insertion order in keys
+ */
+class VertexHashTable
+{
+public:
+    /*! room for expected vertices, the table grows past that */
+    VertexHashTable(size_t expected);
+    /*! index of v, or the next index if v is new */
+    uint32_t insert(const Vertex &v, bool &inserted);
+    size_t size() const { return keys.size(); }
+    std::vector<Vertex> keys;   /*! distinct vertices, by index */
+private:
+    struct Slot { uint32_t hash, index; };
+    static uint32_t hash(const Vertex &v);
+    void grow();
+    std::vector<Slot> slots;
+    uint32_t mask;
+};
+
+typedef std::shared_ptr<Primitive> PrimitiveSharedPtr;
+typedef std::shared_ptr<TriangleMesh> MeshSharedPtr;
+
+class ObjReader
+{
+public:
+    /*! nThreads other than 1 parses the file in line aligned chunks on that
+        many threads (0: one per core), the result is the same as a serial parse */
+    ObjReader(const char *filename, int nThreads = 1);
+    Vertex getInt3(const char*& token);
+    int fix_v(int index) { return(index > 0 ? index - 1 : (index == 0 ? 0 : (int)v .size() + index)); }
+    int fix_vt(int index) { return(index > 0 ? index - 1 : (index == 0 ? 0 : (int)vt.size() + index)); }
+    int fix_vn(int index) { return(index > 0 ? index - 1 : (index == 0 ? 0 : (int)vn.size() + index)); }
+    std::vector<Vec3f> v, vn;
+    std::vector<Vec2f> vt;
+    /*! faces of the current group, stored flat: the vertices of face i are
+        curFaces[curFaceOffsets[i]] to curFaces[curFaceOffsets[i+1]-1] */
+    std::vector<Vertex> curFaces;
+    std::vector<uint32_t> curFaceOffsets;
+    std::map<std::string, std::shared_ptr<Material> > materials;
+    int nMaterials;     /*! materials defined so far, including redefinitions */
+    std::shared_ptr<Material> curMaterial;
+    std::shared_ptr<Material> defaultMaterial;
+    std::string path;
+    void parseLine(char *line, char *end);
+    void loadMTL(const std::string &mtlFilename);
+    void useMaterial(const std::string &name);
+    void flushFaceGroup();
+    PrimitiveSharedPtr buildPrimitive(const uint32_t *offsets, size_t nFaces, const std::shared_ptr<Material> &material) const;
+    uint32_t getVertex(VertexHashTable&, std::vector<Vec3f>&, std::vector<Vec3f>&, std::vector<Vec2f>&, const Vertex&) const;
+    std::vector<std::shared_ptr<Primitive> > model;
+
+    /*! a usemtl or mtllib line of a chunk, applied in order when the chunks are merged */
+    struct Command { uint32_t face; bool usemtl; std::string name; };
+    /*! faces [first, end) of the merged file, sharing a material */
+    struct FaceGroup { uint32_t first, end; std::shared_ptr<Material> material; };
+    bool deferred;                  /*! parsing a chunk: record the commands instead of applying them */
+    std::vector<Command> commands;  /*! commands of a chunk */
+    std::vector<uint32_t> relative; /*! face vertices of a chunk with negative indices, (vertex << 2 | 0 v, 1 vt, 2 vn) */
+    std::string error;              /*! what stopped the parse of the file or chunk, empty if none */
+    std::vector<std::string> warnings; /*! what the parse went on without, ie. a material file not found */
+    void parseChunk(char *begin, char *end);
+    void parseParallel(FILE *file, int nThreads);
+    bool mergeChunk(const ObjReader &chunk, std::vector<FaceGroup> &groups);
+    void appendFaces(const ObjReader &chunk, uint32_t first, uint32_t end, size_t vBase, size_t vtBase, size_t vnBase, size_t &nextRelative);
+private:
+    ObjReader() : nMaterials(0), deferred(true) {}
+};
+
+struct MeshData;
+
+/*! \brief convert the primitives of an ObjReader for the .m/.mat writers, doing
+ *  what the converter asks Assimp for: primitives sharing a material are
+ *  joined, normals are generated if missing and texture coordinates flipped
+ *  \return false if there is nothing to convert
+ */
+bool conv_obj(const std::vector<std::shared_ptr<Primitive> >& model, MeshData& out);
+
+#endif